@@ -39,5 +39,5 @@ void IOAccount::addCoins(uint32_t accountId, int32_t coins) {
 	std::ostringstream query;
 	query << "UPDATE `accounts` SET `coins` = `coins` + " << coins << " WHERE `id` = " << accountId;
 
-	g_databaseTasks.addTask(query.str());
+	g_databaseTasks.addTask(query.str(), nullptr, false, accountId);
 }
\ No newline at end of file
@@ -75,11 +75,11 @@ bool IOBan::isAccountBanned(uint32_t accountId, BanInfo& banInfo)
 		// Move the ban to history if it has expired
 		query.str(std::string());
 		query << "INSERT INTO `account_ban_history` (`account_id`, `reason`, `banned_at`, `expired_at`, `banned_by`) VALUES (" << accountId << ',' << db->escapeString(result->getString("reason")) << ',' << result->getNumber<time_t>("banned_at") << ',' << expiresAt << ',' << result->getNumber<uint32_t>("banned_by") << ')';
-		g_databaseTasks.addTask(query.str());
+		g_databaseTasks.addTask(query.str(), nullptr, false, accountId);
 
 		query.str(std::string());
 		query << "DELETE FROM `account_bans` WHERE `account_id` = " << accountId;
-		g_databaseTasks.addTask(query.str());
+		g_databaseTasks.addTask(query.str(), nullptr, false, accountId);
 		return false;
 	}
 
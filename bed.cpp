@@ -155,6 +155,7 @@ bool BedItem::sleep(Player* player)
 	if (nextBedItem) {
 		nextBedItem->internalSetSleeper(player);
 	}
+	house->setDirty(true);
 
 	// update the bedSleepersMap
 	g_game.setBedSleeper(this, player->getGUID());
@@ -209,6 +210,7 @@ void BedItem::wakeUp(Player* player)
 	if (nextBedItem) {
 		nextBedItem->internalRemoveSleeper();
 	}
+	house->setDirty(true);
 
 	// change self and partner's appearance
 	updateAppearance(nullptr);
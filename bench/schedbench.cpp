@@ -0,0 +1,212 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2014  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+// Compares the two scheduler backends, the binary heap and the timer wheel,
+// under the kind of load a busy server puts on them: every millisecond the
+// dispatcher adds a batch of events with a mix of delays (walk steps, combat
+// and condition ticks, long decay and spawn timers) and stops a share of the
+// pending ones again, as walk events are whenever a creature changes its mind.
+// Reports what adding and stopping costs the calling thread and how late the
+// scheduler thread hands the events to the dispatcher.
+
+#include "otpch.h"
+
+#include <random>
+
+#include "outputmessage.h"
+#include "scheduler.h"
+#include "tasks.h"
+#include "taskstats.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+	uint32_t eventsPerSecond = 50000;
+	double cancelRatio = 0.5;
+	uint32_t duration = 10;
+};
+
+struct RunResult {
+	uint64_t added = 0;
+	uint64_t stopped = 0;
+	int64_t addTime = 0;
+	int64_t stopTime = 0;
+	size_t maxPending = 0;
+	std::unique_ptr<TaskStatsSnapshot> stats;
+};
+
+std::atomic<uint64_t> fired(0);
+
+void onEvent()
+{
+	fired.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t getDelay(std::mt19937& generator)
+{
+	uint32_t kind = std::uniform_int_distribution<uint32_t>(0, 99)(generator);
+	if (kind < 60) {
+		// walk steps and attack rounds
+		return std::uniform_int_distribution<uint32_t>(50, 600)(generator);
+	} else if (kind < 90) {
+		// condition ticks, cooldowns, think intervals
+		return std::uniform_int_distribution<uint32_t>(1000, 5000)(generator);
+	}
+	// item decay, spawn and raid timers
+	return std::uniform_int_distribution<uint32_t>(30000, 300000)(generator);
+}
+
+RunResult run(bool useWheel, const Options& options)
+{
+	Scheduler scheduler;
+	scheduler.setTimerWheel(useWheel);
+	scheduler.start();
+
+	std::unique_ptr<TaskStatsSnapshot> before(new TaskStatsSnapshot);
+	g_taskStats.snapshot(*before);
+
+	RunResult result;
+	std::mt19937 generator(0x5eed);
+	std::vector<uint32_t> pending;
+	pending.reserve(options.eventsPerSecond * 8);
+
+	// spread the events over the millisecond ticks, carrying the remainder
+	const double eventsPerTick = options.eventsPerSecond / 1000.;
+	double carry = 0;
+
+	const auto start = Clock::now();
+	auto nextTick = start;
+	while (Clock::now() - start < std::chrono::seconds(options.duration)) {
+		carry += eventsPerTick;
+		const uint32_t count = static_cast<uint32_t>(carry);
+		carry -= count;
+
+		auto opStart = Clock::now();
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t eventId = scheduler.addEvent(createSchedulerTask(getDelay(generator), &onEvent));
+			pending.push_back(eventId);
+		}
+		result.addTime += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - opStart).count();
+		result.added += count;
+
+		// stop random pending events, some of which have already fired
+		const uint32_t stops = static_cast<uint32_t>(count * options.cancelRatio + std::uniform_real_distribution<double>(0, 1)(generator));
+		opStart = Clock::now();
+		for (uint32_t i = 0; i < stops && !pending.empty(); ++i) {
+			size_t index = std::uniform_int_distribution<size_t>(0, pending.size() - 1)(generator);
+			scheduler.stopEvent(pending[index]);
+			pending[index] = pending.back();
+			pending.pop_back();
+			++result.stopped;
+		}
+		result.stopTime += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - opStart).count();
+
+		// events the scheduler already fired are forgotten over time, so the
+		// list does not grow without bound
+		if (pending.size() > options.eventsPerSecond * 4) {
+			pending.erase(pending.begin(), pending.begin() + pending.size() / 2);
+		}
+
+		result.maxPending = std::max(result.maxPending, scheduler.getPendingEvents());
+
+		nextTick += std::chrono::milliseconds(1);
+		std::this_thread::sleep_until(nextTick);
+	}
+
+	scheduler.shutdown();
+	scheduler.join();
+
+	result.stats.reset(new TaskStatsSnapshot);
+	g_taskStats.snapshot(*result.stats);
+	result.stats->subtract(*before);
+	return result;
+}
+
+void printResult(const char* name, const RunResult& result)
+{
+	const HistogramSnapshot& lateness = result.stats->schedulerLateness;
+	std::cout << std::fixed << std::setprecision(1) << name
+	          << ": add " << (result.added != 0 ? static_cast<double>(result.addTime) / result.added : 0) << " ns/op"
+	          << ", stop " << (result.stopped != 0 ? static_cast<double>(result.stopTime) / result.stopped : 0) << " ns/op"
+	          << ", pending max " << result.maxPending
+	          << ", fired " << lateness.count
+	          << ", lateness p50 " << lateness.getPercentile(0.5) / 1000. << " ms"
+	          << ", p99 " << lateness.getPercentile(0.99) / 1000. << " ms" << std::endl;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			return false;
+		}
+
+		const char* value = argv[++i];
+		if (arg == "--rate") {
+			options.eventsPerSecond = std::max(1, std::atoi(value));
+		} else if (arg == "--cancel") {
+			options.cancelRatio = std::min(1., std::max(0., std::atof(value)));
+		} else if (arg == "--duration") {
+			options.duration = std::max(1, std::atoi(value));
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+}
+
+// the benchmark has no network side, nothing is ever queued for autosend
+OutputMessagePool::OutputMessagePool() {}
+OutputMessagePool::~OutputMessagePool() {}
+void OutputMessagePool::startExecutionFrame() {}
+void OutputMessagePool::sendAll() {}
+void intrusive_ptr_release(OutputMessage*) {}
+
+Dispatcher g_dispatcher;
+TaskStats g_taskStats;
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		std::cout << "Usage: " << argv[0] << " [--rate events per second] [--cancel share of stopped events] [--duration seconds per backend]" << std::endl;
+		return 1;
+	}
+
+	std::cout << options.eventsPerSecond << " events/s, " << options.cancelRatio * 100 << "% stopped, "
+	          << options.duration << " s per backend" << std::endl;
+
+	g_dispatcher.start();
+
+	RunResult heap = run(false, options);
+	printResult("heap ", heap);
+
+	RunResult wheel = run(true, options);
+	printResult("wheel", wheel);
+
+	g_dispatcher.shutdown();
+	g_dispatcher.join();
+	return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2014  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+// Counts the heap allocations of the task hot paths. Packet tasks (the binds
+// ProtocolGame::addGameTask makes), Game::checkCreatures and creature walk
+// events are created and run through the dispatcher until the task pool is
+// warm, then every further round has to get by without operator new.
+// Exits with 1 if any allocation is seen.
+
+#include "otpch.h"
+
+#include <atomic>
+#include <new>
+
+#include "const.h"
+#include "outputmessage.h"
+#include "position.h"
+#include "scheduler.h"
+#include "tasks.h"
+#include "taskstats.h"
+
+namespace {
+
+std::atomic<bool> counting(false);
+std::atomic<uint64_t> allocations(0);
+
+// same shapes as the bound Game members, the work itself does not matter here
+class FakeGame
+{
+	public:
+		void playerMove(uint32_t playerId, Direction direction) {
+			touch(playerId + direction);
+		}
+		void playerTurn(uint32_t playerId, Direction direction) {
+			touch(playerId + direction);
+		}
+		void playerSay(uint32_t playerId, uint16_t channelId, SpeakClasses type, const std::string& receiver, const std::string& text) {
+			touch(playerId + channelId + type + receiver.size() + text.size());
+		}
+		void playerUseItem(uint32_t playerId, const Position& pos, uint8_t stackPos, uint8_t index, uint16_t spriteId) {
+			touch(playerId + pos.x + stackPos + index + spriteId);
+		}
+		void checkCreatures(size_t index) {
+			touch(index);
+		}
+		void checkCreatureWalk(uint32_t creatureId) {
+			touch(creatureId);
+		}
+
+		std::atomic<uint64_t> executed{0};
+		uint64_t checksum = 0;
+
+	private:
+		void touch(uint64_t value) {
+			checksum += value;
+			executed.fetch_add(1, std::memory_order_release);
+		}
+};
+
+FakeGame game;
+
+// one round of what a busy dispatcher sees: packets from every player, a
+// creature check and the walk events those players schedule
+uint64_t queueRound(uint32_t players)
+{
+	// argument types as parseSay passes them, the text fits the string's own buffer
+	const uint16_t channelId = 0;
+	const SpeakClasses type = TALKTYPE_SAY;
+	const std::string receiver;
+	const std::string text = "hi";
+
+	uint64_t queued = 0;
+	for (uint32_t id = 0x10000000; id < 0x10000000 + players; ++id) {
+		g_dispatcher.addTask(createTask(std::bind(&FakeGame::playerMove, &game, id, DIRECTION_NORTH), TASK_CATEGORY_PACKET, 0x65));
+		g_dispatcher.addTask(createTask(DISPATCHER_TASK_EXPIRATION, std::bind(&FakeGame::playerTurn, &game, id, DIRECTION_EAST), TASK_CATEGORY_PACKET, 0x70));
+		g_dispatcher.addTask(createTask(std::bind(&FakeGame::playerSay, &game, id, channelId, type, receiver, text), TASK_CATEGORY_PACKET, 0x96));
+		g_dispatcher.addTask(createTask(std::bind(&FakeGame::playerUseItem, &game, id, Position(100, 100, 7), 1, 0, 2160), TASK_CATEGORY_PACKET, 0x82));
+
+		// the scheduler hands due events to the dispatcher like this
+		SchedulerTask* walk = createSchedulerTask(100, std::bind(&FakeGame::checkCreatureWalk, &game, id), TASK_CATEGORY_CREATURE_THINK);
+		walk->setDontExpire();
+		g_dispatcher.addTask(walk, true);
+		queued += 5;
+	}
+
+	SchedulerTask* check = createSchedulerTask(100, std::bind(&FakeGame::checkCreatures, &game, 0), TASK_CATEGORY_CREATURE_THINK);
+	check->setDontExpire();
+	g_dispatcher.addTask(check, true);
+	return queued + 1;
+}
+
+void waitFor(uint64_t executed)
+{
+	while (game.executed.load(std::memory_order_acquire) < executed) {
+		std::this_thread::yield();
+	}
+}
+
+}
+
+void* operator new(size_t size)
+{
+	if (counting.load(std::memory_order_relaxed)) {
+		allocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void* p = std::malloc(size != 0 ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+// the harness has no network side, nothing is ever queued for autosend
+OutputMessagePool::OutputMessagePool() {}
+OutputMessagePool::~OutputMessagePool() {}
+void OutputMessagePool::startExecutionFrame() {}
+void OutputMessagePool::sendAll() {}
+void intrusive_ptr_release(OutputMessage*) {}
+
+Dispatcher g_dispatcher;
+TaskStats g_taskStats;
+
+int main(int argc, char* argv[])
+{
+	const uint32_t players = argc > 1 ? std::max(1, std::atoi(argv[1])) : 500;
+	const uint32_t rounds = argc > 2 ? std::max(1, std::atoi(argv[2])) : 200;
+
+	g_dispatcher.start();
+
+	// the pool has to cover a whole round in flight plus the two batches of
+	// blocks the dispatcher thread keeps in its own cache
+	std::vector<Task*> blocks;
+	const uint32_t roundTasks = players * 5 + 1;
+	for (uint32_t i = 0; i < roundTasks + 256; ++i) {
+		blocks.push_back(createTask([]() {}));
+	}
+	for (Task* task : blocks) {
+		delete task;
+	}
+
+	uint64_t queued = 0;
+	for (uint32_t round = 0; round < 10; ++round) {
+		queued += queueRound(players);
+		waitFor(queued);
+	}
+
+	counting = true;
+	const uint64_t measuredFrom = queued;
+	for (uint32_t round = 0; round < rounds; ++round) {
+		queued += queueRound(players);
+		waitFor(queued);
+	}
+	counting = false;
+
+	g_dispatcher.shutdown();
+	g_dispatcher.join();
+
+	const uint64_t tasks = queued - measuredFrom;
+	std::cout << tasks << " tasks, " << allocations << " allocations (" << std::fixed << std::setprecision(4)
+	          << static_cast<double>(allocations) / tasks << " per task)" << std::endl;
+	return allocations == 0 ? 0 : 1;
+}
@@ -55,6 +55,8 @@ bool ConfigManager::load()
 	if (!loaded) { //info that must be loaded one time (unless we reset the modules involved)
 		boolean[BIND_ONLY_GLOBAL_ADDRESS] = getGlobalBoolean(L, "bindOnlyGlobalAddress", false);
 		boolean[OPTIMIZE_DATABASE] = getGlobalBoolean(L, "startupDatabaseOptimization", true);
+		boolean[SCHEDULER_TIMER_WHEEL] = getGlobalBoolean(L, "schedulerTimerWheel", false);
+		boolean[CREATURE_THINK_DETERMINISTIC] = getGlobalBoolean(L, "creatureThinkDeterministic", false);
 
 		string[IP] = getGlobalString(L, "ip", "127.0.0.1");
 		string[MAP_NAME] = getGlobalString(L, "mapName", "forgotten");
@@ -72,6 +74,10 @@ bool ConfigManager::load()
 		integer[STATUS_PORT] = getGlobalNumber(L, "statusProtocolPort", 7171);
 
 		integer[MARKET_OFFER_DURATION] = getGlobalNumber(L, "marketOfferDuration", 30 * 24 * 60 * 60);
+		integer[CREATURE_THINK_THREADS] = getGlobalNumber(L, "creatureThinkThreads", 0);
+		integer[NETWORK_THREADS] = getGlobalNumber(L, "networkThreads", 1);
+		integer[LOGIN_CRYPTO_THREADS] = getGlobalNumber(L, "loginCryptoThreads", 2);
+		integer[DATABASE_THREADS] = getGlobalNumber(L, "databaseThreads", 2);
 	}
 
 	boolean[ALLOW_CHANGEOUTFIT] = getGlobalBoolean(L, "allowChangeOutfit", true);
@@ -142,6 +148,10 @@ bool ConfigManager::load()
 	integer[STORE_TIME_TO_NEW] = getGlobalNumber(L, "storeTimeToNew", 2);
 	integer[MAX_TILE_ITEMS] = getGlobalNumber(L, "maxTileItems", 90);
 	integer[MAX_CAP_ITEMS] = getGlobalNumber(L, "maxCapItems", 2000000);
+	integer[PATHFINDING_MAX_NODES] = getGlobalNumber(L, "pathfindingMaxNodes", 512);
+	integer[PATHFINDING_MAX_CLOSED_NODES] = getGlobalNumber(L, "pathfindingMaxClosedNodes", 100);
+	integer[MAX_WRITE_QUEUE_BYTES] = getGlobalNumber(L, "maxWriteQueueBytes", 512 * 1024);
+	integer[DISPATCHER_STATS_INTERVAL] = getGlobalNumber(L, "dispatcherStatsInterval", 300);
 
 
 	loaded = true;
@@ -46,6 +46,8 @@ class ConfigManager
 			CLASSIC_EQUIPMENT_SLOTS,
 			ENABLE_LIVE_CASTING, //CASTAFGP
 			FORCE_CLOSE_SLOW_CONNECTION, //LOSTCONNECT
+			SCHEDULER_TIMER_WHEEL,
+			CREATURE_THINK_DETERMINISTIC,
 			LAST_BOOLEAN_CONFIG /* this must be the last one */
 		};
 
@@ -119,6 +121,14 @@ class ConfigManager
 			RED_SKULL_DURATION,
 			BLACK_SKULL_DURATION,
 			ORANGE_SKULL_DURATION,
+			CREATURE_THINK_THREADS,
+			NETWORK_THREADS,
+			LOGIN_CRYPTO_THREADS,
+			DATABASE_THREADS,
+			MAX_WRITE_QUEUE_BYTES,
+			DISPATCHER_STATS_INTERVAL,
+			PATHFINDING_MAX_NODES,
+			PATHFINDING_MAX_CLOSED_NODES,
 
 			LAST_INTEGER_CONFIG /* this must be the last one */
 		};
@@ -21,6 +21,7 @@
 
 #include "configmanager.h"
 #include "connection.h"
+#include "cryptotasks.h"
 #include "outputmessage.h"
 #include "protocol.h"
 #include "scheduler.h"
@@ -110,6 +111,10 @@ void Connection::closeSocket()
 {
 	std::lock_guard<std::recursive_mutex> lockClass(m_connectionLock);
 
+	// queued messages hold references on this connection
+	m_messageQueue.clear();
+	m_queuedBytes = m_writeBatchBytes;
+
 	if (m_socket->is_open()) {
 		m_pendingRead = 0;
 		m_pendingWrite = 0;
@@ -169,7 +174,7 @@ void Connection::deleteConnectionTask()
 	assert(m_refCount == 0);
 
 	try {
-		m_io_service.dispatch(std::bind(&Connection::onStopOperation, this));
+		m_strand.dispatch(std::bind(&Connection::onStopOperation, this));
 	} catch (boost::system::system_error& e) {
 		if (m_logError) {
 			std::cout << "[Network error - Connection::deleteConnectionTask] " << e.what() << std::endl;
@@ -191,12 +196,12 @@ void Connection::accept()
 	try {
 		++m_pendingRead;
 		m_readTimer.expires_from_now(boost::posix_time::seconds(Connection::read_timeout));
-		m_readTimer.async_wait(std::bind(&Connection::handleReadTimeout, std::weak_ptr<Connection>(shared_from_this()), std::placeholders::_1));
+		m_readTimer.async_wait(m_strand.wrap(std::bind(&Connection::handleReadTimeout, std::weak_ptr<Connection>(shared_from_this()), std::placeholders::_1)));
 
 		// Read size of the first packet
 		boost::asio::async_read(getHandle(),
 		                        boost::asio::buffer(m_msg.getBuffer(), NetworkMessage::header_length),
-		                        std::bind(&Connection::parseHeader, shared_from_this(), std::placeholders::_1));
+		                        m_strand.wrap(std::bind(&Connection::parseHeader, shared_from_this(), std::placeholders::_1)));
 	} catch (boost::system::system_error& e) {
 		if (m_logError) {
 			std::cout << "[Network error - Connection::accept] " << e.what() << std::endl;
@@ -223,20 +228,20 @@ void Connection::parseHeader(const boost::system::error_code& error)
 
             try {
                 m_readTimer.expires_from_now(boost::posix_time::seconds(Connection::read_timeout));
-    			m_readTimer.async_wait(std::bind(&Connection::handleReadTimeout, std::weak_ptr<Connection>(shared_from_this()),
-            	std::placeholders::_1));
+    			m_readTimer.async_wait(m_strand.wrap(std::bind(&Connection::handleReadTimeout, std::weak_ptr<Connection>(shared_from_this()),
+            	std::placeholders::_1)));
 
                 if (msgBuffer[0] == 0x0A) {
                     receivedServerName = true;
                     // Wait to the next packet
                     boost::asio::async_read(getHandle(),
 		                        boost::asio::buffer(m_msg.getBuffer(), NetworkMessage::header_length),
-		                        std::bind(&Connection::parseHeader, shared_from_this(), std::placeholders::_1));
+		                        m_strand.wrap(std::bind(&Connection::parseHeader, shared_from_this(), std::placeholders::_1)));
                 } else {
                     // Wait to the next packet
                     boost::asio::async_read(getHandle(),
 		                        boost::asio::buffer(m_msg.getBuffer(), 1),
-		                        std::bind(&Connection::parseHeader, shared_from_this(), std::placeholders::_1));
+		                        m_strand.wrap(std::bind(&Connection::parseHeader, shared_from_this(), std::placeholders::_1)));
                 }
             } catch (boost::system::system_error& e) {
                 std::cout << "[Network error - Connection::parsePacket] " << e.what() << std::endl;
@@ -276,13 +281,13 @@ void Connection::parseHeader(const boost::system::error_code& error)
 
 	try {
 		m_readTimer.expires_from_now(boost::posix_time::seconds(Connection::read_timeout));
-		m_readTimer.async_wait( std::bind(&Connection::handleReadTimeout, std::weak_ptr<Connection>(shared_from_this()),
-		                                    std::placeholders::_1));
+		m_readTimer.async_wait(m_strand.wrap(std::bind(&Connection::handleReadTimeout, std::weak_ptr<Connection>(shared_from_this()),
+		                                                  std::placeholders::_1)));
 
 		// Read packet content
 		m_msg.setLength(size + NetworkMessage::header_length);
 		boost::asio::async_read(getHandle(), boost::asio::buffer(m_msg.getBodyBuffer(), size),
-		                        std::bind(&Connection::parsePacket, shared_from_this(), std::placeholders::_1));
+		                        m_strand.wrap(std::bind(&Connection::parsePacket, shared_from_this(), std::placeholders::_1)));
 	} catch (boost::system::system_error& e) {
 		if (m_logError) {
 			std::cout << "[Network error - Connection::parseHeader] " << e.what() << std::endl;
@@ -339,23 +344,50 @@ void Connection::parsePacket(const boost::system::error_code& error)
 			m_msg.getByte();    // Skip protocol ID
 		}
 
+		// the RSA decryption would hold up every connection served by this
+		// thread, the crypto pool resumes reading once it is done
+		if (m_protocol->hasRSAFirstMessage() && g_cryptoTasks.addTask(std::bind(&Connection::onRecvFirstMessage, shared_from_this()))) {
+			return;
+		}
+
 		m_protocol->onRecvFirstMessage(m_msg);
 	} else {
 		m_protocol->onRecvMessage(m_msg);    // Send the packet to the current protocol
 	}
 
+	readNextPacket();
+}
+
+void Connection::onRecvFirstMessage()
+{
+	//crypto thread
+	std::lock_guard<std::recursive_mutex> lockClass(m_connectionLock);
+
+	if (m_connectionState != CONNECTION_STATE_OPEN || m_readError) {
+		return;
+	}
+
+	m_protocol->onRecvFirstMessage(m_msg);
+
+	m_strand.post(std::bind(&Connection::readNextPacket, shared_from_this()));
+}
+
+void Connection::readNextPacket()
+{
+	std::lock_guard<std::recursive_mutex> lockClass(m_connectionLock);
+
 	try {
 		m_readTimer.expires_from_now(boost::posix_time::seconds(Connection::read_timeout));
-		m_readTimer.async_wait( std::bind(&Connection::handleReadTimeout, std::weak_ptr<Connection>(shared_from_this()),
-		                                    std::placeholders::_1));
+		m_readTimer.async_wait(m_strand.wrap(std::bind(&Connection::handleReadTimeout, std::weak_ptr<Connection>(shared_from_this()),
+		                                                  std::placeholders::_1)));
 
 		// Wait to the next packet
 		boost::asio::async_read(getHandle(),
 		                        boost::asio::buffer(m_msg.getBuffer(), NetworkMessage::header_length),
-		                        std::bind(&Connection::parseHeader, shared_from_this(), std::placeholders::_1));
+		                        m_strand.wrap(std::bind(&Connection::parseHeader, shared_from_this(), std::placeholders::_1)));
 	} catch (boost::system::system_error& e) {
 		if (m_logError) {
-			std::cout << "[Network error - Connection::parsePacket] " << e.what() << std::endl;
+			std::cout << "[Network error - Connection::readNextPacket] " << e.what() << std::endl;
 			m_logError = false;
 		}
 
@@ -371,29 +403,85 @@ bool Connection::send(OutputMessage_ptr msg)
 		return false;
 	}
 
+	msg->getProtocol()->releaseOutputBuffer(msg);
+	m_messageQueue.push_back(msg);
+	m_queuedBytes += msg->getLength();
+
+	// everything not yet written counts, a client that stops reading would
+	// otherwise pin an unbounded amount of messages
+	const size_t maxQueuedBytes = std::max<int32_t>(1, g_config.getNumber(ConfigManager::MAX_WRITE_QUEUE_BYTES));
+	if (m_queuedBytes > maxQueuedBytes) {
+		if (g_config.getBoolean(ConfigManager::FORCE_CLOSE_SLOW_CONNECTION) || m_queuedBytes > maxQueuedBytes * write_queue_hard_limit_factor) {
+			std::cout << convertIPToString(getIP()) << " disconnected for not keeping up with " << m_queuedBytes << " queued bytes." << std::endl;
+			close();
+			return true;
+		}
+	}
+
 	if (m_pendingWrite == 0) {
-		msg->getProtocol()->onSendMessage(msg);
-		internalSend(msg);
-	} else {
-		// FIXME: This results in packets being sent in wrong order, all queued
-		// packets to the same connection should also be moved to auto send.
-		OutputMessagePool::getInstance()->addToAutoSend(msg);
+		++m_pendingWrite;
+
+		// headers, encryption and the write itself happen on the strand
+		m_strand.post(std::bind(&Connection::onFlushMessages, shared_from_this()));
 	}
 
 	return true;
 }
 
-void Connection::internalSend(OutputMessage_ptr msg)
+void Connection::onFlushMessages()
+{
+	//io_service thread
+	std::unique_lock<std::recursive_mutex> lockClass(m_connectionLock);
+
+	if (m_connectionState != CONNECTION_STATE_OPEN || m_writeError) {
+		closeSocket();
+		close();
+		return;
+	}
+
+	internalSend(lockClass);
+}
+
+void Connection::internalSend(std::unique_lock<std::recursive_mutex>& lockClass)
 {
+	// everything queued since the last write goes out in one gathered write
+	m_writeBatch.assign(m_messageQueue.begin(), m_messageQueue.end());
+	m_messageQueue.clear();
+
+	m_writeBatchBytes = 0;
+	for (const OutputMessage_ptr& msg : m_writeBatch) {
+		m_writeBatchBytes += msg->getLength();
+	}
+
+	// the batch is only touched by handlers on the strand, so headers and
+	// encryption run unlocked and send() on the dispatcher does not wait
+	lockClass.unlock();
+
+	m_writeBuffers.clear();
+	for (const OutputMessage_ptr& msg : m_writeBatch) {
+		msg->getProtocol()->prepareMessage(*msg);
+		m_writeBuffers.emplace_back(msg->getOutputBuffer(), msg->getLength());
+	}
+
+	lockClass.lock();
+
+	if (m_connectionState != CONNECTION_STATE_OPEN || m_writeError) {
+		// closed meanwhile, the messages hold references on this connection
+		m_writeBatchBytes = 0;
+		m_writeBatch.clear();
+		m_writeBuffers.clear();
+		closeSocket();
+		close();
+		return;
+	}
+
 	try {
-		++m_pendingWrite;
 		m_writeTimer.expires_from_now(boost::posix_time::seconds(Connection::write_timeout));
-		m_writeTimer.async_wait( std::bind(&Connection::handleWriteTimeout, std::weak_ptr<Connection>(shared_from_this()),
-		                                     std::placeholders::_1));
+		m_writeTimer.async_wait(m_strand.wrap(std::bind(&Connection::handleWriteTimeout, std::weak_ptr<Connection>(shared_from_this()),
+		                                                   std::placeholders::_1)));
 
-		boost::asio::async_write(getHandle(),
-		                         boost::asio::buffer(msg->getOutputBuffer(), msg->getLength()),
-		                         std::bind(&Connection::onWriteOperation, shared_from_this(), msg, std::placeholders::_1));
+		boost::asio::async_write(getHandle(), m_writeBuffers,
+		                         m_strand.wrap(std::bind(&Connection::onWriteOperation, shared_from_this(), std::placeholders::_1)));
 	} catch (boost::system::system_error& e) {
 		if (m_logError) {
 			std::cout << "[Network error - Connection::internalSend] " << e.what() << std::endl;
@@ -415,12 +503,15 @@ uint32_t Connection::getIP() const
 	return htonl(endpoint.address().to_v4().to_ulong());
 }
 
-void Connection::onWriteOperation(OutputMessage_ptr msg, const boost::system::error_code& error)
+void Connection::onWriteOperation(const boost::system::error_code& error)
 {
-	std::lock_guard<std::recursive_mutex> lockClass(m_connectionLock);;
+	std::unique_lock<std::recursive_mutex> lockClass(m_connectionLock);
 	m_writeTimer.cancel();
 
-	msg.reset();
+	m_queuedBytes -= std::min(m_queuedBytes, m_writeBatchBytes);
+	m_writeBatchBytes = 0;
+	m_writeBatch.clear();
+	m_writeBuffers.clear();
 
 	if (error) {
 		handleWriteError(error);
@@ -432,7 +523,11 @@ void Connection::onWriteOperation(OutputMessage_ptr msg, const boost::system::er
 		return;
 	}
 
-	--m_pendingWrite;
+	if (!m_messageQueue.empty()) {
+		internalSend(lockClass);
+	} else {
+		--m_pendingWrite;
+	}
 }
 
 void Connection::handleReadError(const boost::system::error_code& error)
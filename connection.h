@@ -20,13 +20,21 @@
 #ifndef FS_CONNECTION_H_FC8E1B4392D24D27A2F129D8B93A6348
 #define FS_CONNECTION_H_FC8E1B4392D24D27A2F129D8B93A6348
 
+#include <atomic>
+#include <deque>
 #include <unordered_set>
 
+#include <boost/intrusive_ptr.hpp>
+
 #include "networkmessage.h"
 
 class Protocol;
 class OutputMessage;
-typedef std::shared_ptr<OutputMessage> OutputMessage_ptr;
+void intrusive_ptr_add_ref(OutputMessage* msg);
+void intrusive_ptr_release(OutputMessage* msg);
+typedef boost::intrusive_ptr<OutputMessage> OutputMessage_ptr;
+class CastFrame;
+typedef std::shared_ptr<CastFrame> CastFrame_ptr;
 class Connection;
 typedef std::shared_ptr<Connection> Connection_ptr;
 class ServiceBase;
@@ -63,6 +71,9 @@ class Connection : public std::enable_shared_from_this<Connection>
 
 		enum { write_timeout = 30 };
 		enum { read_timeout = 30 };
+		// a client that falls this many times past maxWriteQueueBytes behind is
+		// dropped even without forceSlowConnectionsToDisconnect
+		enum { write_queue_hard_limit_factor = 8 };
 
 		enum ConnectionState_t {
 			CONNECTION_STATE_OPEN,
@@ -76,6 +87,7 @@ class Connection : public std::enable_shared_from_this<Connection>
 		           ServicePort_ptr service_port) :
 			m_readTimer(io_service),
 			m_writeTimer(io_service),
+			m_strand(io_service),
 			m_service_port(service_port),
 			m_socket(socket),
 			m_io_service(io_service) {
@@ -83,6 +95,8 @@ class Connection : public std::enable_shared_from_this<Connection>
 			m_protocol = nullptr;
 			m_pendingWrite = 0;
 			m_pendingRead = 0;
+			m_queuedBytes = 0;
+			m_writeBatchBytes = 0;
 			m_connectionState = CONNECTION_STATE_OPEN;
 			m_receivedFirst = false;
 			m_writeError = false;
@@ -117,7 +131,10 @@ class Connection : public std::enable_shared_from_this<Connection>
 		void parseHeader(const boost::system::error_code& error);
 		void parsePacket(const boost::system::error_code& error);
 
-		void onWriteOperation(OutputMessage_ptr msg, const boost::system::error_code& error);
+		void onWriteOperation(const boost::system::error_code& error);
+		void onFlushMessages();
+		void onRecvFirstMessage();
+		void readNextPacket();
 
 		void onStopOperation();
 		void handleReadError(const boost::system::error_code& error);
@@ -133,13 +150,25 @@ class Connection : public std::enable_shared_from_this<Connection>
 		void onReadTimeout();
 		void onWriteTimeout();
 
-		void internalSend(OutputMessage_ptr msg);
+		// called with the lock held, releases it while the batch is prepared
+		void internalSend(std::unique_lock<std::recursive_mutex>& lockClass);
 
 		NetworkMessage m_msg;
 
+		// messages waiting for the next write, in send order
+		std::deque<OutputMessage_ptr> m_messageQueue;
+		// messages of the write in flight and the buffers pointing into them
+		std::vector<OutputMessage_ptr> m_writeBatch;
+		std::vector<boost::asio::const_buffer> m_writeBuffers;
+		size_t m_queuedBytes;
+		size_t m_writeBatchBytes;
+
 		boost::asio::deadline_timer m_readTimer;
 		boost::asio::deadline_timer m_writeTimer;
 
+		// serializes this connection's handlers across the network threads
+		boost::asio::io_service::strand m_strand;
+
 		std::recursive_mutex m_connectionLock;
 
 		ServicePort_ptr m_service_port;
@@ -150,7 +179,7 @@ class Connection : public std::enable_shared_from_this<Connection>
 
 		time_t m_timeConnected;
 		uint32_t m_packetsSent;
-		uint32_t m_refCount;
+		std::atomic<uint32_t> m_refCount;
 		int32_t m_pendingWrite;
 		int32_t m_pendingRead;
 		ConnectionState_t m_connectionState;
@@ -22,6 +22,7 @@
 #include "container.h"
 #include "iomap.h"
 #include "game.h"
+#include "housetile.h"
 #include "player.h"
 
 extern Game g_game;
@@ -547,6 +548,7 @@ void Container::updateThing(Thing* thing, uint16_t itemId, uint32_t count)
 	item->setID(itemId);
 	item->setSubType(count);
 	updateItemWeight(-oldWeight + item->getWeight());
+	HouseTile::setHouseDirty(item);
 
 	//send change to client
 	if (getParent()) {
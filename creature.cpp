@@ -64,6 +64,9 @@ Creature::Creature() :
 	eventWalk = 0;
 	cancelNextWalk = false;
 	forceUpdateFollowPath = false;
+	hasPrecomputedPath = false;
+	precomputedPathFound = false;
+	hasCachedPath = false;
 	isMapLoaded = false;
 	isUpdatingPath = false;
 
@@ -328,7 +331,7 @@ void Creature::addEventWalk(bool firstStep)
 		g_game.checkCreatureWalk(getID());
 	}
 
-	eventWalk = g_scheduler.addEvent(createSchedulerTask(ticks, std::bind(&Game::checkCreatureWalk, &g_game, getID())));
+	eventWalk = g_scheduler.addEvent(createSchedulerTask(ticks, std::bind(&Game::checkCreatureWalk, &g_game, getID()), TASK_CATEGORY_CREATURE_THINK));
 }
 
 void Creature::stopEventWalk()
@@ -961,7 +964,7 @@ void Creature::goToFollowCreature()
 				if (!monster->getDistanceStep(followCreature->getPosition(), dir)) {
 					// if we can't get anything then let the A* calculate
 					listWalkDir.clear();
-					if (getPathTo(followCreature->getPosition(), listWalkDir, fpp)) {
+					if (findFollowPath(followCreature->getPosition(), listWalkDir, fpp)) {
 						hasFollowPath = true;
 						startAutoWalk(listWalkDir);
 					} else {
@@ -981,7 +984,7 @@ void Creature::goToFollowCreature()
 			}
 		} else {
 			listWalkDir.clear();
-			if (getPathTo(followCreature->getPosition(), listWalkDir, fpp)) {
+			if (getFollowPath(followCreature->getPosition(), listWalkDir, fpp)) {
 				hasFollowPath = true;
 				startAutoWalk(listWalkDir);
 			} else {
@@ -1657,6 +1660,188 @@ bool Creature::getPathTo(const Position& targetPos, std::forward_list<Direction>
 	return g_game.map.getPathMatching(*this, dirList, FrozenPathingConditionCall(targetPos), fpp);
 }
 
+bool Creature::getFollowPath(const Position& targetPos, std::forward_list<Direction>& dirList, const FindPathParams& fpp)
+{
+	if (hasPrecomputedPath) {
+		hasPrecomputedPath = false;
+
+		// only usable if nothing relevant changed since it was computed
+		if (precomputedFrom == getPosition() && precomputedTo == targetPos && precomputedParams == fpp) {
+			dirList.swap(precomputedPath);
+			precomputedPath.clear();
+			return precomputedPathFound;
+		}
+		precomputedPath.clear();
+	}
+	return findFollowPath(targetPos, dirList, fpp);
+}
+
+bool Creature::findFollowPath(const Position& targetPos, std::forward_list<Direction>& dirList, const FindPathParams& fpp, bool buildFlowField/* = true*/)
+{
+	if (getCachedFollowPath(targetPos, dirList, fpp)) {
+		return true;
+	}
+
+	Map& map = g_game.map;
+
+	// monsters chasing the same target share one flow field
+	if (getMonster() && followCreature && followCreature->getPosition() == targetPos && fpp.maxTargetDist == 1 && fpp.allowDiagonal) {
+		const FlowField* field = map.getFlowField(*followCreature, buildFlowField);
+		if (field && map.getPathFromFlowField(*this, *field, dirList, fpp)) {
+			++map.pathCacheStats.flowFieldPaths;
+			cacheFollowPath(targetPos, dirList, fpp);
+			return true;
+		}
+	}
+
+	++map.pathCacheStats.misses;
+	if (!getPathTo(targetPos, dirList, fpp)) {
+		hasCachedPath = false;
+		return false;
+	}
+
+	cacheFollowPath(targetPos, dirList, fpp);
+	return true;
+}
+
+bool Creature::getCachedFollowPath(const Position& targetPos, std::forward_list<Direction>& dirList, const FindPathParams& fpp)
+{
+	if (!hasCachedPath || !(cachedPathParams == fpp)) {
+		return false;
+	}
+
+	// the creature has to still be somewhere along the path
+	const Position& pos = getPosition();
+	auto it = std::find(cachedPathNodes.begin(), cachedPathNodes.end(), pos);
+	if (it == cachedPathNodes.end()) {
+		hasCachedPath = false;
+		return false;
+	}
+
+	size_t first = it - cachedPathNodes.begin();
+	size_t last = cachedPathNodes.size() - 1;
+
+	const Map& map = g_game.map;
+	for (size_t i = first + 1; i <= last; ++i) {
+		if (map.getTileStamp(cachedPathNodes[i]) != cachedPathStamps[i]) {
+			hasCachedPath = false;
+			return false;
+		}
+	}
+
+	if (targetPos != cachedPathGoal) {
+		// a chased target that stepped one tile gets the old path spliced:
+		// cut it at the first tile next to the new position or add one step
+		if (fpp.maxTargetDist != 1 || targetPos.z != cachedPathGoal.z ||
+		        Position::getDistanceX(targetPos, cachedPathGoal) > 1 || Position::getDistanceY(targetPos, cachedPathGoal) > 1) {
+			return false;
+		}
+
+		FrozenPathingConditionCall pathCondition(targetPos);
+		int32_t bestMatch = 0;
+
+		size_t end = first;
+		while (end <= last && !pathCondition(pos, cachedPathNodes[end], fpp, bestMatch)) {
+			++end;
+		}
+
+		if (end > last) {
+			static const int_fast32_t neighbors[8][2] = {
+				{-1, 0}, {0, 1}, {1, 0}, {0, -1}, {-1, -1}, {1, -1}, {1, 1}, {-1, 1}
+			};
+
+			const Position endPos = cachedPathNodes[last];
+			bool extended = false;
+			for (uint_fast32_t i = 0, dirCount = (fpp.allowDiagonal ? 8 : 4); i < dirCount; ++i) {
+				Position nextPos(endPos.x + neighbors[i][0], endPos.y + neighbors[i][1], endPos.z);
+				if (fpp.maxSearchDist != 0 && (Position::getDistanceX(pos, nextPos) > fpp.maxSearchDist || Position::getDistanceY(pos, nextPos) > fpp.maxSearchDist)) {
+					continue;
+				}
+
+				if (!pathCondition(pos, nextPos, fpp, bestMatch) || !map.canWalkTo(*this, nextPos)) {
+					continue;
+				}
+
+				cachedPathNodes.push_back(nextPos);
+				cachedPathStamps.push_back(map.getTileStamp(nextPos));
+				extended = true;
+				break;
+			}
+
+			if (!extended) {
+				return false;
+			}
+		} else {
+			cachedPathNodes.resize(end + 1);
+			cachedPathStamps.resize(end + 1);
+		}
+
+		cachedPathGoal = targetPos;
+		++g_game.map.pathCacheStats.repairs;
+	} else {
+		++g_game.map.pathCacheStats.hits;
+	}
+
+	for (size_t i = cachedPathNodes.size() - 1; i > first; --i) {
+		dirList.push_front(getDirectionTo(cachedPathNodes[i - 1], cachedPathNodes[i]));
+	}
+	return true;
+}
+
+void Creature::cacheFollowPath(const Position& targetPos, const std::forward_list<Direction>& dirList, const FindPathParams& fpp)
+{
+	const Map& map = g_game.map;
+
+	Position pos = getPosition();
+	cachedPathNodes.clear();
+	cachedPathStamps.clear();
+	cachedPathNodes.push_back(pos);
+	cachedPathStamps.push_back(map.getTileStamp(pos));
+	for (Direction dir : dirList) {
+		pos = getNextPosition(dir, pos);
+		cachedPathNodes.push_back(pos);
+		cachedPathStamps.push_back(map.getTileStamp(pos));
+	}
+
+	cachedPathParams = fpp;
+	cachedPathGoal = targetPos;
+	hasCachedPath = true;
+}
+
+bool Creature::needsFollowPathUpdate(uint32_t interval) const
+{
+	// mirrors the conditions under which onThink calls goToFollowCreature
+	if (!followCreature || !getMonster()) {
+		return false;
+	}
+
+	if (master != followCreature && !canSeeCreature(followCreature)) {
+		return false;
+	}
+	return isUpdatingPath || forceUpdateFollowPath || walkUpdateTicks + interval >= 2000;
+}
+
+void Creature::precomputeFollowPath()
+{
+	// runs on a worker thread while the dispatcher waits, so it may only read game state
+	FindPathParams fpp;
+	getPathSearchParams(followCreature, fpp);
+
+	// distance and flee steps are picked by Monster::getDistanceStep, which
+	// rolls random numbers; those are left to onThink
+	const Monster* monster = getMonster();
+	if (monster && !monster->getMaster() && (monster->isFleeing() || fpp.maxTargetDist > 1)) {
+		return;
+	}
+
+	precomputedParams = fpp;
+	precomputedFrom = getPosition();
+	precomputedTo = followCreature->getPosition();
+	precomputedPath.clear();
+	precomputedPathFound = findFollowPath(precomputedTo, precomputedPath, fpp, false);
+	hasPrecomputedPath = true;
+}
+
 bool Creature::getPathTo(const Position& targetPos, std::forward_list<Direction>& dirList, int32_t minTargetDist, int32_t maxTargetDist, bool fullPathSearch /*= true*/, bool clearSight /*= true*/, int32_t maxSearchDist /*= 0*/) const
 {
 	FindPathParams fpp;
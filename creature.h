@@ -79,6 +79,12 @@ struct FindPathParams {
 		minTargetDist = -1;
 		maxTargetDist = -1;
 	}
+
+	bool operator==(const FindPathParams& other) const {
+		return fullPathSearch == other.fullPathSearch && clearSight == other.clearSight && allowDiagonal == other.allowDiagonal &&
+		       keepDistance == other.keepDistance && maxSearchDist == other.maxSearchDist && minTargetDist == other.minTargetDist &&
+		       maxTargetDist == other.maxTargetDist;
+	}
 };
 
 class Map;
@@ -488,6 +494,14 @@ class Creature : virtual public Thing
 		bool getPathTo(const Position& targetPos, std::forward_list<Direction>& dirList, const FindPathParams& fpp) const;
 		bool getPathTo(const Position& targetPos, std::forward_list<Direction>& dirList, int32_t minTargetDist, int32_t maxTargetDist, bool fullPathSearch = true, bool clearSight = true, int32_t maxSearchDist = 0) const;
 
+		// parallel creature think, see Game::precomputeCreatureThink
+		bool needsFollowPathUpdate(uint32_t interval) const;
+		void precomputeFollowPath();
+		void clearPrecomputedFollowPath() {
+			hasPrecomputedPath = false;
+			precomputedPath.clear();
+		}
+
 		void incrementReferenceCounter() {
 			++referenceCounter;
 		}
@@ -523,6 +537,18 @@ class Creature : virtual public Thing
 
 		std::forward_list<Direction> listWalkDir;
 
+		// follow path computed ahead of onThink by the parallel think phase
+		std::forward_list<Direction> precomputedPath;
+		FindPathParams precomputedParams;
+		Position precomputedFrom;
+		Position precomputedTo;
+
+		// last follow path found, see findFollowPath
+		std::vector<Position> cachedPathNodes;
+		std::vector<uint32_t> cachedPathStamps;
+		FindPathParams cachedPathParams;
+		Position cachedPathGoal;
+
 		Tile* _tile;
 		Creature* attackedCreature;
 		Creature* master;
@@ -564,6 +590,9 @@ class Creature : virtual public Thing
 		bool cancelNextWalk;
 		bool hasFollowPath;
 		bool forceUpdateFollowPath;
+		bool hasPrecomputedPath;
+		bool precomputedPathFound;
+		bool hasCachedPath;
 		bool hiddenHealth;
 
 		//creature script events
@@ -572,6 +601,11 @@ class Creature : virtual public Thing
 		}
 		CreatureEventList getCreatureEvents(CreatureEventType_t type);
 
+		bool getFollowPath(const Position& targetPos, std::forward_list<Direction>& dirList, const FindPathParams& fpp);
+		bool findFollowPath(const Position& targetPos, std::forward_list<Direction>& dirList, const FindPathParams& fpp, bool buildFlowField = true);
+		bool getCachedFollowPath(const Position& targetPos, std::forward_list<Direction>& dirList, const FindPathParams& fpp);
+		void cacheFollowPath(const Position& targetPos, const std::forward_list<Direction>& dirList, const FindPathParams& fpp);
+
 		void updateMapCache();
 		void updateTileCache(const Tile* tile, int32_t dx, int32_t dy);
 		void updateTileCache(const Tile* tile, const Position& pos);
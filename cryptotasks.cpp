@@ -0,0 +1,118 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2015  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "otpch.h"
+
+#include "cryptotasks.h"
+
+CryptoTasks::CryptoTasks()
+{
+	threadState = THREAD_STATE_TERMINATED;
+}
+
+void CryptoTasks::start(size_t threadCount)
+{
+	if (!threads.empty() || threadCount == 0) {
+		return;
+	}
+
+	threadState = THREAD_STATE_RUNNING;
+	for (size_t i = 0; i < threadCount; ++i) {
+		threads.emplace_back(&CryptoTasks::run, this);
+	}
+}
+
+std::unique_ptr<Database> CryptoTasks::connectWorker()
+{
+	std::unique_ptr<Database> db(new Database);
+	if (!db->connect()) {
+		std::cout << "> WARNING: Login crypto worker could not connect to the database, using the shared connection." << std::endl;
+		return nullptr;
+	}
+
+	Database::setThreadInstance(db.get());
+	return db;
+}
+
+void CryptoTasks::run()
+{
+	// opened on the first task, the workers start before the database is set up
+	std::unique_ptr<Database> db;
+	bool connectTried = false;
+
+	std::unique_lock<std::mutex> taskLockUnique(taskLock);
+	while (true) {
+		taskSignal.wait(taskLockUnique, [this]() {
+			return threadState == THREAD_STATE_TERMINATED || !tasks.empty();
+		});
+
+		if (threadState == THREAD_STATE_TERMINATED) {
+			break;
+		}
+
+		std::function<void(void)> task = std::move(tasks.front());
+		tasks.pop_front();
+		taskLockUnique.unlock();
+
+		if (!connectTried) {
+			db = connectWorker();
+			connectTried = true;
+		}
+
+		task();
+
+		taskLockUnique.lock();
+	}
+
+	Database::setThreadInstance(nullptr);
+}
+
+bool CryptoTasks::addTask(std::function<void(void)> task)
+{
+	taskLock.lock();
+	if (threadState != THREAD_STATE_RUNNING) {
+		taskLock.unlock();
+		return false;
+	}
+
+	tasks.push_back(std::move(task));
+	taskLock.unlock();
+
+	taskSignal.notify_one();
+	return true;
+}
+
+void CryptoTasks::shutdown()
+{
+	taskLock.lock();
+	threadState = THREAD_STATE_TERMINATED;
+	// pending handshakes belong to connections that are being closed anyway
+	tasks.clear();
+	taskLock.unlock();
+	taskSignal.notify_all();
+}
+
+void CryptoTasks::join()
+{
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+}
@@ -0,0 +1,66 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2015  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef FS_CRYPTOTASKS_H_6B1E4D2A9C7F4B3E8A5D0F2C1E9B7A43
+#define FS_CRYPTOTASKS_H_6B1E4D2A9C7F4B3E8A5D0F2C1E9B7A43
+
+#include <condition_variable>
+#include <list>
+#include <thread>
+
+#include "database.h"
+#include "enums.h"
+
+// Small pool that runs the RSA part of the login handshake away from the
+// network threads, so a login storm does not stall established connections.
+// The ban and account checks that follow the handshake run on the same
+// worker; each worker opens a database connection of its own for them on
+// its first task, so logins do not queue behind the dispatcher's queries.
+class CryptoTasks
+{
+	public:
+		CryptoTasks();
+
+		// non-copyable
+		CryptoTasks(const CryptoTasks&) = delete;
+		CryptoTasks& operator=(const CryptoTasks&) = delete;
+
+		void start(size_t threadCount);
+		void shutdown();
+		void join();
+
+		// returns false if the pool is not running, the caller then has to
+		// run the task itself
+		bool addTask(std::function<void(void)> task);
+
+	private:
+		void run();
+		static std::unique_ptr<Database> connectWorker();
+
+		std::vector<std::thread> threads;
+		std::list<std::function<void(void)>> tasks;
+		std::mutex taskLock;
+		std::condition_variable taskSignal;
+		ThreadState threadState;
+};
+
+extern CryptoTasks g_cryptoTasks;
+
+#endif
@@ -26,6 +26,13 @@
 
 extern ConfigManager g_config;
 
+thread_local Database* Database::threadInstance = nullptr;
+
+static bool isConnectionError(unsigned int error)
+{
+	return error == CR_SERVER_LOST || error == CR_SERVER_GONE_ERROR || error == CR_CONN_HOST_ERROR || error == 1053/*ER_SERVER_SHUTDOWN*/ || error == CR_CONNECTION_ERROR;
+}
+
 Database::Database()
 {
 	handle = nullptr;
@@ -34,6 +41,9 @@ Database::Database()
 
 Database::~Database()
 {
+	// the statements have to be closed while the connection is still open
+	statements.clear();
+
 	if (handle != nullptr) {
 		mysql_close(handle);
 	}
@@ -108,8 +118,7 @@ bool Database::executeQuery(const std::string& query)
 
 	while (mysql_real_query(handle, query.c_str(), query.length()) != 0) {
 		std::cout << "[Error - mysql_real_query] Query: " << query.substr(0, 256) << std::endl << "Message: " << mysql_error(handle) << std::endl;
-		auto error = mysql_errno(handle);
-		if (error != CR_SERVER_LOST && error != CR_SERVER_GONE_ERROR && error != CR_CONN_HOST_ERROR && error != 1053/*ER_SERVER_SHUTDOWN*/ && error != CR_CONNECTION_ERROR) {
+		if (!isConnectionError(mysql_errno(handle))) {
 			success = false;
 			break;
 		}
@@ -133,8 +142,7 @@ DBResult_ptr Database::storeQuery(const std::string& query)
 	retry:
 	while (mysql_real_query(handle, query.c_str(), query.length()) != 0) {
 		std::cout << "[Error - mysql_real_query] Query: " << query << std::endl << "Message: " << mysql_error(handle) << std::endl;
-		auto error = mysql_errno(handle);
-		if (error != CR_SERVER_LOST && error != CR_SERVER_GONE_ERROR && error != CR_CONN_HOST_ERROR && error != 1053/*ER_SERVER_SHUTDOWN*/ && error != CR_CONNECTION_ERROR) {
+		if (!isConnectionError(mysql_errno(handle))) {
 			break;
 		}
 		std::this_thread::sleep_for(std::chrono::seconds(1));
@@ -145,8 +153,7 @@ DBResult_ptr Database::storeQuery(const std::string& query)
 	MYSQL_RES* res = mysql_store_result(handle);
 	if (res == nullptr) {
 		std::cout << "[Error - mysql_store_result] Query: " << query << std::endl << "Message: " << mysql_error(handle) << std::endl;
-		auto error = mysql_errno(handle);
-		if (error != CR_SERVER_LOST && error != CR_SERVER_GONE_ERROR && error != CR_CONN_HOST_ERROR && error != 1053/*ER_SERVER_SHUTDOWN*/ && error != CR_CONNECTION_ERROR) {
+		if (!isConnectionError(mysql_errno(handle))) {
 			databaseLock.unlock();
 			return nullptr;
 		}
@@ -162,6 +169,16 @@ DBResult_ptr Database::storeQuery(const std::string& query)
 	return result;
 }
 
+DBStatement* Database::prepare(const std::string& query)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(databaseLock);
+	std::unique_ptr<DBStatement>& statement = statements[query];
+	if (!statement) {
+		statement.reset(new DBStatement(*this, query));
+	}
+	return statement.get();
+}
+
 std::string Database::escapeString(const std::string& s) const
 {
 	return escapeBlob(s.c_str(), s.length());
@@ -251,7 +268,282 @@ bool DBResult::next()
 	return row != nullptr;
 }
 
-DBInsert::DBInsert(std::string query) : query(query)
+DBStatement::~DBStatement()
+{
+	close();
+}
+
+DBStatement::Parameter& DBStatement::getParameter(size_t index)
+{
+	if (index >= parameters.size()) {
+		parameters.resize(index + 1);
+	}
+	return parameters[index];
+}
+
+void DBStatement::bindNumber(size_t index, int64_t value, bool isUnsigned)
+{
+	Parameter& parameter = getParameter(index);
+	parameter.number = value;
+	parameter.type = MYSQL_TYPE_LONGLONG;
+	parameter.isUnsigned = isUnsigned;
+}
+
+void DBStatement::bind(size_t index, const std::string& value)
+{
+	Parameter& parameter = getParameter(index);
+	parameter.data = value;
+	// compared like the column, a BLOB would make `name` = ? case sensitive
+	parameter.type = MYSQL_TYPE_STRING;
+}
+
+void DBStatement::bindBlob(size_t index, const char* data, size_t size)
+{
+	Parameter& parameter = getParameter(index);
+	parameter.data.assign(data, size);
+	parameter.type = MYSQL_TYPE_BLOB;
+}
+
+bool DBStatement::prepare()
+{
+	handle = mysql_stmt_init(db.handle);
+	if (!handle) {
+		std::cout << "[Error - mysql_stmt_init] Message: " << mysql_error(db.handle) << std::endl;
+		return false;
+	}
+
+	if (mysql_stmt_prepare(handle, query.c_str(), query.length()) != 0) {
+		std::cout << "[Error - mysql_stmt_prepare] Query: " << query.substr(0, 256) << std::endl << "Message: " << mysql_stmt_error(handle) << std::endl;
+		return false;
+	}
+
+	if (mysql_stmt_param_count(handle) != parameters.size()) {
+		std::cout << "[Error - DBStatement::prepare] Query: " << query.substr(0, 256) << std::endl << "Message: " << parameters.size() << " of " << mysql_stmt_param_count(handle) << " parameters bound" << std::endl;
+		return false;
+	}
+
+	// lets bindColumns size the buffers of the text columns to their longest value
+	my_bool updateMaxLength = true;
+	mysql_stmt_attr_set(handle, STMT_ATTR_UPDATE_MAX_LENGTH, &updateMaxLength);
+	return true;
+}
+
+bool DBStatement::execute(bool store)
+{
+	parameterBinds.assign(parameters.size(), MYSQL_BIND());
+	for (size_t i = 0; i < parameters.size(); ++i) {
+		Parameter& parameter = parameters[i];
+		MYSQL_BIND& bind = parameterBinds[i];
+		bind.buffer_type = parameter.type;
+		if (parameter.type == MYSQL_TYPE_LONGLONG) {
+			bind.buffer = &parameter.number;
+			bind.is_unsigned = parameter.isUnsigned;
+		} else {
+			bind.buffer = const_cast<char*>(parameter.data.data());
+			bind.buffer_length = parameter.data.length();
+		}
+	}
+
+	if (mysql_stmt_bind_param(handle, parameterBinds.data()) != 0) {
+		std::cout << "[Error - mysql_stmt_bind_param] Query: " << query.substr(0, 256) << std::endl << "Message: " << mysql_stmt_error(handle) << std::endl;
+		return false;
+	}
+
+	++executions;
+	if (mysql_stmt_execute(handle) != 0) {
+		std::cout << "[Error - mysql_stmt_execute] Query: " << query.substr(0, 256) << std::endl << "Message: " << mysql_stmt_error(handle) << std::endl;
+		return false;
+	}
+
+	if (store && mysql_stmt_store_result(handle) != 0) {
+		std::cout << "[Error - mysql_stmt_store_result] Query: " << query.substr(0, 256) << std::endl << "Message: " << mysql_stmt_error(handle) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool DBStatement::run(bool store)
+{
+	bool retried = false;
+	while (true) {
+		if ((handle || prepare()) && execute(store)) {
+			return true;
+		}
+
+		unsigned int error = handle ? mysql_stmt_errno(handle) : 0;
+		close();
+
+		// a reconnect drops every statement of the connection, the first
+		// retry prepares this one again without waiting
+		if (!isConnectionError(error) && error != 1243/*ER_UNKNOWN_STMT_HANDLER*/) {
+			return false;
+		}
+
+		if (retried) {
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+		}
+		retried = true;
+	}
+}
+
+bool DBStatement::bindColumns()
+{
+	MYSQL_RES* metadata = mysql_stmt_result_metadata(handle);
+	if (!metadata) {
+		std::cout << "[Error - mysql_stmt_result_metadata] Query: " << query.substr(0, 256) << std::endl << "Message: " << mysql_stmt_error(handle) << std::endl;
+		return false;
+	}
+
+	const unsigned int count = mysql_num_fields(metadata);
+	const MYSQL_FIELD* fields = mysql_fetch_fields(metadata);
+
+	columns.resize(count);
+	columnBinds.assign(count, MYSQL_BIND());
+	for (unsigned int i = 0; i < count; ++i) {
+		Column& column = columns[i];
+		MYSQL_BIND& bind = columnBinds[i];
+		switch (fields[i].type) {
+			case MYSQL_TYPE_TINY:
+			case MYSQL_TYPE_SHORT:
+			case MYSQL_TYPE_INT24:
+			case MYSQL_TYPE_LONG:
+			case MYSQL_TYPE_LONGLONG:
+			case MYSQL_TYPE_YEAR:
+				column.isNumber = true;
+				bind.buffer_type = MYSQL_TYPE_LONGLONG;
+				bind.buffer = &column.number;
+				bind.is_unsigned = (fields[i].flags & UNSIGNED_FLAG) != 0;
+				break;
+
+			default:
+				column.isNumber = false;
+				column.data.resize(std::max<unsigned long>(1, fields[i].max_length));
+				bind.buffer_type = MYSQL_TYPE_BLOB;
+				bind.buffer = column.data.data();
+				bind.buffer_length = column.data.size();
+				break;
+		}
+		bind.length = &column.length;
+		bind.is_null = &column.isNull;
+		bind.error = &column.error;
+	}
+	mysql_free_result(metadata);
+
+	if (mysql_stmt_bind_result(handle, columnBinds.data()) != 0) {
+		std::cout << "[Error - mysql_stmt_bind_result] Query: " << query.substr(0, 256) << std::endl << "Message: " << mysql_stmt_error(handle) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void DBStatement::close()
+{
+	if (handle) {
+		mysql_stmt_close(handle);
+		handle = nullptr;
+	}
+}
+
+bool DBStatement::executeQuery()
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(db.databaseLock);
+	return run(false);
+}
+
+DBStatementResult_ptr DBStatement::storeQuery()
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(db.databaseLock);
+	if (!run(true)) {
+		return nullptr;
+	}
+
+	if (!bindColumns()) {
+		mysql_stmt_free_result(handle);
+		return nullptr;
+	}
+
+	DBStatementResult_ptr result = std::make_shared<DBStatementResult>(*this);
+	if (!result->hasNext()) {
+		return nullptr;
+	}
+	return result;
+}
+
+DBStatementResult::DBStatementResult(DBStatement& statement) : statement(statement), execution(statement.executions)
+{
+	hasRow = false;
+	next();
+}
+
+DBStatementResult::~DBStatementResult()
+{
+	// the statement may have run again since, the rows are not ours anymore then
+	if (execution == statement.executions && statement.handle) {
+		mysql_stmt_free_result(statement.handle);
+	}
+}
+
+const DBStatement::Column* DBStatementResult::getColumn(size_t column, const char* function) const
+{
+	if (execution != statement.executions) {
+		std::cout << "[Error - DBStatementResult::" << function << "] The statement ran again, this result has ended" << std::endl;
+		return nullptr;
+	}
+
+	if (!hasRow || column >= statement.columns.size()) {
+		std::cout << "[Error - DBStatementResult::" << function << "] Column " << column << " doesn't exist in the result set" << std::endl;
+		return nullptr;
+	}
+	return &statement.columns[column];
+}
+
+std::string DBStatementResult::getString(size_t column) const
+{
+	const DBStatement::Column* value = getColumn(column, "getString");
+	if (!value || value->isNull) {
+		return std::string();
+	}
+
+	if (value->isNumber) {
+		const MYSQL_BIND& bind = statement.columnBinds[column];
+		return bind.is_unsigned ? std::to_string(static_cast<uint64_t>(value->number)) : std::to_string(value->number);
+	}
+	return std::string(value->data.data(), value->length);
+}
+
+const char* DBStatementResult::getStream(size_t column, unsigned long& size) const
+{
+	const DBStatement::Column* value = getColumn(column, "getStream");
+	if (!value || value->isNull || value->isNumber) {
+		size = 0;
+		return nullptr;
+	}
+
+	size = value->length;
+	return value->data.data();
+}
+
+bool DBStatementResult::next()
+{
+	if (execution != statement.executions || !statement.handle) {
+		hasRow = false;
+		return false;
+	}
+
+	int status = mysql_stmt_fetch(statement.handle);
+	if (status == MYSQL_DATA_TRUNCATED) {
+		// cannot happen while the buffers are sized to max_length
+		std::cout << "[Warning - DBStatementResult::next] Truncated column in: " << statement.query.substr(0, 256) << std::endl;
+		status = 0;
+	} else if (status == 1) {
+		std::cout << "[Error - mysql_stmt_fetch] Message: " << mysql_stmt_error(statement.handle) << std::endl;
+	}
+
+	hasRow = status == 0;
+	return hasRow;
+}
+
+DBInsert::DBInsert(std::string query, Database* db/* = Database::getInstance()*/) : db(db), query(query)
 {
 	this->length = this->query.length();
 }
@@ -261,7 +553,7 @@ bool DBInsert::addRow(const std::string& row)
 	// adds new row to buffer
 	const size_t rowLength = row.length();
 	length += rowLength;
-	if (length > Database::getInstance()->getMaxPacketSize() && !execute()) {
+	if (length > db->getMaxPacketSize() && !execute()) {
 		return false;
 	}
 
@@ -287,6 +579,18 @@ bool DBInsert::addRow(std::ostringstream& row)
 	return ret;
 }
 
+void DBInsert::upsert(const std::vector<std::string>& columns)
+{
+	upsertQuery = " ON DUPLICATE KEY UPDATE ";
+	for (const std::string& column : columns) {
+		if (&column != &columns.front()) {
+			upsertQuery.push_back(',');
+		}
+		upsertQuery.append('`' + column + "` = VALUES(`" + column + "`)");
+	}
+	length = query.length() + upsertQuery.length() + values.length();
+}
+
 bool DBInsert::execute()
 {
 	if (values.empty()) {
@@ -294,8 +598,8 @@ bool DBInsert::execute()
 	}
 
 	// executes buffer
-	bool res = Database::getInstance()->executeQuery(query + values);
+	bool res = db->executeQuery(query + values + upsertQuery);
 	values.clear();
-	length = query.length();
+	length = query.length() + upsertQuery.length();
 	return res;
 }
@@ -26,6 +26,9 @@
 
 class DBResult;
 typedef std::shared_ptr<DBResult> DBResult_ptr;
+class DBStatement;
+class DBStatementResult;
+typedef std::shared_ptr<DBStatementResult> DBStatementResult_ptr;
 
 class Database
 {
@@ -40,14 +43,28 @@ class Database
 		/**
 		 * Singleton implementation.
 		 *
-		 * @return database connection handler singleton
+		 * @return the connection set for the calling thread, the shared
+		 * connection handler singleton if there is none
 		 */
 		static Database* getInstance()
 		{
+			if (threadInstance) {
+				return threadInstance;
+			}
+
 			static Database instance;
 			return &instance;
 		}
 
+		/**
+		 * Makes getInstance return db on the calling thread, for threads
+		 * that keep a connection of their own; nullptr goes back to the
+		 * shared one.
+		 */
+		static void setThreadInstance(Database* db) {
+			threadInstance = db;
+		}
+
 		/**
 		 * Connects to the database
 		 *
@@ -74,6 +91,17 @@ class Database
 		 */
 		DBResult_ptr storeQuery(const std::string& query);
 
+		/**
+		 * Prepared statement.
+		 *
+		 * The statement is kept by this connection and prepared on the server
+		 * the first time it runs, later calls with the same query return it again.
+		 *
+		 * @param query statement with a ? for every parameter
+		 * @return statement owned by this connection
+		 */
+		DBStatement* prepare(const std::string& query);
+
 		/**
 		 * Escapes string for query.
 		 *
@@ -130,11 +158,15 @@ class Database
 		bool commit();
 
 	private:
+		static thread_local Database* threadInstance;
+
 		MYSQL* handle;
 		std::recursive_mutex databaseLock;
 		uint64_t maxPacketSize;
+		std::unordered_map<std::string, std::unique_ptr<DBStatement>> statements;
 
 	friend class DBTransaction;
+	friend class DBStatement;
 };
 
 class DBResult
@@ -184,33 +216,162 @@ class DBResult
 	friend class Database;
 };
 
+/**
+ * Statement running over the binary protocol: numbers are sent and read as
+ * they are instead of being printed and parsed, strings need no escaping and
+ * columns are read by their position. Like its connection a statement is
+ * used by one thread at a time; running it again ends its previous result.
+ */
+class DBStatement
+{
+	public:
+		~DBStatement();
+
+		// non-copyable
+		DBStatement(const DBStatement&) = delete;
+		DBStatement& operator=(const DBStatement&) = delete;
+
+		// parameters keep their value until they are bound again, the first ? is 0
+		template<typename T>
+		void bind(size_t index, T value)
+		{
+			static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "DBStatement::bind: numbers and std::string only");
+			bindNumber(index, static_cast<int64_t>(value), std::is_unsigned<T>::value);
+		}
+		void bind(size_t index, const std::string& value);
+		void bindBlob(size_t index, const char* data, size_t size);
+
+		bool executeQuery();
+		DBStatementResult_ptr storeQuery();
+
+		uint64_t getLastInsertId() const {
+			return handle ? static_cast<uint64_t>(mysql_stmt_insert_id(handle)) : 0;
+		}
+
+	private:
+		DBStatement(Database& db, std::string query) : db(db), query(std::move(query)) {}
+
+		struct Parameter {
+			std::string data;
+			int64_t number = 0;
+			enum_field_types type = MYSQL_TYPE_NULL;
+			bool isUnsigned = false;
+		};
+
+		struct Column {
+			std::vector<char> data;
+			unsigned long length = 0;
+			int64_t number = 0;
+			my_bool isNull = false;
+			my_bool error = false;
+			bool isNumber = false;
+		};
+
+		Parameter& getParameter(size_t index);
+		void bindNumber(size_t index, int64_t value, bool isUnsigned);
+
+		bool prepare();
+		bool execute(bool store);
+		bool run(bool store);
+		bool bindColumns();
+		void close();
+
+		Database& db;
+		std::string query;
+		MYSQL_STMT* handle = nullptr;
+
+		std::vector<Parameter> parameters;
+		std::vector<MYSQL_BIND> parameterBinds;
+		std::vector<Column> columns;
+		std::vector<MYSQL_BIND> columnBinds;
+
+		// tells a result whether it still owns the rows of the statement
+		uint32_t executions = 0;
+
+	friend class Database;
+	friend class DBStatementResult;
+};
+
+class DBStatementResult
+{
+	public:
+		explicit DBStatementResult(DBStatement& statement);
+		~DBStatementResult();
+
+		// non-copyable
+		DBStatementResult(const DBStatementResult&) = delete;
+		DBStatementResult& operator=(const DBStatementResult&) = delete;
+
+		// columns are numbered in the order of the SELECT list, starting at 0
+		template<typename T>
+		T getNumber(size_t column) const
+		{
+			const DBStatement::Column* value = getColumn(column, "getNumber");
+			if (!value || value->isNull) {
+				return static_cast<T>(0);
+			}
+
+			if (value->isNumber) {
+				return static_cast<T>(value->number);
+			}
+
+			// DECIMAL and other types that are sent as text, e.g. SUM()
+			T data;
+			try {
+				data = boost::lexical_cast<T>(value->data.data(), value->length);
+			} catch (boost::bad_lexical_cast&) {
+				data = 0;
+			}
+			return data;
+		}
+
+		std::string getString(size_t column) const;
+		const char* getStream(size_t column, unsigned long& size) const;
+
+		bool hasNext() const {
+			return hasRow;
+		}
+		bool next();
+
+	private:
+		const DBStatement::Column* getColumn(size_t column, const char* function) const;
+
+		DBStatement& statement;
+		uint32_t execution;
+		bool hasRow;
+};
+
 /**
  * INSERT statement.
  */
 class DBInsert
 {
 	public:
-		explicit DBInsert(std::string query);
+		explicit DBInsert(std::string query, Database* db = Database::getInstance());
 		bool addRow(const std::string& row);
 		bool addRow(std::ostringstream& row);
+		// turns the statement into INSERT ... ON DUPLICATE KEY UPDATE of these columns
+		void upsert(const std::vector<std::string>& columns);
 		bool execute();
 
 	protected:
+		Database* db;
 		std::string query;
 		std::string values;
+		std::string upsertQuery;
 		size_t length;
 };
 
 class DBTransaction
 {
 	public:
-		DBTransaction() {
+		explicit DBTransaction(Database* db = Database::getInstance()) : db(db) {
 			state = STATE_NO_START;
 		}
 
 		~DBTransaction() {
 			if (state == STATE_START) {
-				Database::getInstance()->rollback();
+				db->rollback();
 			}
 		}
 
@@ -220,7 +381,7 @@ class DBTransaction
 
 		bool begin() {
 			state = STATE_START;
-			return Database::getInstance()->beginTransaction();
+			return db->beginTransaction();
 		}
 
 		bool commit() {
@@ -229,7 +390,7 @@ class DBTransaction
 			}
 
 			state = STEATE_COMMIT;
-			return Database::getInstance()->commit();
+			return db->commit();
 		}
 
 	private:
@@ -239,6 +400,7 @@ class DBTransaction
 			STEATE_COMMIT,
 		};
 
+		Database* db;
 		TransactionStates_t state;
 };
 
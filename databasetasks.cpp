@@ -21,6 +21,7 @@
 
 #include "databasetasks.h"
 #include "tasks.h"
+#include "taskstats.h"
 
 extern Dispatcher g_dispatcher;
 
@@ -29,50 +30,94 @@ DatabaseTasks::DatabaseTasks()
 	threadState = THREAD_STATE_TERMINATED;
 }
 
-void DatabaseTasks::start()
+void DatabaseTasks::start(size_t threadCount)
 {
-	db.connect();
+	if (!threads.empty()) {
+		return;
+	}
+
+	for (size_t i = 0; i < std::max<size_t>(1, threadCount); ++i) {
+		std::unique_ptr<Database> db(new Database);
+		if (!db->connect()) {
+			std::cout << "> WARNING: Database task worker " << i << " could not connect." << std::endl;
+			continue;
+		}
+		connections.push_back(std::move(db));
+	}
+
+	if (connections.empty()) {
+		return;
+	}
+
 	threadState = THREAD_STATE_RUNNING;
-	thread = std::thread(&DatabaseTasks::run, this);
+	for (const auto& db : connections) {
+		threads.emplace_back(&DatabaseTasks::run, this, db.get());
+	}
 }
 
-void DatabaseTasks::run()
+std::list<DatabaseTask>::iterator DatabaseTasks::getRunnableTask()
 {
-	std::unique_lock<std::mutex> taskLockUnique(taskLock, std::defer_lock);
-	while (threadState != THREAD_STATE_TERMINATED) {
-		taskLockUnique.lock();
-		if (tasks.empty()) {
+	auto it = tasks.begin();
+	while (it != tasks.end() && it->key != 0 && runningKeys.find(it->key) != runningKeys.end()) {
+		++it;
+	}
+	return it;
+}
+
+void DatabaseTasks::run(Database* db)
+{
+	std::unique_lock<std::mutex> taskLockUnique(taskLock);
+	while (true) {
+		auto it = getRunnableTask();
+		if (it == tasks.end()) {
+			if (threadState == THREAD_STATE_TERMINATED && tasks.empty()) {
+				// wake the workers still waiting so they can exit too
+				taskSignal.notify_all();
+				break;
+			}
+
+			// either idle or every queued task waits for a key held by
+			// another worker, which picks that task up itself when done
 			taskSignal.wait(taskLockUnique);
+			continue;
+		}
+
+		DatabaseTask task = std::move(*it);
+		tasks.erase(it);
+		if (task.key != 0) {
+			runningKeys.insert(task.key);
 		}
+		taskLockUnique.unlock();
 
-		if (!tasks.empty()) {
-			DatabaseTask task = std::move(tasks.front());
-			tasks.pop_front();
-			taskLockUnique.unlock();
-			runTask(task);
-		} else {
-			taskLockUnique.unlock();
+		runTask(*db, task);
+
+		taskLockUnique.lock();
+		if (task.key != 0) {
+			runningKeys.erase(task.key);
 		}
 	}
 }
 
-void DatabaseTasks::addTask(const std::string& query, const std::function<void(DBResult_ptr, bool)>& callback/* = nullptr*/, bool store/* = false*/)
+void DatabaseTasks::addTask(const std::string& query, const std::function<void(DBResult_ptr, bool)>& callback/* = nullptr*/, bool store/* = false*/, uint32_t key/* = 0*/)
 {
-	bool signal = false;
 	taskLock.lock();
-	if (threadState == THREAD_STATE_RUNNING) {
-		signal = tasks.empty();
-		tasks.emplace_back(query, callback, store);
+	if (threadState != THREAD_STATE_RUNNING) {
+		taskLock.unlock();
+		return;
 	}
+
+	tasks.emplace_back(query, callback, store, key, TaskStats::now());
+	uint32_t depth = tasks.size();
 	taskLock.unlock();
 
-	if (signal) {
-		taskSignal.notify_one();
-	}
+	g_taskStats.recordDatabaseQueueDepth(depth);
+	taskSignal.notify_one();
 }
 
-void DatabaseTasks::runTask(const DatabaseTask& task)
+void DatabaseTasks::runTask(Database& db, const DatabaseTask& task)
 {
+	const int64_t startTime = TaskStats::now();
+
 	bool success;
 	DBResult_ptr result;
 	if (task.store) {
@@ -83,17 +128,17 @@ void DatabaseTasks::runTask(const DatabaseTask& task)
 		success = db.executeQuery(task.query);
 	}
 
+	g_taskStats.recordDatabaseQuery(startTime - task.queuedAt, TaskStats::now() - startTime);
+
 	if (task.callback) {
-		g_dispatcher.addTask(createTask(std::bind(task.callback, result, success)));
+		g_dispatcher.addTask(createTask(std::bind(task.callback, result, success), TASK_CATEGORY_DATABASE));
 	}
 }
 
-void DatabaseTasks::flush()
+uint32_t DatabaseTasks::getQueueDepth()
 {
-	while (!tasks.empty()) {
-		runTask(tasks.front());
-		tasks.pop_front();
-	}
+	std::lock_guard<std::mutex> lockGuard(taskLock);
+	return tasks.size();
 }
 
 void DatabaseTasks::stop()
@@ -107,14 +152,15 @@ void DatabaseTasks::shutdown()
 {
 	taskLock.lock();
 	threadState = THREAD_STATE_TERMINATED;
-	flush();
 	taskLock.unlock();
-	taskSignal.notify_one();
+	taskSignal.notify_all();
 }
 
 void DatabaseTasks::join()
 {
-	if (thread.joinable()) {
+	for (std::thread& thread : threads) {
 		thread.join();
 	}
+	threads.clear();
+	connections.clear();
 }
@@ -23,38 +23,62 @@
 #include <condition_variable>
 #include <list>
 #include <thread>
+#include <unordered_set>
 
 #include "database.h"
 #include "enums.h"
 
+// ordering key shared by db.asyncQuery and db.asyncStoreQuery, scripts may
+// rely on their queries running in the order they were issued
+#define DATABASE_TASK_KEY_SCRIPTS 0xFFFFFFFF
+
 struct DatabaseTask {
-	DatabaseTask(std::string query, const std::function<void(DBResult_ptr, bool)>& callback, bool store) :
-		query(query), callback(callback), store(store) {}
+	DatabaseTask(std::string query, const std::function<void(DBResult_ptr, bool)>& callback, bool store, uint32_t key, int64_t queuedAt) :
+		query(query), callback(callback), queuedAt(queuedAt), key(key), store(store) {}
 
 	std::string query;
 	std::function<void(DBResult_ptr, bool)> callback;
+	int64_t queuedAt;
+	uint32_t key;
 	bool store;
 };
 
+// Runs queries whose result the caller does not wait for on a pool of
+// workers, each with its own connection. Tasks that share a non-zero key
+// (a player guid, an account id) run one after another in the order they
+// were added; everything else runs on whichever worker is free.
+// Queries whose result is waited for use Database::getInstance: the login
+// crypto workers (IOBan checks, IOLoginData::gameworldAuthentication) each
+// have a connection of their own, everything else shares the singleton.
 class DatabaseTasks {
 	public:
 		DatabaseTasks();
 
-		void start();
-		void run();
-		void flush();
+		// non-copyable
+		DatabaseTasks(const DatabaseTasks&) = delete;
+		DatabaseTasks& operator=(const DatabaseTasks&) = delete;
+
+		void start(size_t threadCount);
 		void stop();
+		// the workers finish the queued tasks before they exit
 		void shutdown();
 		void join();
 
-		void addTask(const std::string& query, const std::function<void(DBResult_ptr, bool)>& callback = nullptr, bool store = false);
+		void addTask(const std::string& query, const std::function<void(DBResult_ptr, bool)>& callback = nullptr, bool store = false, uint32_t key = 0);
+
+		uint32_t getQueueDepth();
 
 	private:
-		void runTask(const DatabaseTask& task);
+		void run(Database* db);
+		void runTask(Database& db, const DatabaseTask& task);
+
+		// first queued task whose key is not held by another worker
+		std::list<DatabaseTask>::iterator getRunnableTask();
 
-		Database db;
-		std::thread thread;
+		std::vector<std::unique_ptr<Database>> connections;
+		std::vector<std::thread> threads;
 		std::list<DatabaseTask> tasks;
+		std::unordered_set<uint32_t> runningKeys;
 		std::mutex taskLock;
 		std::condition_variable taskSignal;
 		ThreadState threadState;
@@ -33,6 +33,32 @@ enum ThreadState {
 	THREAD_STATE_TERMINATED,
 };
 
+// what a dispatcher task is doing, only used for the task statistics
+enum TaskCategory : uint8_t {
+	TASK_CATEGORY_OTHER,
+	TASK_CATEGORY_PACKET,
+	TASK_CATEGORY_CREATURE_THINK,
+	TASK_CATEGORY_DECAY,
+	TASK_CATEGORY_DATABASE,
+	TASK_CATEGORY_LUA_EVENT,
+	TASK_CATEGORY_LAST = TASK_CATEGORY_LUA_EVENT
+};
+
+// parts of a player that are only written by a save when they have changed,
+// Player::itemsFingerprint has one entry per item section, in this order
+enum PlayerSaveSection_t : uint8_t {
+	PLAYER_SAVE_NONE = 0,
+
+	PLAYER_SAVE_ITEMS = 1 << 0,
+	PLAYER_SAVE_DEPOTITEMS = 1 << 1,
+	PLAYER_SAVE_INBOXITEMS = 1 << 2,
+	PLAYER_SAVE_HOUSEITEMS = 1 << 3,
+	PLAYER_SAVE_REWARDITEMS = 1 << 4,
+	PLAYER_SAVE_STORAGE = 1 << 5, // the whole table, single keys are tracked by Player::dirtyStorageKeys
+	PLAYER_SAVE_SPELLS = 1 << 6,
+	PLAYER_SAVE_KILLS = 1 << 7,
+};
+
 enum itemAttrTypes : uint32_t {
 	ITEM_ATTRIBUTE_NONE,
 
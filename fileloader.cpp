@@ -21,175 +21,214 @@
 
 #include "fileloader.h"
 
-FileLoader::FileLoader() : m_cached_data()
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileLoader::FileLoader()
 {
-	m_file = nullptr;
-	m_root = nullptr;
-	m_buffer = new uint8_t[1024];
-	m_buffer_size = 1024;
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
 	m_lastError = ERROR_NONE;
-
-	//cache
-	m_cache_size = 0;
-	m_cache_index = NO_VALID_CACHE;
-	m_cache_offset = NO_VALID_CACHE;
 }
 
 FileLoader::~FileLoader()
 {
-	if (m_file) {
-		fclose(m_file);
-		m_file = nullptr;
-	}
-
-	NodeStruct::clearNet(m_root);
-	delete[] m_buffer;
-
-	for (int32_t i = 0; i < CACHE_BLOCKS; i++) {
-		delete[] m_cached_data[i].data;
-	}
+	unmapFile();
 }
 
 bool FileLoader::openFile(const char* filename, const char* accept_identifier)
 {
-	m_file = fopen(filename, "rb");
-	if (!m_file) {
+	unmapFile();
+	m_nodes.clear();
+
+	if (!mapFile(filename)) {
 		m_lastError = ERROR_CAN_NOT_OPEN;
 		return false;
 	}
 
-	char identifier[4];
-	if (fread(identifier, 1, 4, m_file) < 4) {
-		fclose(m_file);
-		m_file = nullptr;
+	if (m_size < 4) {
+		unmapFile();
 		m_lastError = ERROR_EOF;
 		return false;
 	}
 
 	// The first four bytes must either match the accept identifier or be 0x00000000 (wildcard)
-	if (memcmp(identifier, accept_identifier, 4) != 0 && memcmp(identifier, "\0\0\0\0", 4) != 0) {
-		fclose(m_file);
-		m_file = nullptr;
+	if (memcmp(m_data, accept_identifier, 4) != 0 && memcmp(m_data, "\0\0\0\0", 4) != 0) {
+		unmapFile();
 		m_lastError = ERROR_INVALID_FILE_VERSION;
 		return false;
 	}
 
-	fseek(m_file, 0, SEEK_END);
-	int32_t file_size = ftell(m_file);
-	m_cache_size = std::min<uint32_t>(32768, std::max<uint32_t>(file_size / 20, 8192)) & ~0x1FFF;
-
-	if (!safeSeek(4)) {
+	if (!indexNodes()) {
+		m_nodes.clear();
 		m_lastError = ERROR_INVALID_FORMAT;
 		return false;
 	}
+	return true;
+}
 
-	delete m_root;
-	m_root = new NodeStruct();
-	m_root->start = 4;
+bool FileLoader::mapFile(const char* filename)
+{
+#ifndef _WIN32
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
 
-	int32_t byte;
-	if (safeSeek(4) && readByte(byte) && byte == NODE_START) {
-		return parseNode(m_root);
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		return false;
 	}
 
-	return false;
+	if (st.st_size > 0) {
+		void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping != MAP_FAILED) {
+			close(fd);
+			// nodes are indexed front to back and then loaded in the same order
+			madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+			m_mapping = mapping;
+			m_data = static_cast<const uint8_t*>(mapping);
+			m_size = st.st_size;
+			return true;
+		}
+	}
+	close(fd);
+#endif
+
+	// no mapping available, fall back to reading the whole file at once
+	FILE* file = fopen(filename, "rb");
+	if (!file) {
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (fileSize < 0) {
+		fclose(file);
+		return false;
+	}
+
+	m_fileData.resize(fileSize);
+	size_t read = fread(m_fileData.data(), 1, fileSize, file);
+	fclose(file);
+	if (read != static_cast<size_t>(fileSize)) {
+		m_fileData.clear();
+		return false;
+	}
+
+	m_data = m_fileData.data();
+	m_size = m_fileData.size();
+	return true;
 }
 
-bool FileLoader::parseNode(NODE node)
+void FileLoader::unmapFile()
 {
-	int32_t byte, pos;
-	NODE currentNode = node;
+#ifndef _WIN32
+	if (m_mapping) {
+		munmap(m_mapping, m_size);
+		m_mapping = nullptr;
+	}
+#endif
 
-	while (readByte(byte)) {
-		currentNode->type = byte;
-		bool setPropsSize = false;
+	std::vector<uint8_t>().swap(m_fileData);
+	m_data = nullptr;
+	m_size = 0;
+}
 
-		while (true) {
-			if (!readByte(byte)) {
-				return false;
-			}
+bool FileLoader::indexNodes()
+{
+	struct OpenNode {
+		uint32_t index;
+		uint32_t lastChild;
+		bool propsDone;
+	};
+
+	if (m_size < 6 || m_data[4] != NODE_START) {
+		return false;
+	}
 
-			bool skipNode = false;
+	//escaped 0xFE bytes make this an overestimate, which is fine for a reserve
+	m_nodes.reserve(std::count(m_data + 4, m_data + m_size, NODE_START));
 
-			switch (byte) {
-				case NODE_START: {
-					//child node start
-					if (!safeTell(pos)) {
-						return false;
-					}
+	std::vector<OpenNode> stack;
+	uint32_t lastRoot = 0;
 
-					NODE childNode = new NodeStruct();
-					childNode->start = pos;
-					currentNode->propsSize = pos - currentNode->start - 2;
-					currentNode->child = childNode;
+	size_t pos = 4;
+	while (pos < m_size) {
+		uint8_t byte = m_data[pos];
+		if (byte == NODE_START) {
+			//the type byte directly follows the node start and is never escaped
+			if (pos + 1 >= m_size) {
+				return false;
+			}
 
-					setPropsSize = true;
+			uint32_t index = m_nodes.size();
+			m_nodes.emplace_back();
 
-					if (!parseNode(childNode)) {
-						return false;
-					}
+			NodeStruct& node = m_nodes.back();
+			node.start = pos;
+			node.type = m_data[pos + 1];
 
-					break;
+			if (!stack.empty()) {
+				OpenNode& parent = stack.back();
+				if (!parent.propsDone) {
+					m_nodes[parent.index].propsSize = pos - m_nodes[parent.index].start - 2;
+					parent.propsDone = true;
 				}
 
-				case NODE_END: {
-					//current node end
-					if (!setPropsSize) {
-						if (!safeTell(pos)) {
-							return false;
-						}
-
-						currentNode->propsSize = pos - currentNode->start - 2;
-					}
-
-					if (!readByte(byte)) {
-						return true;
-					}
-
-					switch (byte) {
-						case NODE_START: {
-							//starts next node
-							if (!safeTell(pos)) {
-								return false;
-							}
-
-							skipNode = true;
-							NODE nextNode = new NodeStruct();
-							nextNode->start = pos;
-							currentNode->next = nextNode;
-							currentNode = nextNode;
-							break;
-						}
-
-						case NODE_END:
-							return safeTell(pos) && safeSeek(pos);
-
-						default:
-							m_lastError = ERROR_INVALID_FORMAT;
-							return false;
-					}
-
-					break;
+				if (parent.lastChild != 0) {
+					m_nodes[parent.lastChild].next = index;
+				} else {
+					m_nodes[parent.index].child = index;
 				}
+				parent.lastChild = index;
+			} else if (index != 0) {
+				m_nodes[lastRoot].next = index;
+				lastRoot = index;
+			}
 
-				case ESCAPE_CHAR: {
-					if (!readByte(byte)) {
-						return false;
-					}
+			stack.push_back({index, 0, false});
+			pos += 2;
+		} else if (byte == NODE_END) {
+			if (stack.empty()) {
+				return false;
+			}
 
-					break;
-				}
+			const OpenNode& current = stack.back();
+			if (!current.propsDone) {
+				m_nodes[current.index].propsSize = pos - m_nodes[current.index].start - 2;
+			}
 
-				default:
-					break;
+			stack.pop_back();
+			++pos;
+		} else if (byte == ESCAPE_CHAR) {
+			if (stack.empty()) {
+				return false;
 			}
 
-			if (skipNode) {
-				break;
+			if (!stack.back().propsDone) {
+				m_nodes[stack.back().index].escaped = true;
+			}
+			pos += 2;
+		} else {
+			if (stack.empty()) {
+				return false;
 			}
+
+			//plain property bytes, skip ahead to the next special byte
+			do {
+				++pos;
+			} while (pos < m_size && m_data[pos] < ESCAPE_CHAR);
 		}
 	}
-	return false;
+	return stack.empty() && pos == m_size;
 }
 
 const uint8_t* FileLoader::getProps(const NODE node, size_t& size)
@@ -198,38 +237,28 @@ const uint8_t* FileLoader::getProps(const NODE node, size_t& size)
 		return nullptr;
 	}
 
-	if (node->propsSize >= m_buffer_size) {
-		delete[] m_buffer;
-
-		while (node->propsSize >= m_buffer_size) {
-			m_buffer_size *= 2;
-		}
-
-		m_buffer = new uint8_t[m_buffer_size];
+	const uint8_t* props = m_data + node->start + 2;
+	if (!node->escaped) {
+		//nothing to unescape, hand out a view straight into the file
+		size = node->propsSize;
+		return props;
 	}
 
-	//get buffer
-	if (!readBytes(m_buffer, node->propsSize, node->start + 2)) {
-		return nullptr;
+	if (m_buffer.size() < node->propsSize) {
+		m_buffer.resize(node->propsSize);
 	}
 
-	//unscape buffer
 	size_t j = 0;
-	bool escaped = false;
 	for (uint32_t i = 0; i < node->propsSize; ++i, ++j) {
-		if (m_buffer[i] == ESCAPE_CHAR) {
+		if (props[i] == ESCAPE_CHAR) {
 			//escape char found, skip it and write next
-			m_buffer[j] = m_buffer[++i];
-			//is neede a displacement for next bytes
-			escaped = true;
-		} else if (escaped) {
-			//perform that displacement
-			m_buffer[j] = m_buffer[i];
+			++i;
 		}
+		m_buffer[j] = props[i];
 	}
 
 	size = j;
-	return m_buffer;
+	return m_buffer.data();
 }
 
 bool FileLoader::getProps(const NODE node, PropStream& props)
@@ -247,7 +276,7 @@ bool FileLoader::getProps(const NODE node, PropStream& props)
 NODE FileLoader::getChildNode(const NODE parent, uint32_t& type)
 {
 	if (parent) {
-		NODE child = parent->child;
+		NODE child = getNode(parent->child);
 		if (child) {
 			type = child->type;
 		}
@@ -255,8 +284,13 @@ NODE FileLoader::getChildNode(const NODE parent, uint32_t& type)
 		return child;
 	}
 
-	type = m_root->type;
-	return m_root;
+	if (m_nodes.empty()) {
+		return NO_NODE;
+	}
+
+	NODE root = &m_nodes.front();
+	type = root->type;
+	return root;
 }
 
 NODE FileLoader::getNextNode(const NODE prev, uint32_t& type)
@@ -265,154 +299,9 @@ NODE FileLoader::getNextNode(const NODE prev, uint32_t& type)
 		return NO_NODE;
 	}
 
-	NODE next = prev->next;
+	NODE next = getNode(prev->next);
 	if (next) {
 		type = next->type;
 	}
 	return next;
 }
-
-inline bool FileLoader::readByte(int32_t& value)
-{
-	if (m_cache_index == NO_VALID_CACHE) {
-		m_lastError = ERROR_CACHE_ERROR;
-		return false;
-	}
-
-	if (m_cache_offset >= m_cached_data[m_cache_index].size) {
-		int32_t pos = m_cache_offset + m_cached_data[m_cache_index].base;
-		int32_t tmp = getCacheBlock(pos);
-		if (tmp < 0) {
-			return false;
-		}
-
-		m_cache_index = tmp;
-		m_cache_offset = pos - m_cached_data[m_cache_index].base;
-		if (m_cache_offset >= m_cached_data[m_cache_index].size) {
-			return false;
-		}
-	}
-
-	value = m_cached_data[m_cache_index].data[m_cache_offset++];
-	return true;
-}
-
-inline bool FileLoader::readBytes(uint8_t* buffer, uint32_t size, int32_t pos)
-{
-	//seek at pos
-	uint32_t remain = size, bufferPos = 0;
-	do {
-		//prepare cache
-		uint32_t i = getCacheBlock(pos);
-		if (i == NO_VALID_CACHE) {
-			return false;
-		}
-
-		m_cache_index = i;
-		m_cache_offset = pos - m_cached_data[i].base;
-
-		//get maximum read block size and calculate remaining bytes
-		uint32_t reading = std::min<int32_t>(remain, m_cached_data[i].size - m_cache_offset);
-		remain -= reading;
-
-		//read it
-		memcpy(buffer + bufferPos, m_cached_data[m_cache_index].data + m_cache_offset, reading);
-
-		//update variables
-		m_cache_offset += reading;
-		bufferPos += reading;
-		pos += reading;
-	} while (remain > 0);
-	return true;
-}
-
-inline bool FileLoader::safeSeek(uint32_t pos)
-{
-	uint32_t i = getCacheBlock(pos);
-	if (i == NO_VALID_CACHE) {
-		return false;
-	}
-
-	m_cache_index = i;
-	m_cache_offset = pos - m_cached_data[i].base;
-	return true;
-}
-
-inline bool FileLoader::safeTell(int32_t& pos)
-{
-	if (m_cache_index == NO_VALID_CACHE) {
-		m_lastError = ERROR_CACHE_ERROR;
-		return false;
-	}
-
-	pos = m_cached_data[m_cache_index].base + m_cache_offset - 1;
-	return true;
-}
-
-inline uint32_t FileLoader::getCacheBlock(uint32_t pos)
-{
-	bool found = false;
-	uint32_t i, base_pos = pos & ~(m_cache_size - 1);
-
-	for (i = 0; i < CACHE_BLOCKS; i++) {
-		if (m_cached_data[i].loaded) {
-			if (m_cached_data[i].base == base_pos) {
-				found = true;
-				break;
-			}
-		}
-	}
-
-	if (!found) {
-		i = loadCacheBlock(pos);
-	}
-
-	return i;
-}
-
-int32_t FileLoader::loadCacheBlock(uint32_t pos)
-{
-	int32_t i, loading_cache = -1, base_pos = pos & ~(m_cache_size - 1);
-
-	for (i = 0; i < CACHE_BLOCKS; i++) {
-		if (!m_cached_data[i].loaded) {
-			loading_cache = i;
-			break;
-		}
-	}
-
-	if (loading_cache == -1) {
-		for (i = 0; i < CACHE_BLOCKS; i++) {
-			if (std::abs(static_cast<long>(m_cached_data[i].base) - base_pos) > static_cast<long>(2 * m_cache_size)) {
-				loading_cache = i;
-				break;
-			}
-		}
-
-		if (loading_cache == -1) {
-			loading_cache = 0;
-		}
-	}
-
-	if (m_cached_data[loading_cache].data == nullptr) {
-		m_cached_data[loading_cache].data = new uint8_t[m_cache_size];
-	}
-
-	m_cached_data[loading_cache].base = base_pos;
-
-	if (fseek(m_file, m_cached_data[loading_cache].base, SEEK_SET) != 0) {
-		m_lastError = ERROR_SEEK_ERROR;
-		return -1;
-	}
-
-	uint32_t size = fread(m_cached_data[loading_cache].data, 1, m_cache_size, m_file);
-	m_cached_data[loading_cache].size = size;
-
-	if (size < (pos - m_cached_data[loading_cache].base)) {
-		m_lastError = ERROR_SEEK_ERROR;
-		return -1;
-	}
-
-	m_cached_data[loading_cache].loaded = 1;
-	return loading_cache;
-}
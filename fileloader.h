@@ -24,48 +24,17 @@ struct NodeStruct;
 
 typedef NodeStruct* NODE;
 
+// Flat node index entry; child and next are indices into the loader's node
+// array (0 means none, the root always sits at index 0).
 struct NodeStruct {
-	NodeStruct() : start(0), propsSize(0), type(0), next(nullptr), child(nullptr) {}
+	NodeStruct() : start(0), propsSize(0), child(0), next(0), type(0), escaped(false) {}
 
 	uint32_t start;
 	uint32_t propsSize;
-	uint32_t type;
-	NodeStruct* next;
-	NodeStruct* child;
-
-	static void clearNet(NodeStruct* root) {
-		if (root) {
-			clearChild(root);
-		}
-	}
-
-	private:
-		static void clearNext(NodeStruct* node) {
-			NodeStruct* deleteNode = node;
-			NodeStruct* nextNode;
-
-			while (deleteNode) {
-				if (deleteNode->child) {
-					clearChild(deleteNode->child);
-				}
-
-				nextNode = deleteNode->next;
-				delete deleteNode;
-				deleteNode = nextNode;
-			}
-		}
-
-		static void clearChild(NodeStruct* node) {
-			if (node->child) {
-				clearChild(node->child);
-			}
-
-			if (node->next) {
-				clearNext(node->next);
-			}
-
-			delete node;
-		}
+	uint32_t child;
+	uint32_t next;
+	uint8_t type;
+	bool escaped;
 };
 
 #define NO_NODE 0
@@ -114,38 +83,23 @@ class FileLoader
 			NODE_END = 0xFF,
 		};
 
-		bool parseNode(NODE node);
+		bool mapFile(const char* filename);
+		void unmapFile();
+		bool indexNodes();
 
-		inline bool readByte(int32_t& value);
-		inline bool readBytes(uint8_t* buffer, uint32_t size, int32_t pos);
-		inline bool safeSeek(uint32_t pos);
-		inline bool safeTell(int32_t& pos);
-
-	protected:
-		struct _cache {
-			uint8_t* data;
-			uint32_t loaded;
-			uint32_t base;
-			uint32_t size;
-		};
+		NODE getNode(uint32_t index) {
+			return index != 0 ? &m_nodes[index] : NO_NODE;
+		}
 
-#define CACHE_BLOCKS 3
-		_cache m_cached_data[CACHE_BLOCKS];
+		std::vector<NodeStruct> m_nodes;
+		std::vector<uint8_t> m_buffer;
+		std::vector<uint8_t> m_fileData;
 
-		uint8_t* m_buffer;
-		NODE m_root;
-		FILE* m_file;
+		const uint8_t* m_data;
+		size_t m_size;
+		void* m_mapping;
 
 		FILELOADER_ERRORS m_lastError;
-		uint32_t m_buffer_size;
-
-		uint32_t m_cache_size;
-#define NO_VALID_CACHE 0xFFFFFFFF
-		uint32_t m_cache_index;
-		uint32_t m_cache_offset;
-
-		inline uint32_t getCacheBlock(uint32_t pos);
-		int32_t loadCacheBlock(uint32_t pos);
 };
 
 class PropStream
@@ -31,6 +31,7 @@
 #include "actions.h"
 #include "combat.h"
 #include "iologindata.h"
+#include "iomapserialize.h"
 #include "iomarket.h"
 #include "chat.h"
 #include "talkaction.h"
@@ -51,7 +52,10 @@
 #include "connection.h"
 #include "events.h"
 #include "databasetasks.h"
+#include "cryptotasks.h"
+#include "taskstats.h"
 #include "store.h"
+#include "worldsave.h"
 
 extern ConfigManager g_config;
 extern Actions* g_actions;
@@ -80,6 +84,7 @@ Game::Game() :
 	stagesEnabled = false;
 
 	lastBucket = 0;
+	parallelThink = false;
 
 	//(1440 minutes/day)/(3600 seconds/day)*10 seconds event interval
 	lightHourDelta = 1;
@@ -107,13 +112,28 @@ Game::~Game()
 	}
 }
 
+static uint32_t getTaskStatsDelay()
+{
+	// the interval is reloadable, so keep polling while the dump is disabled
+	int32_t interval = g_config.getNumber(ConfigManager::DISPATCHER_STATS_INTERVAL);
+	return interval > 0 ? interval * 1000 : EVENT_TASKSTATSINTERVAL;
+}
+
 void Game::start(ServiceManager* manager)
 {
 	serviceManager = manager;
 
+	// a deterministic run goes through the same two phases on the dispatcher only
+	int32_t thinkThreads = g_config.getNumber(ConfigManager::CREATURE_THINK_THREADS);
+	parallelThink = thinkThreads > 0 || g_config.getBoolean(ConfigManager::CREATURE_THINK_DETERMINISTIC);
+	if (thinkThreads > 0 && !g_config.getBoolean(ConfigManager::CREATURE_THINK_DETERMINISTIC)) {
+		thinkPool.start(thinkThreads);
+	}
+
 	g_scheduler.addEvent(createSchedulerTask(EVENT_LIGHTINTERVAL, std::bind(&Game::checkLight, this, false)));
-	g_scheduler.addEvent(createSchedulerTask(EVENT_CREATURE_THINK_INTERVAL, std::bind(&Game::checkCreatures, this, 0)));
-	g_scheduler.addEvent(createSchedulerTask(EVENT_DECAYINTERVAL, std::bind(&Game::checkDecay, this)));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_CREATURE_THINK_INTERVAL, std::bind(&Game::checkCreatures, this, 0), TASK_CATEGORY_CREATURE_THINK));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_DECAYINTERVAL, std::bind(&Game::checkDecay, this), TASK_CATEGORY_DECAY));
+	g_scheduler.addEvent(createSchedulerTask(getTaskStatsDelay(), std::bind(&Game::checkTaskStats, this)));
 }
 
 GameState_t Game::getGameState() const
@@ -295,12 +315,20 @@ void Game::saveGameState()
 
 	std::cout << "Saving server..." << std::endl;
 
+	int64_t start = OTSYS_TIME();
+
+	std::vector<PlayerSaveData> playerData;
+	playerData.reserve(players.size());
 	for (const auto& it : players) {
 		it.second->loginPosition = it.second->getPosition();
-		IOLoginData::savePlayer(it.second);
+		playerData.emplace_back();
+		IOLoginData::capturePlayer(it.second, playerData.back());
 	}
 
-	Map::save();
+	std::vector<HouseSaveData> houseData;
+	IOMapSerialize::captureHouses(houseData);
+
+	g_worldSave.save(std::move(playerData), std::move(houseData), OTSYS_TIME() - start);
 
 	if (gameState == GAME_STATE_MAINTAIN) {
 		setGameState(GAME_STATE_NORMAL);
@@ -2431,6 +2459,7 @@ void Game::playerWriteItem(uint32_t playerId, uint32_t windowTextId, const std::
 		writeItem->resetWriter();
 		writeItem->resetDate();
 	}
+	HouseTile::setHouseDirty(writeItem);
 
 	uint16_t newId = Item::items[writeItem->getID()].writeOnceItemId;
 	if (newId != 0) {
@@ -3592,24 +3621,21 @@ bool Game::internalCreatureSay(Creature* creature, SpeakClasses type, const std:
 		pos = &creature->getPosition();
 	}
 
-	SpectatorVec list;
-
+	// use the caller's list if it has one, else collect into a local one
+	SpectatorVec localList;
 	if (!listPtr || listPtr->empty()) {
-		// This somewhat complex construct ensures that the cached SpectatorVec
-		// is used if available and if it can be used, else a local vector is
-		// used (hopefully the compiler will optimize away the construction of
-		// the temporary when it's not used).
 		if (type != TALKTYPE_YELL && type != TALKTYPE_MONSTER_YELL) {
-			map.getSpectators(list, *pos, false, false,
+			map.getSpectators(localList, *pos, false, false,
 			              Map::maxClientViewportX, Map::maxClientViewportX,
 			              Map::maxClientViewportY, Map::maxClientViewportY);
 		} else {
-			map.getSpectators(list, *pos, true, false, 18, 18, 14, 14);
+			map.getSpectators(localList, *pos, true, false, 18, 18, 14, 14);
 		}
-	} else {
-		list = (*listPtr);
+		listPtr = &localList;
 	}
 
+	const SpectatorVec& list = *listPtr;
+
 	//send to client
 	for (Creature* spectator : list) {
 		if (Player* tmpPlayer = spectator->getPlayer()) {
@@ -3674,9 +3700,17 @@ void Game::removeCreatureCheck(Creature* creature)
 
 void Game::checkCreatures(size_t index)
 {
-	g_scheduler.addEvent(createSchedulerTask(EVENT_CHECK_CREATURE_INTERVAL, std::bind(&Game::checkCreatures, this, (index + 1) % EVENT_CREATURECOUNT)));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_CHECK_CREATURE_INTERVAL, std::bind(&Game::checkCreatures, this, (index + 1) % EVENT_CREATURECOUNT), TASK_CATEGORY_CREATURE_THINK));
+
+	if (index == 0) {
+		map.nextFlowFieldTick();
+	}
 
 	auto& checkCreatureList = checkCreatureLists[index];
+	if (parallelThink) {
+		precomputeCreatureThink(checkCreatureList);
+	}
+
 	auto it = checkCreatureList.begin(), end = checkCreatureList.end();
 	while (it != end) {
 		Creature* creature = *it;
@@ -3696,9 +3730,69 @@ void Game::checkCreatures(size_t index)
 		}
 	}
 
+	// released creatures are only freed by cleanup, so every candidate is still valid here
+	for (Creature* creature : thinkCandidates) {
+		creature->clearPrecomputedFollowPath();
+	}
+	thinkCandidates.clear();
+
 	cleanup();
 }
 
+void Game::precomputeCreatureThink(const std::list<Creature*>& creatures)
+{
+	thinkCandidates.clear();
+	thinkRegions.clear();
+
+	for (Creature* creature : creatures) {
+		if (creature->creatureCheck && creature->getHealth() > 0 && creature->needsFollowPathUpdate(EVENT_CREATURE_THINK_INTERVAL)) {
+			thinkCandidates.push_back(creature);
+		}
+	}
+
+	if (thinkCandidates.empty()) {
+		return;
+	}
+
+	// group the candidates by quadtree leaf so that each job walks one region of the map
+	auto getRegion = [](const Creature* creature) {
+		const Position& pos = creature->getPosition();
+		return (static_cast<uint32_t>(pos.x >> FLOOR_BITS) << 16) | (pos.y >> FLOOR_BITS);
+	};
+
+	std::sort(thinkCandidates.begin(), thinkCandidates.end(), [&getRegion](const Creature* lhs, const Creature* rhs) {
+		uint32_t lhsRegion = getRegion(lhs);
+		uint32_t rhsRegion = getRegion(rhs);
+		if (lhsRegion != rhsRegion) {
+			return lhsRegion < rhsRegion;
+		}
+		return lhs->getID() < rhs->getID();
+	});
+
+	for (size_t i = 0, size = thinkCandidates.size(); i < size; ++i) {
+		if (i == 0 || getRegion(thinkCandidates[i - 1]) != getRegion(thinkCandidates[i])) {
+			thinkRegions.push_back(i);
+		}
+	}
+	thinkRegions.push_back(thinkCandidates.size());
+
+	// flow fields are built here, the workers only look them up
+	for (Creature* creature : thinkCandidates) {
+		Creature* followCreature = creature->getFollowCreature();
+		if (followCreature && creature->getMonster()) {
+			map.getFlowField(*followCreature, true);
+		}
+	}
+
+	// the dispatcher is blocked until every region is done, so the map is not
+	// mutated while the workers read it; onThink applies the results serially
+	thinkPool.parallelFor(thinkRegions.size() - 1, [this](size_t region) {
+		for (size_t i = thinkRegions[region], last = thinkRegions[region + 1]; i < last; ++i) {
+			thinkCandidates[i]->precomputeFollowPath();
+		}
+	});
+}
+
 void Game::changeSpeed(Creature* creature, int32_t varSpeedDelta)
 {
 	int32_t varSpeed = creature->getSpeed() - creature->getBaseSpeed();
@@ -4420,8 +4514,7 @@ void Game::addMagicEffect(const SpectatorVec& list, const Position& pos, uint8_t
 void Game::addDistanceEffect(const Position& fromPos, const Position& toPos, uint8_t effect)
 {
 	SpectatorVec list;
-	map.getSpectators(list, fromPos, false, true);
-	map.getSpectators(list, toPos, false, true);
+	map.getSpectators(list, fromPos, toPos, false, true);
 	addDistanceEffect(list, fromPos, toPos, effect);
 }
 
@@ -4448,6 +4541,7 @@ void Game::startDecay(Item* item)
 	if (item->getDuration() > 0) {
 		item->incrementReferenceCounter();
 		item->setDecaying(DECAYING_TRUE);
+		HouseTile::setHouseDirty(item);
 		toDecayItems.push_front(item);
 	} else {
 		internalDecayItem(item);
@@ -4470,7 +4564,7 @@ void Game::internalDecayItem(Item* item)
 
 void Game::checkDecay()
 {
-	g_scheduler.addEvent(createSchedulerTask(EVENT_DECAYINTERVAL, std::bind(&Game::checkDecay, this)));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_DECAYINTERVAL, std::bind(&Game::checkDecay, this), TASK_CATEGORY_DECAY));
 
 	size_t bucket = (lastBucket + 1) % EVENT_DECAY_BUCKETS;
 
@@ -4479,6 +4573,7 @@ void Game::checkDecay()
 		Item* item = *it;
 		if (!item->canDecay()) {
 			item->setDecaying(DECAYING_FALSE);
+			HouseTile::setHouseDirty(item);
 			ReleaseItem(item);
 			it = decayItems[bucket].erase(it);
 			continue;
@@ -4490,6 +4585,8 @@ void Game::checkDecay()
 
 		duration -= decreaseTime;
 		item->decreaseDuration(decreaseTime);
+		// decaying house items are saved with their remaining duration
+		HouseTile::setHouseDirty(item);
 
 		if (duration <= 0) {
 			it = decayItems[bucket].erase(it);
@@ -4513,6 +4610,14 @@ void Game::checkDecay()
 	cleanup();
 }
 
+void Game::checkTaskStats()
+{
+	if (g_config.getNumber(ConfigManager::DISPATCHER_STATS_INTERVAL) > 0) {
+		g_taskStats.dump();
+	}
+	g_scheduler.addEvent(createSchedulerTask(getTaskStatsDelay(), std::bind(&Game::checkTaskStats, this)));
+}
+
 void Game::checkLight(bool forced /*= false*/)
 {
 	if (!forced) {
@@ -4596,7 +4701,10 @@ void Game::shutdown()
 
 	g_scheduler.shutdown();
 	g_databaseTasks.shutdown();
+	g_worldSave.shutdown();
+	g_cryptoTasks.shutdown();
 	g_dispatcher.shutdown();
+	thinkPool.shutdown();
 	map.spawns.clear();
 
 	cleanup();
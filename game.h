@@ -34,6 +34,7 @@
 #include "npc.h"
 #include "wildcardtree.h"
 #include "quests.h"
+#include "workerpool.h"
 
 class ServiceManager;
 class Creature;
@@ -74,6 +75,7 @@ enum LightState_t {
 
 #define EVENT_LIGHTINTERVAL 2500
 #define EVENT_DECAYINTERVAL 250
+#define EVENT_TASKSTATSINTERVAL 60000
 #define EVENT_DECAY_BUCKETS 4
 
 /**
@@ -439,6 +441,7 @@ class Game
 		void checkCreatureAttack(uint32_t creatureId);
 		void checkCreatures(size_t index);
 		void checkLight(bool forced = false);
+		void checkTaskStats();
 
 		bool combatBlockHit(CombatDamage& damage, Creature* attacker, Creature* target, bool checkDefense, bool checkArmor, bool field);
 
@@ -532,6 +535,8 @@ class Game
 		void checkDecay();
 		void internalDecayItem(Item* item);
 
+		void precomputeCreatureThink(const std::list<Creature*>& creatures);
+
 		std::unordered_map<uint32_t, Player*> players;
 		std::unordered_map<std::string, Player*> mappedPlayerNames;
 		std::unordered_map<uint32_t, Guild*> guilds;
@@ -543,6 +548,13 @@ class Game
 
 		std::forward_list<Item*> toDecayItems;
 
+		// parallel creature think: candidates grouped by map region, and the
+		// offset in thinkCandidates where each region starts
+		WorkerPool thinkPool;
+		std::vector<Creature*> thinkCandidates;
+		std::vector<size_t> thinkRegions;
+		bool parallelThink;
+
 		std::vector<Creature*> ToReleaseCreatures;
 		std::vector<Item*> ToReleaseItems;
 		std::vector<char> commandTags;
@@ -26,6 +26,7 @@
 #include "game.h"
 #include "configmanager.h"
 #include "bed.h"
+#include "worldsave.h"
 
 extern ConfigManager g_config;
 extern Game g_game;
@@ -44,6 +45,7 @@ House::House(uint32_t _houseid) :
 	rent = 0;
 	townid = 0;
 	transferItem = nullptr;
+	dirty = false;
 }
 
 void House::addTile(HouseTile* tile)
@@ -55,6 +57,9 @@ void House::addTile(HouseTile* tile)
 void House::setOwner(uint32_t guid, bool updateDatabase/* = true*/, Player* player/* = nullptr*/)
 {
 	if (updateDatabase && owner != guid) {
+		// a queued snapshot still has the old owner and items
+		g_worldSave.flushHouses();
+
 		Database* db = Database::getInstance();
 
 		std::ostringstream query;
@@ -227,6 +227,15 @@ class House
 			return static_cast<uint32_t>(std::ceil(bedsList.size() / 2.));   //each bed takes 2 sqms of space, ceil is just for bad maps
 		}
 
+		// set when an item in the house changes, the next save only writes the
+		// tile_store rows of dirty houses
+		void setDirty(bool isDirty) {
+			dirty = isDirty;
+		}
+		bool isDirty() const {
+			return dirty;
+		}
+
 	private:
 		bool transferToDepot() const;
 		bool transferToDepot(Player* player) const;
@@ -256,6 +265,7 @@ class House
 		Position posEntry;
 
 		bool isLoaded;
+		bool dirty;
 };
 
 typedef std::map<uint32_t, House*> HouseMap;
@@ -58,6 +58,45 @@ void HouseTile::internalAddThing(uint32_t index, Thing* thing)
 	}
 }
 
+void HouseTile::updateThing(Thing* thing, uint16_t itemId, uint32_t count)
+{
+	Tile::updateThing(thing, itemId, count);
+	house->setDirty(true);
+}
+
+void HouseTile::postAddNotification(Thing* thing, const Cylinder* oldParent, int32_t index, cylinderlink_t link/* = LINK_OWNER*/)
+{
+	if (thing->getItem()) {
+		house->setDirty(true);
+	}
+	Tile::postAddNotification(thing, oldParent, index, link);
+}
+
+void HouseTile::postRemoveNotification(Thing* thing, const Cylinder* newParent, int32_t index, cylinderlink_t link/* = LINK_OWNER*/)
+{
+	if (thing->getItem()) {
+		house->setDirty(true);
+	}
+	Tile::postRemoveNotification(thing, newParent, index, link);
+}
+
+void HouseTile::setHouseDirty(const Item* item)
+{
+	const Cylinder* cylinder = item->getParent();
+	while (cylinder && cylinder->getParent()) {
+		// carried by someone standing in the house, not part of it
+		if (cylinder->getCreature()) {
+			return;
+		}
+		cylinder = cylinder->getParent();
+	}
+
+	const Tile* tile = cylinder ? cylinder->getTile() : nullptr;
+	if (tile && tile->hasFlag(TILESTATE_HOUSE)) {
+		static_cast<const HouseTile*>(tile)->house->setDirty(true);
+	}
+}
+
 void HouseTile::updateHouse(Item* item)
 {
 	if (item->getParent() != this) {
@@ -38,6 +38,15 @@ class HouseTile final : public DynamicTile
 
 		void addThing(int32_t index, Thing* thing) final;
 		void internalAddThing(uint32_t index, Thing* thing) final;
+		void updateThing(Thing* thing, uint16_t itemId, uint32_t count) final;
+
+		// items in containers on the tile are reported here as well (LINK_NEAR)
+		void postAddNotification(Thing* thing, const Cylinder* oldParent, int32_t index, cylinderlink_t link = LINK_OWNER) final;
+		void postRemoveNotification(Thing* thing, const Cylinder* newParent, int32_t index, cylinderlink_t link = LINK_OWNER) final;
+
+		// flags the house the item lies in, if any, for changes that do not go
+		// through the tile: attributes, stack counts inside containers, ...
+		static void setHouseDirty(const Item* item);
 
 		House* getHouse() {
 			return house;
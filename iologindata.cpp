@@ -26,27 +26,74 @@
 #include "game.h"
 #include "vocation.h"
 #include "house.h"
+#include "worldsave.h"
 
 extern ConfigManager g_config;
 extern Game g_game;
 
+// columns of the SELECT in loadPlayerById and loadPlayerByName, in that order
+enum PlayerColumn_t {
+	PLAYERCOLUMN_ID, PLAYERCOLUMN_NAME, PLAYERCOLUMN_ACCOUNT_ID, PLAYERCOLUMN_GROUP_ID,
+	PLAYERCOLUMN_SEX, PLAYERCOLUMN_VOCATION, PLAYERCOLUMN_EXPERIENCE, PLAYERCOLUMN_LEVEL,
+	PLAYERCOLUMN_MAGLEVEL, PLAYERCOLUMN_HEALTH, PLAYERCOLUMN_HEALTHMAX, PLAYERCOLUMN_BLESSINGS,
+	PLAYERCOLUMN_MANA, PLAYERCOLUMN_MANAMAX, PLAYERCOLUMN_MANASPENT, PLAYERCOLUMN_SOUL,
+	PLAYERCOLUMN_LOOKBODY, PLAYERCOLUMN_LOOKFEET, PLAYERCOLUMN_LOOKHEAD, PLAYERCOLUMN_LOOKLEGS,
+	PLAYERCOLUMN_LOOKTYPE, PLAYERCOLUMN_LOOKADDONS, PLAYERCOLUMN_POSX, PLAYERCOLUMN_POSY,
+	PLAYERCOLUMN_POSZ, PLAYERCOLUMN_CAP, PLAYERCOLUMN_LASTLOGIN, PLAYERCOLUMN_LASTLOGOUT,
+	PLAYERCOLUMN_LASTIP, PLAYERCOLUMN_CONDITIONS, PLAYERCOLUMN_SKULLTIME, PLAYERCOLUMN_SKULL,
+	PLAYERCOLUMN_TOWN_ID, PLAYERCOLUMN_BALANCE, PLAYERCOLUMN_OFFLINETRAINING_TIME,
+	PLAYERCOLUMN_OFFLINETRAINING_SKILL, PLAYERCOLUMN_STAMINA, PLAYERCOLUMN_SKILL_FIST,
+	PLAYERCOLUMN_SKILL_FIST_TRIES, PLAYERCOLUMN_SKILL_CLUB, PLAYERCOLUMN_SKILL_CLUB_TRIES,
+	PLAYERCOLUMN_SKILL_SWORD, PLAYERCOLUMN_SKILL_SWORD_TRIES, PLAYERCOLUMN_SKILL_AXE,
+	PLAYERCOLUMN_SKILL_AXE_TRIES, PLAYERCOLUMN_SKILL_DIST, PLAYERCOLUMN_SKILL_DIST_TRIES,
+	PLAYERCOLUMN_SKILL_SHIELDING, PLAYERCOLUMN_SKILL_SHIELDING_TRIES, PLAYERCOLUMN_SKILL_FISHING,
+	PLAYERCOLUMN_SKILL_FISHING_TRIES
+};
+
+static const std::string playerColumns = "SELECT `id`, `name`, `account_id`, `group_id`, `sex`, `vocation`, `experience`, `level`, `maglevel`, `health`, `healthmax`, `blessings`, `mana`, `manamax`, `manaspent`, `soul`, `lookbody`, `lookfeet`, `lookhead`, `looklegs`, `looktype`, `lookaddons`, `posx`, `posy`, `posz`, `cap`, `lastlogin`, `lastlogout`, `lastip`, `conditions`, `skulltime`, `skull`, `town_id`, `balance`, `offlinetraining_time`, `offlinetraining_skill`, `stamina`, `skill_fist`, `skill_fist_tries`, `skill_club`, `skill_club_tries`, `skill_sword`, `skill_sword_tries`, `skill_axe`, `skill_axe_tries`, `skill_dist`, `skill_dist_tries`, `skill_shielding`, `skill_shielding_tries`, `skill_fishing`, `skill_fishing_tries` FROM `players`";
+
+// Rows are summed up so the order they are loaded in does not matter; the
+// rows captureItems produces for unchanged items are the ones that were loaded.
+static uint64_t getItemRowFingerprint(uint32_t pid, uint32_t sid, uint16_t type, uint16_t count, const char* attributes, size_t attributesSize)
+{
+	// FNV-1a
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	auto add = [&hash](const char* data, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x100000001B3ULL;
+		}
+	};
+
+	add(reinterpret_cast<const char*>(&pid), sizeof(pid));
+	add(reinterpret_cast<const char*>(&sid), sizeof(sid));
+	add(reinterpret_cast<const char*>(&type), sizeof(type));
+	add(reinterpret_cast<const char*>(&count), sizeof(count));
+	add(attributes, attributesSize);
+
+	// mix the bits before they are summed up
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
 Account IOLoginData::loadAccount(uint32_t accno)
 {
 	Account account;
 
-	std::ostringstream query;
-	query << "SELECT `id`, `name`, `password`, `type`, `premdays`, `lastday`, `coins` FROM `accounts` WHERE `id` = " << accno;
-	DBResult_ptr result = Database::getInstance()->storeQuery(query.str());
+	DBStatement* statement = Database::getInstance()->prepare("SELECT `id`, `name`, `type`, `premdays`, `lastday`, `coins` FROM `accounts` WHERE `id` = ?");
+	statement->bind(0, accno);
+	DBStatementResult_ptr result = statement->storeQuery();
 	if (!result) {
 		return account;
 	}
 
-	account.id = result->getNumber<uint32_t>("id");
-	account.name = result->getString("name");
-	account.accountType = static_cast<AccountType_t>(result->getNumber<int32_t>("type"));
-	account.premiumDays = result->getNumber<uint16_t>("premdays");
-	account.lastDay = result->getNumber<time_t>("lastday");
-	account.coinBalance = result->getNumber<uint32_t>("coins"); //STORESHOP
+	account.id = result->getNumber<uint32_t>(0);
+	account.name = result->getString(1);
+	account.accountType = static_cast<AccountType_t>(result->getNumber<int32_t>(2));
+	account.premiumDays = result->getNumber<uint16_t>(3);
+	account.lastDay = result->getNumber<time_t>(4);
+	account.coinBalance = result->getNumber<uint32_t>(5); //STORESHOP
 	return account;
 }
 
@@ -217,35 +264,31 @@ void IOLoginData::updateOnlineStatus(uint32_t guid, bool login)
 
 bool IOLoginData::preloadPlayer(Player* player, const std::string& name)
 {
-	Database* db = Database::getInstance();
+	g_worldSave.flushPlayer(name);
 
-	std::ostringstream query;
-	query << "SELECT `id`, `account_id`, `group_id`, `deleted`, (SELECT `type` FROM `accounts` WHERE `accounts`.`id` = `account_id`) AS `account_type`, (SELECT `coins` FROM `accounts` WHERE `accounts`.`id` = `account_id`) AS `coinbalance`";
-	if (!g_config.getBoolean(ConfigManager::FREE_PREMIUM)) {
-		query << ", (SELECT `premdays` FROM `accounts` WHERE `accounts`.`id` = `account_id`) AS `premium_days`";
-	}
-	query << " FROM `players` WHERE `name` = " << db->escapeString(name);
-	DBResult_ptr result = db->storeQuery(query.str());
+	DBStatement* statement = Database::getInstance()->prepare("SELECT `id`, `account_id`, `group_id`, `deleted`, (SELECT `type` FROM `accounts` WHERE `accounts`.`id` = `account_id`), (SELECT `coins` FROM `accounts` WHERE `accounts`.`id` = `account_id`), (SELECT `premdays` FROM `accounts` WHERE `accounts`.`id` = `account_id`) FROM `players` WHERE `name` = ?");
+	statement->bind(0, name);
+	DBStatementResult_ptr result = statement->storeQuery();
 	if (!result) {
 		return false;
 	}
 
-	if (result->getNumber<uint64_t>("deleted") != 0) {
+	if (result->getNumber<uint64_t>(3) != 0) {
 		return false;
 	}
 
-	player->setGUID(result->getNumber<uint32_t>("id"));
-	Group* group = g_game.groups.getGroup(result->getNumber<uint16_t>("group_id"));
+	player->setGUID(result->getNumber<uint32_t>(0));
+	Group* group = g_game.groups.getGroup(result->getNumber<uint16_t>(2));
 	if (!group) {
-		std::cout << "[Error - IOLoginData::preloadPlayer] " << player->name << " has Group ID " << result->getNumber<uint16_t>("group_id") << " which doesn't exist." << std::endl;
+		std::cout << "[Error - IOLoginData::preloadPlayer] " << player->name << " has Group ID " << result->getNumber<uint16_t>(2) << " which doesn't exist." << std::endl;
 		return false;
 	}
 	player->setGroup(group);
-	player->accountNumber = result->getNumber<uint32_t>("account_id");
-	player->accountType = static_cast<AccountType_t>(result->getNumber<uint16_t>("account_type"));
-	player->coinBalance = result->getNumber<uint32_t>("coinbalance");
+	player->accountNumber = result->getNumber<uint32_t>(1);
+	player->accountType = static_cast<AccountType_t>(result->getNumber<uint16_t>(4));
+	player->coinBalance = result->getNumber<uint32_t>(5);
 	if (!g_config.getBoolean(ConfigManager::FREE_PREMIUM)) {
-		player->premiumDays = result->getNumber<uint16_t>("premium_days");
+		player->premiumDays = result->getNumber<uint16_t>(6);
 	} else {
 		player->premiumDays = std::numeric_limits<uint16_t>::max();
 	}
@@ -254,20 +297,23 @@ bool IOLoginData::preloadPlayer(Player* player, const std::string& name)
 
 bool IOLoginData::loadPlayerById(Player* player, uint32_t id)
 {
-	std::ostringstream query;
-	query << "SELECT `id`, `name`, `account_id`, `group_id`, `sex`, `vocation`, `experience`, `level`, `maglevel`, `health`, `healthmax`, `blessings`, `mana`, `manamax`, `manaspent`, `soul`, `lookbody`, `lookfeet`, `lookhead`, `looklegs`, `looktype`, `lookaddons`, `posx`, `posy`, `posz`, `cap`, `lastlogin`, `lastlogout`, `lastip`, `conditions`, `skulltime`, `skull`, `town_id`, `balance`, `offlinetraining_time`, `offlinetraining_skill`, `stamina`, `skill_fist`, `skill_fist_tries`, `skill_club`, `skill_club_tries`, `skill_sword`, `skill_sword_tries`, `skill_axe`, `skill_axe_tries`, `skill_dist`, `skill_dist_tries`, `skill_shielding`, `skill_shielding_tries`, `skill_fishing`, `skill_fishing_tries` FROM `players` WHERE `id` = " << id;
-	return loadPlayer(player, Database::getInstance()->storeQuery(query.str()));
+	g_worldSave.flushPlayer(id);
+
+	DBStatement* statement = Database::getInstance()->prepare(playerColumns + " WHERE `id` = ?");
+	statement->bind(0, id);
+	return loadPlayer(player, statement->storeQuery());
 }
 
 bool IOLoginData::loadPlayerByName(Player* player, const std::string& name)
 {
-	Database* db = Database::getInstance();
-	std::ostringstream query;
-	query << "SELECT `id`, `name`, `account_id`, `group_id`, `sex`, `vocation`, `experience`, `level`, `maglevel`, `health`, `healthmax`, `blessings`, `mana`, `manamax`, `manaspent`, `soul`, `lookbody`, `lookfeet`, `lookhead`, `looklegs`, `looktype`, `lookaddons`, `posx`, `posy`, `posz`, `cap`, `lastlogin`, `lastlogout`, `lastip`, `conditions`, `skulltime`, `skull`, `town_id`, `balance`, `offlinetraining_time`, `offlinetraining_skill`, `stamina`, `skill_fist`, `skill_fist_tries`, `skill_club`, `skill_club_tries`, `skill_sword`, `skill_sword_tries`, `skill_axe`, `skill_axe_tries`, `skill_dist`, `skill_dist_tries`, `skill_shielding`, `skill_shielding_tries`, `skill_fishing`, `skill_fishing_tries` FROM `players` WHERE `name` = " << db->escapeString(name);
-	return loadPlayer(player, db->storeQuery(query.str()));
+	g_worldSave.flushPlayer(name);
+
+	DBStatement* statement = Database::getInstance()->prepare(playerColumns + " WHERE `name` = ?");
+	statement->bind(0, name);
+	return loadPlayer(player, statement->storeQuery());
 }
 
-bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
+bool IOLoginData::loadPlayer(Player* player, DBStatementResult_ptr result)
 {
 	if (!result) {
 		return false;
@@ -275,11 +321,11 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 
 	Database* db = Database::getInstance();
 
-	uint32_t accno = result->getNumber<uint32_t>("account_id");
+	uint32_t accno = result->getNumber<uint32_t>(PLAYERCOLUMN_ACCOUNT_ID);
 	Account acc = loadAccount(accno);
 
-	player->setGUID(result->getNumber<uint32_t>("id"));
-	player->name = result->getString("name");
+	player->setGUID(result->getNumber<uint32_t>(PLAYERCOLUMN_ID));
+	player->name = result->getString(PLAYERCOLUMN_NAME);
 	player->accountNumber = accno;
 
 	player->accountType = acc.accountType;
@@ -291,19 +337,19 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 		player->premiumDays = acc.premiumDays;
 	}
 
-	Group* group = g_game.groups.getGroup(result->getNumber<uint16_t>("group_id"));
+	Group* group = g_game.groups.getGroup(result->getNumber<uint16_t>(PLAYERCOLUMN_GROUP_ID));
 	if (!group) {
-		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Group ID " << result->getNumber<uint16_t>("group_id") << " which doesn't exist" << std::endl;
+		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Group ID " << result->getNumber<uint16_t>(PLAYERCOLUMN_GROUP_ID) << " which doesn't exist" << std::endl;
 		return false;
 	}
 	player->setGroup(group);
 
-	player->bankBalance = result->getNumber<uint64_t>("balance");
+	player->bankBalance = result->getNumber<uint64_t>(PLAYERCOLUMN_BALANCE);
 
-	player->setSex(static_cast<PlayerSex_t>(result->getNumber<uint16_t>("sex")));
-	player->level = std::max<uint32_t>(1, result->getNumber<uint32_t>("level"));
+	player->setSex(static_cast<PlayerSex_t>(result->getNumber<uint16_t>(PLAYERCOLUMN_SEX)));
+	player->level = std::max<uint32_t>(1, result->getNumber<uint32_t>(PLAYERCOLUMN_LEVEL));
 
-	uint64_t experience = result->getNumber<uint64_t>("experience");
+	uint64_t experience = result->getNumber<uint64_t>(PLAYERCOLUMN_EXPERIENCE);
 
 	uint64_t currExpCount = Player::getExpForLevel(player->level);
 	uint64_t nextExpCount = Player::getExpForLevel(player->level + 1);
@@ -319,12 +365,12 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 		player->levelPercent = 0;
 	}
 
-	player->soul = result->getNumber<uint16_t>("soul");
-	player->capacity = result->getNumber<uint32_t>("cap") * 100;
-	player->blessings = result->getNumber<uint16_t>("blessings");
+	player->soul = result->getNumber<uint16_t>(PLAYERCOLUMN_SOUL);
+	player->capacity = result->getNumber<uint32_t>(PLAYERCOLUMN_CAP) * 100;
+	player->blessings = result->getNumber<uint16_t>(PLAYERCOLUMN_BLESSINGS);
 
 	unsigned long conditionsSize;
-	const char* conditions = result->getStream("conditions", conditionsSize);
+	const char* conditions = result->getStream(PLAYERCOLUMN_CONDITIONS, conditionsSize);
 	PropStream propStream;
 	propStream.init(conditions, conditionsSize);
 
@@ -338,17 +384,17 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 		condition = Condition::createCondition(propStream);
 	}
 
-	if (!player->setVocation(result->getNumber<uint16_t>("vocation"))) {
-		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Vocation ID " << result->getNumber<uint16_t>("vocation") << " which doesn't exist" << std::endl;
+	if (!player->setVocation(result->getNumber<uint16_t>(PLAYERCOLUMN_VOCATION))) {
+		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Vocation ID " << result->getNumber<uint16_t>(PLAYERCOLUMN_VOCATION) << " which doesn't exist" << std::endl;
 		return false;
 	}
 
-	player->mana = result->getNumber<uint32_t>("mana");
-	player->manaMax = result->getNumber<uint32_t>("manamax");
-	player->magLevel = result->getNumber<uint32_t>("maglevel");
+	player->mana = result->getNumber<uint32_t>(PLAYERCOLUMN_MANA);
+	player->manaMax = result->getNumber<uint32_t>(PLAYERCOLUMN_MANAMAX);
+	player->magLevel = result->getNumber<uint32_t>(PLAYERCOLUMN_MAGLEVEL);
 
 	uint64_t nextManaCount = player->vocation->getReqMana(player->magLevel + 1);
-	uint64_t manaSpent = result->getNumber<uint64_t>("manaspent");
+	uint64_t manaSpent = result->getNumber<uint64_t>(PLAYERCOLUMN_MANASPENT);
 	if (manaSpent > nextManaCount) {
 		manaSpent = 0;
 	}
@@ -356,24 +402,24 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 	player->manaSpent = manaSpent;
 	player->magLevelPercent = Player::getPercentLevel(player->manaSpent, nextManaCount);
 
-	player->health = result->getNumber<int32_t>("health");
-	player->healthMax = result->getNumber<int32_t>("healthmax");
+	player->health = result->getNumber<int32_t>(PLAYERCOLUMN_HEALTH);
+	player->healthMax = result->getNumber<int32_t>(PLAYERCOLUMN_HEALTHMAX);
 
-	player->defaultOutfit.lookType = result->getNumber<uint16_t>("looktype");
-	player->defaultOutfit.lookHead = result->getNumber<uint16_t>("lookhead");
-	player->defaultOutfit.lookBody = result->getNumber<uint16_t>("lookbody");
-	player->defaultOutfit.lookLegs = result->getNumber<uint16_t>("looklegs");
-	player->defaultOutfit.lookFeet = result->getNumber<uint16_t>("lookfeet");
-	player->defaultOutfit.lookAddons = result->getNumber<uint16_t>("lookaddons");
+	player->defaultOutfit.lookType = result->getNumber<uint16_t>(PLAYERCOLUMN_LOOKTYPE);
+	player->defaultOutfit.lookHead = result->getNumber<uint16_t>(PLAYERCOLUMN_LOOKHEAD);
+	player->defaultOutfit.lookBody = result->getNumber<uint16_t>(PLAYERCOLUMN_LOOKBODY);
+	player->defaultOutfit.lookLegs = result->getNumber<uint16_t>(PLAYERCOLUMN_LOOKLEGS);
+	player->defaultOutfit.lookFeet = result->getNumber<uint16_t>(PLAYERCOLUMN_LOOKFEET);
+	player->defaultOutfit.lookAddons = result->getNumber<uint16_t>(PLAYERCOLUMN_LOOKADDONS);
 	player->currentOutfit = player->defaultOutfit;
 
 	if (g_game.getWorldType() != WORLD_TYPE_PVP_ENFORCED) {
-		const time_t skullSeconds = result->getNumber<time_t>("skulltime") - time(nullptr);
+		const time_t skullSeconds = result->getNumber<time_t>(PLAYERCOLUMN_SKULLTIME) - time(nullptr);
 		if (skullSeconds > 0) {
 			//ensure that we round up the number of ticks
 			player->skullTicks = (skullSeconds + 2) * 1000;
 
-			uint16_t skull = result->getNumber<uint16_t>("skull");
+			uint16_t skull = result->getNumber<uint16_t>(PLAYERCOLUMN_SKULL);
 			if (skull == SKULL_RED) {
 				player->skull = SKULL_RED;
 			} else if (skull == SKULL_BLACK) {
@@ -382,19 +428,19 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 		}
 	}
 
-	player->loginPosition.x = result->getNumber<uint16_t>("posx");
-	player->loginPosition.y = result->getNumber<uint16_t>("posy");
-	player->loginPosition.z = result->getNumber<uint16_t>("posz");
+	player->loginPosition.x = result->getNumber<uint16_t>(PLAYERCOLUMN_POSX);
+	player->loginPosition.y = result->getNumber<uint16_t>(PLAYERCOLUMN_POSY);
+	player->loginPosition.z = result->getNumber<uint16_t>(PLAYERCOLUMN_POSZ);
 
-	player->lastLoginSaved = result->getNumber<time_t>("lastlogin");
-	player->lastLogout = result->getNumber<time_t>("lastlogout");
+	player->lastLoginSaved = result->getNumber<time_t>(PLAYERCOLUMN_LASTLOGIN);
+	player->lastLogout = result->getNumber<time_t>(PLAYERCOLUMN_LASTLOGOUT);
 
-	player->offlineTrainingTime = result->getNumber<int32_t>("offlinetraining_time") * 1000;
-	player->offlineTrainingSkill = result->getNumber<int32_t>("offlinetraining_skill");
+	player->offlineTrainingTime = result->getNumber<int32_t>(PLAYERCOLUMN_OFFLINETRAINING_TIME) * 1000;
+	player->offlineTrainingSkill = result->getNumber<int32_t>(PLAYERCOLUMN_OFFLINETRAINING_SKILL);
 
-	Town* town = g_game.map.towns.getTown(result->getNumber<uint32_t>("town_id"));
+	Town* town = g_game.map.towns.getTown(result->getNumber<uint32_t>(PLAYERCOLUMN_TOWN_ID));
 	if (!town) {
-		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Town ID " << result->getNumber<uint32_t>("town_id") << " which doesn't exist" << std::endl;
+		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Town ID " << result->getNumber<uint32_t>(PLAYERCOLUMN_TOWN_ID) << " which doesn't exist" << std::endl;
 		return false;
 	}
 
@@ -405,14 +451,12 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 		player->loginPosition = player->getTemplePosition();
 	}
 
-	player->staminaMinutes = result->getNumber<uint16_t>("stamina");
+	player->staminaMinutes = result->getNumber<uint16_t>(PLAYERCOLUMN_STAMINA);
 
-	static const std::string skillNames[] = {"skill_fist", "skill_club", "skill_sword", "skill_axe", "skill_dist", "skill_shielding", "skill_fishing"};
-	static const std::string skillNameTries[] = {"skill_fist_tries", "skill_club_tries", "skill_sword_tries", "skill_axe_tries", "skill_dist_tries", "skill_shielding_tries", "skill_fishing_tries"};
-	static const size_t size = sizeof(skillNames) / sizeof(std::string);
-	for (uint8_t i = 0; i < size; ++i) {
-		uint16_t skillLevel = result->getNumber<uint16_t>(skillNames[i]);
-		uint64_t skillTries = result->getNumber<uint64_t>(skillNameTries[i]);
+	// every skill column is followed by its tries
+	for (uint8_t i = SKILL_FIRST; i <= SKILL_LAST; ++i) {
+		uint16_t skillLevel = result->getNumber<uint16_t>(PLAYERCOLUMN_SKILL_FIST + i * 2);
+		uint64_t skillTries = result->getNumber<uint64_t>(PLAYERCOLUMN_SKILL_FIST_TRIES + i * 2);
 		uint64_t nextSkillTries = player->vocation->getReqSkillTries(i, skillLevel + 1);
 		if (skillTries > nextSkillTries) {
 			skillTries = 0;
@@ -423,27 +467,28 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 		player->skills[i].percent = Player::getPercentLevel(skillTries, nextSkillTries);
 	}
 
-	std::ostringstream query;
-	query << "SELECT `guild_id`, `rank_id`, `nick` FROM `guild_membership` WHERE `player_id` = " << player->getGUID();
-	if ((result = db->storeQuery(query.str()))) {
-		uint32_t guildId = result->getNumber<uint32_t>("guild_id");
-		uint32_t playerRankId = result->getNumber<uint32_t>("rank_id");
-		player->guildNick = result->getString("nick");
+	const uint32_t guid = player->getGUID();
+
+	DBStatement* statement = db->prepare("SELECT `guild_id`, `rank_id`, `nick` FROM `guild_membership` WHERE `player_id` = ?");
+	statement->bind(0, guid);
+	if ((result = statement->storeQuery())) {
+		uint32_t guildId = result->getNumber<uint32_t>(0);
+		uint32_t playerRankId = result->getNumber<uint32_t>(1);
+		player->guildNick = result->getString(2);
 
 		Guild* guild = g_game.getGuild(guildId);
 		if (!guild) {
-			query.str(std::string());
-			query << "SELECT `name` FROM `guilds` WHERE `id` = " << guildId;
-			if ((result = db->storeQuery(query.str()))) {
-				guild = new Guild(guildId, result->getString("name"));
+			statement = db->prepare("SELECT `name` FROM `guilds` WHERE `id` = ?");
+			statement->bind(0, guildId);
+			if ((result = statement->storeQuery())) {
+				guild = new Guild(guildId, result->getString(0));
 				g_game.addGuild(guild);
 
-				query.str(std::string());
-				query << "SELECT `id`, `name`, `level` FROM `guild_ranks` WHERE `guild_id` = " << guildId << " LIMIT 3";
-
-				if ((result = db->storeQuery(query.str()))) {
+				statement = db->prepare("SELECT `id`, `name`, `level` FROM `guild_ranks` WHERE `guild_id` = ? LIMIT 3");
+				statement->bind(0, guildId);
+				if ((result = statement->storeQuery())) {
 					do {
-						guild->addRank(result->getNumber<uint32_t>("id"), result->getString("name"), result->getNumber<uint16_t>("level"));
+						guild->addRank(result->getNumber<uint32_t>(0), result->getString(1), result->getNumber<uint16_t>(2));
 					} while (result->next());
 				}
 			}
@@ -459,40 +504,42 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 			}
 			IOGuild::getWarList(guildId, player->guildWarList);
 
-			query.str(std::string());
-			query << "SELECT COUNT(*) AS `members` FROM `guild_membership` WHERE `guild_id` = " << guildId;
-			if ((result = db->storeQuery(query.str()))) {
-				guild->setMemberCount(result->getNumber<uint32_t>("members"));
+			statement = db->prepare("SELECT COUNT(*) FROM `guild_membership` WHERE `guild_id` = ?");
+			statement->bind(0, guildId);
+			if ((result = statement->storeQuery())) {
+				guild->setMemberCount(result->getNumber<uint32_t>(0));
 			}
 		}
 	}
 
-	query.str(std::string());
-	query << "SELECT `player_id`, `name` FROM `player_spells` WHERE `player_id` = " << player->getGUID();
-	if ((result = db->storeQuery(query.str()))) {
+	statement = db->prepare("SELECT `name` FROM `player_spells` WHERE `player_id` = ?");
+	statement->bind(0, guid);
+	if ((result = statement->storeQuery())) {
 		do {
-			player->learnedInstantSpellList.emplace_front(result->getString("name"));
+			player->learnedInstantSpellList.emplace_front(result->getString(0));
 		} while (result->next());
 	}
 
 	//load inventory items
 	ItemMap itemMap;
 
-	query.str(std::string());
-	query << "SELECT `player_id`, `time`, `target`, `unavenged` FROM `player_kills` WHERE `player_id` = " << player->getGUID();
-	if ((result = db->storeQuery(query.str()))) {
+	statement = db->prepare("SELECT `time`, `target`, `unavenged` FROM `player_kills` WHERE `player_id` = ?");
+	statement->bind(0, guid);
+	if ((result = statement->storeQuery())) {
 		do {
-			time_t killTime = result->getNumber<time_t>("time");
+			time_t killTime = result->getNumber<time_t>(0);
 			if ((time(nullptr) - killTime) <= 45 * 24 * 60 * 60) {
-				player->unjustifiedKills.emplace_back(result->getNumber<uint32_t>("target"), killTime, result->getNumber<bool>("unavenged"));
+				player->unjustifiedKills.emplace_back(result->getNumber<uint32_t>(1), killTime, result->getNumber<bool>(2));
+			} else {
+				player->dirtySections |= PLAYER_SAVE_KILLS;
 			}
 		} while (result->next());
 	}
 
-	query.str(std::string());
-	query << "SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `player_items` WHERE `player_id` = " << player->getGUID() << " ORDER BY `sid` DESC";
-	if ((result = db->storeQuery(query.str()))) {
-		loadItems(itemMap, result);
+	statement = db->prepare("SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `player_items` WHERE `player_id` = ? ORDER BY `sid` DESC");
+	statement->bind(0, guid);
+	if ((result = statement->storeQuery())) {
+		player->itemsFingerprint[0] = loadItems(itemMap, result);
 
 		for (ItemMap::const_reverse_iterator it = itemMap.rbegin(), end = itemMap.rend(); it != end; ++it) {
 			const std::pair<Item*, int32_t>& pair = it->second;
@@ -520,10 +567,10 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 	//load depot items
 	itemMap.clear();
 
-	query.str(std::string());
-	query << "SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `player_depotitems` WHERE `player_id` = " << player->getGUID() << " ORDER BY `sid` DESC";
-	if ((result = db->storeQuery(query.str()))) {
-		loadItems(itemMap, result);
+	statement = db->prepare("SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `player_depotitems` WHERE `player_id` = ? ORDER BY `sid` DESC");
+	statement->bind(0, guid);
+	if ((result = statement->storeQuery())) {
+		player->itemsFingerprint[1] = loadItems(itemMap, result);
 
 		for (ItemMap::const_reverse_iterator it = itemMap.rbegin(), end = itemMap.rend(); it != end; ++it) {
 			const std::pair<Item*, int32_t>& pair = it->second;
@@ -571,10 +618,10 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 	//load inbox items
 	itemMap.clear();
 
-	query.str(std::string());
-	query << "SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `player_inboxitems` WHERE `player_id` = " << player->getGUID() << " ORDER BY `sid` DESC";
-	if ((result = db->storeQuery(query.str()))) {
-		loadItems(itemMap, result);
+	statement = db->prepare("SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `player_inboxitems` WHERE `player_id` = ? ORDER BY `sid` DESC");
+	statement->bind(0, guid);
+	if ((result = statement->storeQuery())) {
+		player->itemsFingerprint[2] = loadItems(itemMap, result);
 
 		for (ItemMap::const_reverse_iterator it = itemMap.rbegin(), end = itemMap.rend(); it != end; ++it) {
 			const std::pair<Item*, int32_t>& pair = it->second;
@@ -601,10 +648,10 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 	//load houseinbox items
 	itemMap.clear();
 
-	query.str(std::string());
-	query << "SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `player_houseitems` WHERE `player_id` = " << player->getGUID() << " ORDER BY `sid` DESC";
-	if ((result = db->storeQuery(query.str()))) {
-		loadItems(itemMap, result);
+	statement = db->prepare("SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `player_houseitems` WHERE `player_id` = ? ORDER BY `sid` DESC");
+	statement->bind(0, guid);
+	if ((result = statement->storeQuery())) {
+		player->itemsFingerprint[3] = loadItems(itemMap, result);
 
 		for (ItemMap::const_reverse_iterator it = itemMap.rbegin(), end = itemMap.rend(); it != end; ++it) {
 			const std::pair<Item*, int32_t>& pair = it->second;
@@ -632,10 +679,10 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 	//load rewardchest items
 	itemMap.clear();
 
-	query.str(std::string());
-	query << "SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `player_rewarditems` WHERE `player_id` = " << player->getGUID() << " ORDER BY `sid` DESC";
-	if ((result = db->storeQuery(query.str()))) {
-		loadItems(itemMap, result);
+	statement = db->prepare("SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `player_rewarditems` WHERE `player_id` = ? ORDER BY `sid` DESC");
+	statement->bind(0, guid);
+	if ((result = statement->storeQuery())) {
+		player->itemsFingerprint[4] = loadItems(itemMap, result);
 
 		for (ItemMap::reverse_iterator it = itemMap.rbegin(); it != itemMap.rend(); ++it) {
 			const std::pair<Item*, int32_t>& pair = it->second;
@@ -661,20 +708,20 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 	}
 
 	//load storage map
-	query.str(std::string());
-	query << "SELECT `key`, `value` FROM `player_storage` WHERE `player_id` = " << player->getGUID();
-	if ((result = db->storeQuery(query.str()))) {
+	statement = db->prepare("SELECT `key`, `value` FROM `player_storage` WHERE `player_id` = ?");
+	statement->bind(0, guid);
+	if ((result = statement->storeQuery())) {
 		do {
-			player->addStorageValue(result->getNumber<uint32_t>("key"), result->getNumber<int32_t>("value"), true);
+			player->addStorageValue(result->getNumber<uint32_t>(0), result->getNumber<int32_t>(1), true);
 		} while (result->next());
 	}
 
 	//load vip
-	query.str(std::string());
-	query << "SELECT `player_id` FROM `account_viplist` WHERE `account_id` = " << player->getAccount();
-	if ((result = db->storeQuery(query.str()))) {
+	statement = db->prepare("SELECT `player_id` FROM `account_viplist` WHERE `account_id` = ?");
+	statement->bind(0, player->getAccount());
+	if ((result = statement->storeQuery())) {
 		do {
-			player->addVIPInternal(result->getNumber<uint32_t>("player_id"));
+			player->addVIPInternal(result->getNumber<uint32_t>(0));
 		} while (result->next());
 	}
 
@@ -684,16 +731,13 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 	return true;
 }
 
-bool IOLoginData::saveItems(const Player* player, const ItemBlockList& itemList, DBInsert& query_insert, PropWriteStream& propWriteStream)
+void IOLoginData::captureItems(const ItemBlockList& itemList, std::vector<PlayerItemRow>& rows, PropWriteStream& propWriteStream)
 {
-	std::ostringstream ss;
-
 	typedef std::pair<Container*, int32_t> containerBlock;
 	std::list<containerBlock> queue;
 
 	int32_t runningId = 100;
 
-	Database* db = Database::getInstance();
 	for (const auto& it : itemList) {
 		int32_t pid = it.first;
 		Item* item = it.second;
@@ -704,11 +748,7 @@ bool IOLoginData::saveItems(const Player* player, const ItemBlockList& itemList,
 
 		size_t attributesSize;
 		const char* attributes = propWriteStream.getStream(attributesSize);
-
-		ss << player->getGUID() << ',' << pid << ',' << runningId << ',' << item->getID() << ',' << item->getSubType() << ',' << db->escapeBlob(attributes, attributesSize);
-		if (!query_insert.addRow(ss)) {
-			return false;
-		}
+		rows.emplace_back(pid, runningId, item->getID(), item->getSubType(), std::string(attributes, attributesSize));
 
 		if (Container* container = item->getContainer()) {
 			queue.emplace_back(container, runningId);
@@ -734,37 +774,86 @@ bool IOLoginData::saveItems(const Player* player, const ItemBlockList& itemList,
 
 			size_t attributesSize;
 			const char* attributes = propWriteStream.getStream(attributesSize);
-
-			ss << player->getGUID() << ',' << parentId << ',' << runningId << ',' << item->getID() << ',' << item->getSubType() << ',' << db->escapeBlob(attributes, attributesSize);
-			if (!query_insert.addRow(ss)) {
-				return false;
-			}
+			rows.emplace_back(parentId, runningId, item->getID(), item->getSubType(), std::string(attributes, attributesSize));
 		}
 	}
-	return query_insert.execute();
 }
 
-bool IOLoginData::savePlayer(Player* player)
+void IOLoginData::trackItems(Player* player, PlayerSaveData& data, uint8_t section, const std::vector<PlayerItemRow>& rows)
 {
-	if (player->getHealth() <= 0) {
-		player->changeHealth(1);
+	// decay, charges, script attributes and nested containers all change items
+	// without going through the player, comparing the rows catches every one
+	uint64_t fingerprint = 0;
+	for (const PlayerItemRow& row : rows) {
+		fingerprint += getItemRowFingerprint(row.pid, row.sid, row.itemType, row.count, row.attributes.data(), row.attributes.size());
 	}
 
-	Database* db = Database::getInstance();
+	uint8_t index = 0;
+	while ((1 << index) != section) {
+		++index;
+	}
+
+	uint64_t& lastFingerprint = player->itemsFingerprint[index];
+	if (fingerprint != lastFingerprint) {
+		lastFingerprint = fingerprint;
+		data.sections |= section;
+	}
+}
 
+bool IOLoginData::writeItems(Database& db, uint32_t guid, const std::string& table, const std::vector<PlayerItemRow>& rows, uint32_t& written)
+{
+	DBStatement* statement = db.prepare("DELETE FROM `" + table + "` WHERE `player_id` = ?");
+	statement->bind(0, guid);
+	if (!statement->executeQuery()) {
+		return false;
+	}
+
+	// one multi-row INSERT is a single round trip, a statement per row would not be
 	std::ostringstream query;
-	query << "SELECT `save` FROM `players` WHERE `id` = " << player->getGUID();
-	DBResult_ptr result = db->storeQuery(query.str());
-	if (!result) {
+	DBInsert insertQuery("INSERT INTO `" + table + "` (`player_id`, `pid`, `sid`, `itemtype`, `count`, `attributes`) VALUES ", &db);
+	for (const PlayerItemRow& row : rows) {
+		query << guid << ',' << row.pid << ',' << row.sid << ',' << row.itemType << ',' << row.count << ',' << db.escapeBlob(row.attributes.data(), row.attributes.size());
+		if (!insertQuery.addRow(query)) {
+			return false;
+		}
+	}
+
+	if (!insertQuery.execute()) {
 		return false;
 	}
 
-	if (result->getNumber<uint16_t>("save") == 0) {
-		query.str(std::string());
-		query << "UPDATE `players` SET `lastlogin` = " << player->lastLoginSaved << ", `lastip` = " << player->lastIP << " WHERE `id` = " << player->getGUID();
-		return db->executeQuery(query.str());
+	written += rows.size();
+	return true;
+}
+
+bool IOLoginData::savePlayer(Player* player)
+{
+	PlayerSaveData data;
+	capturePlayer(player, data);
+
+	// a snapshot still waiting in the world save is older than this one, and
+	// whatever an earlier save could not write has to be written now
+	data.sections |= g_worldSave.flushPlayer(data.guid);
+
+	uint32_t rows = 0;
+	if (!writePlayer(*Database::getInstance(), data, rows)) {
+		player->dirtySections |= data.getPendingSections();
+		return false;
+	}
+	return true;
+}
+
+void IOLoginData::capturePlayer(Player* player, PlayerSaveData& data)
+{
+	if (player->getHealth() <= 0) {
+		player->changeHealth(1);
 	}
 
+	data.guid = player->getGUID();
+	data.name = player->getName();
+	data.lastLoginSaved = player->lastLoginSaved;
+	data.lastIP = player->lastIP;
+
 	//serialize conditions
 	PropWriteStream propWriteStream;
 	for (Condition* condition : player->conditions) {
@@ -776,47 +865,50 @@ bool IOLoginData::savePlayer(Player* player)
 
 	size_t conditionsSize;
 	const char* conditions = propWriteStream.getStream(conditionsSize);
+	data.conditions.assign(conditions, conditionsSize);
 
-	//First, an UPDATE query to write the player itself
-	query.str(std::string());
-	query << "UPDATE `players` SET ";
-	query << "`level` = " << player->level << ',';
-	query << "`group_id` = " << player->group->id << ',';
-	query << "`vocation` = " << player->getVocationId() << ',';
-	query << "`health` = " << player->health << ',';
-	query << "`healthmax` = " << player->healthMax << ',';
-	query << "`experience` = " << player->experience << ',';
-	query << "`lookbody` = " << static_cast<uint32_t>(player->defaultOutfit.lookBody) << ',';
-	query << "`lookfeet` = " << static_cast<uint32_t>(player->defaultOutfit.lookFeet) << ',';
-	query << "`lookhead` = " << static_cast<uint32_t>(player->defaultOutfit.lookHead) << ',';
-	query << "`looklegs` = " << static_cast<uint32_t>(player->defaultOutfit.lookLegs) << ',';
-	query << "`looktype` = " << player->defaultOutfit.lookType << ',';
-	query << "`lookaddons` = " << static_cast<uint32_t>(player->defaultOutfit.lookAddons) << ',';
-	query << "`maglevel` = " << player->magLevel << ',';
-	query << "`mana` = " << player->mana << ',';
-	query << "`manamax` = " << player->manaMax << ',';
-	query << "`manaspent` = " << player->manaSpent << ',';
-	query << "`soul` = " << static_cast<uint16_t>(player->soul) << ',';
-	query << "`town_id` = " << player->town->getID() << ',';
+	//the columns of the player row, their values are bound when it is written
+	std::ostringstream query;
+	auto setColumn = [&query, &data](const char* column, int64_t value) {
+		query << '`' << column << "` = ?,";
+		data.values.push_back(value);
+	};
+
+	setColumn("level", player->level);
+	setColumn("group_id", player->group->id);
+	setColumn("vocation", player->getVocationId());
+	setColumn("health", player->health);
+	setColumn("healthmax", player->healthMax);
+	setColumn("experience", player->experience);
+	setColumn("lookbody", player->defaultOutfit.lookBody);
+	setColumn("lookfeet", player->defaultOutfit.lookFeet);
+	setColumn("lookhead", player->defaultOutfit.lookHead);
+	setColumn("looklegs", player->defaultOutfit.lookLegs);
+	setColumn("looktype", player->defaultOutfit.lookType);
+	setColumn("lookaddons", player->defaultOutfit.lookAddons);
+	setColumn("maglevel", player->magLevel);
+	setColumn("mana", player->mana);
+	setColumn("manamax", player->manaMax);
+	setColumn("manaspent", player->manaSpent);
+	setColumn("soul", player->soul);
+	setColumn("town_id", player->town->getID());
 
 	const Position& loginPosition = player->getLoginPosition();
-	query << "`posx` = " << loginPosition.getX() << ',';
-	query << "`posy` = " << loginPosition.getY() << ',';
-	query << "`posz` = " << loginPosition.getZ() << ',';
+	setColumn("posx", loginPosition.getX());
+	setColumn("posy", loginPosition.getY());
+	setColumn("posz", loginPosition.getZ());
 
-	query << "`cap` = " << (player->capacity / 100) << ',';
-	query << "`sex` = " << player->sex << ',';
+	setColumn("cap", player->capacity / 100);
+	setColumn("sex", player->sex);
 
 	if (player->lastLoginSaved != 0) {
-		query << "`lastlogin` = " << player->lastLoginSaved << ',';
+		setColumn("lastlogin", player->lastLoginSaved);
 	}
 
 	if (player->lastIP != 0) {
-		query << "`lastip` = " << player->lastIP << ',';
+		setColumn("lastip", player->lastIP);
 	}
 
-	query << "`conditions` = " << db->escapeBlob(conditions, conditionsSize) << ',';
-
 	if (g_game.getWorldType() != WORLD_TYPE_PVP_ENFORCED) {
 		int32_t skullTime = 0;
 
@@ -824,7 +916,7 @@ bool IOLoginData::savePlayer(Player* player)
 			skullTime = time(nullptr) + player->skullTicks / 1000;
 		}
 
-		query << "`skulltime` = " << skullTime << ',';
+		setColumn("skulltime", skullTime);
 
 		Skulls_t skull = SKULL_NONE;
 		if (player->skull == SKULL_RED) {
@@ -832,209 +924,274 @@ bool IOLoginData::savePlayer(Player* player)
 		} else if (player->skull == SKULL_BLACK) {
 			skull = SKULL_BLACK;
 		}
-		query << "`skull` = " << static_cast<uint32_t>(skull) << ',';
-	}
-
-	query << "`lastlogout` = " << player->getLastLogout() << ',';
-	query << "`balance` = " << player->bankBalance << ',';
-	query << "`offlinetraining_time` = " << player->getOfflineTrainingTime() / 1000 << ',';
-	query << "`offlinetraining_skill` = " << player->getOfflineTrainingSkill() << ',';
-	query << "`stamina` = " << player->getStaminaMinutes() << ',';
-
-	query << "`skill_fist` = " << player->skills[SKILL_FIST].level << ',';
-	query << "`skill_fist_tries` = " << player->skills[SKILL_FIST].tries << ',';
-	query << "`skill_club` = " << player->skills[SKILL_CLUB].level << ',';
-	query << "`skill_club_tries` = " << player->skills[SKILL_CLUB].tries << ',';
-	query << "`skill_sword` = " << player->skills[SKILL_SWORD].level << ',';
-	query << "`skill_sword_tries` = " << player->skills[SKILL_SWORD].tries << ',';
-	query << "`skill_axe` = " << player->skills[SKILL_AXE].level << ',';
-	query << "`skill_axe_tries` = " << player->skills[SKILL_AXE].tries << ',';
-	query << "`skill_dist` = " << player->skills[SKILL_DISTANCE].level << ',';
-	query << "`skill_dist_tries` = " << player->skills[SKILL_DISTANCE].tries << ',';
-	query << "`skill_shielding` = " << player->skills[SKILL_SHIELD].level << ',';
-	query << "`skill_shielding_tries` = " << player->skills[SKILL_SHIELD].tries << ',';
-	query << "`skill_fishing` = " << player->skills[SKILL_FISHING].level << ',';
-	query << "`skill_fishing_tries` = " << player->skills[SKILL_FISHING].tries << ',';
+		setColumn("skull", skull);
+	}
+
+	setColumn("lastlogout", player->getLastLogout());
+	setColumn("balance", player->bankBalance);
+	setColumn("offlinetraining_time", player->getOfflineTrainingTime() / 1000);
+	setColumn("offlinetraining_skill", player->getOfflineTrainingSkill());
+	setColumn("stamina", player->getStaminaMinutes());
+
+	setColumn("skill_fist", player->skills[SKILL_FIST].level);
+	setColumn("skill_fist_tries", player->skills[SKILL_FIST].tries);
+	setColumn("skill_club", player->skills[SKILL_CLUB].level);
+	setColumn("skill_club_tries", player->skills[SKILL_CLUB].tries);
+	setColumn("skill_sword", player->skills[SKILL_SWORD].level);
+	setColumn("skill_sword_tries", player->skills[SKILL_SWORD].tries);
+	setColumn("skill_axe", player->skills[SKILL_AXE].level);
+	setColumn("skill_axe_tries", player->skills[SKILL_AXE].tries);
+	setColumn("skill_dist", player->skills[SKILL_DISTANCE].level);
+	setColumn("skill_dist_tries", player->skills[SKILL_DISTANCE].tries);
+	setColumn("skill_shielding", player->skills[SKILL_SHIELD].level);
+	setColumn("skill_shielding_tries", player->skills[SKILL_SHIELD].tries);
+	setColumn("skill_fishing", player->skills[SKILL_FISHING].level);
+	setColumn("skill_fishing_tries", player->skills[SKILL_FISHING].tries);
 
 	if (!player->isOffline()) {
-		query << "`onlinetime` = `onlinetime` + " << (time(nullptr) - player->lastLoginSaved) << ',';
+		query << "`onlinetime` = `onlinetime` + ?,";
+		data.values.push_back(time(nullptr) - player->lastLoginSaved);
 	}
-	query << "`blessings` = " << static_cast<uint32_t>(player->blessings);
-	query << " WHERE `id` = " << player->getGUID();
+	setColumn("blessings", player->blessings);
+	data.columns = query.str();
 
-	DBTransaction transaction;
-	if (!transaction.begin()) {
-		return false;
-	}
-
-	if (!db->executeQuery(query.str())) {
-		return false;
-	}
+	// sections flagged by the player itself, the item sections are added by trackItems
+	data.sections = player->dirtySections;
+	player->dirtySections = PLAYER_SAVE_NONE;
 
 	// learned spells
-	query.str(std::string());
-	query << "DELETE FROM `player_spells` WHERE `player_id` = " << player->getGUID();
-	if (!db->executeQuery(query.str())) {
-		return false;
-	}
+	data.spells.assign(player->learnedInstantSpellList.begin(), player->learnedInstantSpellList.end());
 
-	query.str(std::string());
+	//player kills
+	data.kills = player->unjustifiedKills;
 
-	DBInsert spellsQuery("INSERT INTO `player_spells` (`player_id`, `name` ) VALUES ");
-	for (const std::string& spellName : player->learnedInstantSpellList) {
-		query << player->getGUID() << ',' << db->escapeString(spellName);
-		if (!spellsQuery.addRow(query)) {
-			return false;
+	//item saving
+	ItemBlockList itemList;
+	for (int32_t slotId = 1; slotId <= 11; ++slotId) {
+		Item* item = player->inventory[slotId];
+		if (item) {
+			itemList.emplace_back(slotId, item);
 		}
 	}
+	captureItems(itemList, data.items, propWriteStream);
+	trackItems(player, data, PLAYER_SAVE_ITEMS, data.items);
 
-	if (!spellsQuery.execute()) {
-		return false;
+	data.saveDepot = player->lastDepotId != -1;
+	if (data.saveDepot) {
+		itemList.clear();
+		for (const auto& it : player->depotChests) {
+			DepotChest* depotChest = it.second;
+			for (Item* item : depotChest->getItemList()) {
+				itemList.emplace_back(it.first, item);
+			}
+		}
+		captureItems(itemList, data.depotItems, propWriteStream);
+		trackItems(player, data, PLAYER_SAVE_DEPOTITEMS, data.depotItems);
 	}
 
-	//player kills
-	query.str(std::string());
-	query << "DELETE FROM `player_kills` WHERE `player_id` = " << player->getGUID();
-	if (!db->executeQuery(query.str())) {
-		return false;
+	itemList.clear();
+	for (Item* item : player->getInbox()->getItemList()) {
+		itemList.emplace_back(0, item);
 	}
+	captureItems(itemList, data.inboxItems, propWriteStream);
+	trackItems(player, data, PLAYER_SAVE_INBOXITEMS, data.inboxItems);
 
-	query.str(std::string());
+	itemList.clear();
+	for (Item* item : player->getHouseInbox()->getItemList()) {
+		itemList.emplace_back(0, item);
+	}
+	captureItems(itemList, data.houseInboxItems, propWriteStream);
+	trackItems(player, data, PLAYER_SAVE_HOUSEITEMS, data.houseInboxItems);
 
-	DBInsert killsQuery("INSERT INTO `player_kills` (`player_id`, `target`, `time`, `unavenged`) VALUES");
-	for (const auto& kill : player->unjustifiedKills) {
-		query << player->getGUID() << ',' << kill.target << ',' << kill.time << ',' << kill.unavenged;
-		if (!killsQuery.addRow(query)) {
-			return false;
-		}
+	itemList.clear();
+	for (Item* item : player->getRewardChest()->getItemList()) {
+		itemList.emplace_back(0, item);
 	}
+	captureItems(itemList, data.rewardItems, propWriteStream);
+	trackItems(player, data, PLAYER_SAVE_REWARDITEMS, data.rewardItems);
 
-	if (!killsQuery.execute()) {
-		return false;
+	player->genReservedStorageRange();
+	data.storage.assign(player->storageMap.begin(), player->storageMap.end());
+	if (!(data.sections & PLAYER_SAVE_STORAGE)) {
+		data.storageKeys.assign(player->dirtyStorageKeys.begin(), player->dirtyStorageKeys.end());
+		std::sort(data.storageKeys.begin(), data.storageKeys.end());
 	}
+	player->dirtyStorageKeys.clear();
+}
 
-	//item saving
-	query << "DELETE FROM `player_items` WHERE `player_id` = " << player->getGUID();
-	if (!db->executeQuery(query.str())) {
+bool IOLoginData::writePlayer(Database& db, const PlayerSaveData& data, uint32_t& rows)
+{
+	DBStatement* statement = db.prepare("SELECT `save` FROM `players` WHERE `id` = ?");
+	statement->bind(0, data.guid);
+	DBStatementResult_ptr result = statement->storeQuery();
+	if (!result) {
 		return false;
 	}
 
-	DBInsert itemsQuery("INSERT INTO `player_items` (`player_id`, `pid`, `sid`, `itemtype`, `count`, `attributes`) VALUES ");
+	if (result->getNumber<uint16_t>(0) == 0) {
+		statement = db.prepare("UPDATE `players` SET `lastlogin` = ?, `lastip` = ? WHERE `id` = ?");
+		statement->bind(0, data.lastLoginSaved);
+		statement->bind(1, data.lastIP);
+		statement->bind(2, data.guid);
+		return statement->executeQuery();
+	}
 
-	ItemBlockList itemList;
-	for (int32_t slotId = 1; slotId <= 11; ++slotId) {
-		Item* item = player->inventory[slotId];
-		if (item) {
-			itemList.emplace_back(slotId, item);
-		}
+	//First, an UPDATE query to write the player itself
+	statement = db.prepare("UPDATE `players` SET " + data.columns + "`conditions` = ? WHERE `id` = ?");
+	size_t index = 0;
+	for (int64_t value : data.values) {
+		statement->bind(index++, value);
 	}
+	statement->bindBlob(index++, data.conditions.data(), data.conditions.size());
+	statement->bind(index, data.guid);
 
-	if (!saveItems(player, itemList, itemsQuery, propWriteStream)) {
+	DBTransaction transaction(&db);
+	if (!transaction.begin()) {
 		return false;
 	}
 
-	if (player->lastDepotId != -1) {
-		//save depot items
-		query.str(std::string());
-		query << "DELETE FROM `player_depotitems` WHERE `player_id` = " << player->getGUID();
+	if (!statement->executeQuery()) {
+		return false;
+	}
+
+	std::ostringstream query;
+
+	// counted as they are sent, added to rows once the transaction is committed
+	uint32_t written = 1;
 
-		if (!db->executeQuery(query.str())) {
+	// learned spells
+	if (data.sections & PLAYER_SAVE_SPELLS) {
+		statement = db.prepare("DELETE FROM `player_spells` WHERE `player_id` = ?");
+		statement->bind(0, data.guid);
+		if (!statement->executeQuery()) {
 			return false;
 		}
 
-		DBInsert depotQuery("INSERT INTO `player_depotitems` (`player_id`, `pid`, `sid`, `itemtype`, `count`, `attributes`) VALUES ");
-		itemList.clear();
-
-		for (const auto& it : player->depotChests) {
-			DepotChest* depotChest = it.second;
-			for (Item* item : depotChest->getItemList()) {
-				itemList.emplace_back(it.first, item);
+		DBInsert spellsQuery("INSERT INTO `player_spells` (`player_id`, `name` ) VALUES ", &db);
+		for (const std::string& spellName : data.spells) {
+			query << data.guid << ',' << db.escapeString(spellName);
+			if (!spellsQuery.addRow(query)) {
+				return false;
 			}
 		}
 
-		if (!saveItems(player, itemList, depotQuery, propWriteStream)) {
+		if (!spellsQuery.execute()) {
 			return false;
 		}
+		written += data.spells.size();
 	}
 
-	//save inbox items
-	query.str(std::string());
-	query << "DELETE FROM `player_inboxitems` WHERE `player_id` = " << player->getGUID();
-	if (!db->executeQuery(query.str())) {
-		return false;
-	}
+	//player kills
+	if (data.sections & PLAYER_SAVE_KILLS) {
+		statement = db.prepare("DELETE FROM `player_kills` WHERE `player_id` = ?");
+		statement->bind(0, data.guid);
+		if (!statement->executeQuery()) {
+			return false;
+		}
 
-	DBInsert inboxQuery("INSERT INTO `player_inboxitems` (`player_id`, `pid`, `sid`, `itemtype`, `count`, `attributes`) VALUES ");
-	itemList.clear();
+		DBInsert killsQuery("INSERT INTO `player_kills` (`player_id`, `target`, `time`, `unavenged`) VALUES", &db);
+		for (const auto& kill : data.kills) {
+			query << data.guid << ',' << kill.target << ',' << kill.time << ',' << kill.unavenged;
+			if (!killsQuery.addRow(query)) {
+				return false;
+			}
+		}
 
-	for (Item* item : player->getInbox()->getItemList()) {
-		itemList.emplace_back(0, item);
+		if (!killsQuery.execute()) {
+			return false;
+		}
+		written += data.kills.size();
 	}
 
-	if (!saveItems(player, itemList, inboxQuery, propWriteStream)) {
+	//item saving
+	if ((data.sections & PLAYER_SAVE_ITEMS) && !writeItems(db, data.guid, "player_items", data.items, written)) {
 		return false;
 	}
 
-	//save houseinbox items
-	query.str(std::string());
-	query << "DELETE FROM `player_houseitems` WHERE `player_id` = " << player->getGUID();
-	if (!db->executeQuery(query.str())) {
+	// without the depot loaded there is nothing to replace its rows with
+	if ((data.sections & PLAYER_SAVE_DEPOTITEMS) && data.saveDepot && !writeItems(db, data.guid, "player_depotitems", data.depotItems, written)) {
 		return false;
 	}
 
-	DBInsert houseInboxQuery("INSERT INTO `player_houseitems` (`player_id`, `pid`, `sid`, `itemtype`, `count`, `attributes`) VALUES ");
-	itemList.clear();
-
-	for (Item* item : player->getHouseInbox()->getItemList()) {
-		itemList.emplace_back(0, item);
+	if ((data.sections & PLAYER_SAVE_INBOXITEMS) && !writeItems(db, data.guid, "player_inboxitems", data.inboxItems, written)) {
+		return false;
 	}
 
-	if (!saveItems(player, itemList, houseInboxQuery, propWriteStream)) {
+	if ((data.sections & PLAYER_SAVE_HOUSEITEMS) && !writeItems(db, data.guid, "player_houseitems", data.houseInboxItems, written)) {
 		return false;
 	}
 
-	//save rewardchest items
-	query.str(std::string());
-	query << "DELETE FROM `player_rewarditems` WHERE `player_id` = " << player->getGUID();
-	if (!db->executeQuery(query.str())) {
+	if ((data.sections & PLAYER_SAVE_REWARDITEMS) && !writeItems(db, data.guid, "player_rewarditems", data.rewardItems, written)) {
 		return false;
 	}
 
-	DBInsert RewardChestQuery("INSERT INTO `player_rewarditems` (`player_id`, `pid`, `sid`, `itemtype`, `count`, `attributes`) VALUES ");
-	itemList.clear();
+	if (data.sections & PLAYER_SAVE_STORAGE) {
+		statement = db.prepare("DELETE FROM `player_storage` WHERE `player_id` = ?");
+		statement->bind(0, data.guid);
+		if (!statement->executeQuery()) {
+			return false;
+		}
 
-	for (Item* item : player->getRewardChest()->getItemList()) {
-		itemList.emplace_back(0, item);
-	}
+		DBInsert storageQuery("INSERT INTO `player_storage` (`player_id`, `key`, `value`) VALUES ", &db);
+		for (const auto& it : data.storage) {
+			query << data.guid << ',' << it.first << ',' << it.second;
+			if (!storageQuery.addRow(query)) {
+				return false;
+			}
+		}
 
-	if (!saveItems(player, itemList, RewardChestQuery, propWriteStream)) {
-		return false;
-	}
+		if (!storageQuery.execute()) {
+			return false;
+		}
+		written += data.storage.size();
+	} else if (!data.storageKeys.empty()) {
+		// only the keys that changed: upsert the ones still set, delete the others
+		std::ostringstream removedKeys;
 
-	query.str(std::string());
-	query << "DELETE FROM `player_storage` WHERE `player_id` = " << player->getGUID();
-	if (!db->executeQuery(query.str())) {
-		return false;
-	}
+		query.str(std::string());
 
-	query.str(std::string());
+		DBInsert storageQuery("INSERT INTO `player_storage` (`player_id`, `key`, `value`) VALUES ", &db);
+		storageQuery.upsert({"value"});
+		for (uint32_t key : data.storageKeys) {
+			auto it = std::lower_bound(data.storage.begin(), data.storage.end(), key, [](const std::pair<uint32_t, int32_t>& entry, uint32_t key) {
+				return entry.first < key;
+			});
 
-	DBInsert storageQuery("INSERT INTO `player_storage` (`player_id`, `key`, `value`) VALUES ");
-	player->genReservedStorageRange();
+			if (it == data.storage.end() || it->first != key) {
+				if (removedKeys.tellp() != 0) {
+					removedKeys << ',';
+				}
+				removedKeys << key;
+				continue;
+			}
 
-	for (const auto& it : player->storageMap) {
-		query << player->getGUID() << ',' << it.first << ',' << it.second;
-		if (!storageQuery.addRow(query)) {
+			query << data.guid << ',' << key << ',' << it->second;
+			if (!storageQuery.addRow(query)) {
+				return false;
+			}
+			++written;
+		}
+
+		if (!storageQuery.execute()) {
 			return false;
 		}
+
+		if (removedKeys.tellp() != 0) {
+			query.str(std::string());
+			query << "DELETE FROM `player_storage` WHERE `player_id` = " << data.guid << " AND `key` IN (" << removedKeys.str() << ')';
+			if (!db.executeQuery(query.str())) {
+				return false;
+			}
+		}
 	}
 
-	if (!storageQuery.execute()) {
+	//End the transaction
+	if (!transaction.commit()) {
 		return false;
 	}
 
-	//End the transaction
-	return transaction.commit();
+	rows += written;
+	return true;
 }
 
 std::string IOLoginData::getNameByGuid(uint32_t guid)
@@ -1103,16 +1260,19 @@ bool IOLoginData::formatPlayerName(std::string& name)
 	return true;
 }
 
-void IOLoginData::loadItems(ItemMap& itemMap, DBResult_ptr result)
+uint64_t IOLoginData::loadItems(ItemMap& itemMap, DBStatementResult_ptr result)
 {
+	// SELECT `pid`, `sid`, `itemtype`, `count`, `attributes`
+	uint64_t fingerprint = 0;
 	do {
-		uint32_t sid = result->getNumber<uint32_t>("sid");
-		uint32_t pid = result->getNumber<uint32_t>("pid");
-		uint16_t type = result->getNumber<uint16_t>("itemtype");
-		uint16_t count = result->getNumber<uint16_t>("count");
+		uint32_t pid = result->getNumber<uint32_t>(0);
+		uint32_t sid = result->getNumber<uint32_t>(1);
+		uint16_t type = result->getNumber<uint16_t>(2);
+		uint16_t count = result->getNumber<uint16_t>(3);
 
 		unsigned long attrSize;
-		const char* attr = result->getStream("attributes", attrSize);
+		const char* attr = result->getStream(4, attrSize);
+		fingerprint += getItemRowFingerprint(pid, sid, type, count, attr, attrSize);
 
 		PropStream propStream;
 		propStream.init(attr, attrSize);
@@ -1127,6 +1287,7 @@ void IOLoginData::loadItems(ItemMap& itemMap, DBResult_ptr result)
 			itemMap[sid] = pair;
 		}
 	} while (result->next());
+	return fingerprint;
 }
 
 void IOLoginData::increaseBankBalance(uint32_t guid, uint64_t bankBalance)
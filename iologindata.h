@@ -26,6 +26,53 @@
 
 typedef std::list<std::pair<int32_t, Item*>> ItemBlockList;
 
+struct PlayerItemRow {
+	PlayerItemRow(int32_t pid, int32_t sid, uint16_t itemType, uint16_t count, std::string attributes) :
+		pid(pid), sid(sid), itemType(itemType), count(count), attributes(std::move(attributes)) {}
+
+	int32_t pid;
+	int32_t sid;
+	uint16_t itemType;
+	uint16_t count;
+	std::string attributes;
+};
+
+// Everything savePlayer writes, taken from the Player on the dispatcher so
+// that it can be written later, from any thread, without touching the game.
+struct PlayerSaveData {
+	uint32_t guid = 0;
+	std::string name;
+	time_t lastLoginSaved = 0;
+	uint32_t lastIP = 0;
+
+	// SET list of the players row with a ? for each of the values, the
+	// conditions and the id are bound after them
+	std::string columns;
+	std::vector<int64_t> values;
+	std::string conditions;
+
+	std::vector<std::string> spells;
+	std::vector<Kill> kills;
+	std::vector<PlayerItemRow> items;
+	std::vector<PlayerItemRow> depotItems;
+	std::vector<PlayerItemRow> inboxItems;
+	std::vector<PlayerItemRow> houseInboxItems;
+	std::vector<PlayerItemRow> rewardItems;
+	std::vector<std::pair<uint32_t, int32_t>> storage;
+	// sorted, the keys to upsert or delete unless the whole storage is written
+	std::vector<uint32_t> storageKeys;
+
+	// PlayerSaveSection_t flags of what is written, the players row always is
+	uint8_t sections = PLAYER_SAVE_NONE;
+	// the depot is only written once it has been loaded
+	bool saveDepot = false;
+
+	// what a later save has to write if this one fails
+	uint8_t getPendingSections() const {
+		return storageKeys.empty() ? sections : (sections | PLAYER_SAVE_STORAGE);
+	}
+};
+
 class IOLoginData
 {
 	public:
@@ -43,8 +90,10 @@ class IOLoginData
 
 		static bool loadPlayerById(Player* player, uint32_t id);
 		static bool loadPlayerByName(Player* player, const std::string& name);
-		static bool loadPlayer(Player* player, DBResult_ptr result);
+		static bool loadPlayer(Player* player, DBStatementResult_ptr result);
 		static bool savePlayer(Player* player);
+		static void capturePlayer(Player* player, PlayerSaveData& data);
+		static bool writePlayer(Database& db, const PlayerSaveData& data, uint32_t& rows);
 		static uint32_t getGuidByName(const std::string& name);
 		static bool getGuidByNameEx(uint32_t& guid, bool& specialVip, std::string& name);
 		static std::string getNameByGuid(uint32_t guid);
@@ -64,8 +113,10 @@ class IOLoginData
 	protected:
 		typedef std::map<uint32_t, std::pair<Item*, uint32_t>> ItemMap;
 
-		static void loadItems(ItemMap& itemMap, DBResult_ptr result);
-		static bool saveItems(const Player* player, const ItemBlockList& itemList, DBInsert& query_insert, PropWriteStream& stream);
+		static uint64_t loadItems(ItemMap& itemMap, DBStatementResult_ptr result);
+		static void captureItems(const ItemBlockList& itemList, std::vector<PlayerItemRow>& rows, PropWriteStream& stream);
+		static void trackItems(Player* player, PlayerSaveData& data, uint8_t section, const std::vector<PlayerItemRow>& rows);
+		static bool writeItems(Database& db, uint32_t guid, const std::string& table, const std::vector<PlayerItemRow>& rows, uint32_t& written);
 };
 
 #endif
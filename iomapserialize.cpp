@@ -67,152 +67,112 @@ void IOMapSerialize::loadHouseItems(Map* map)
 
 bool IOMapSerialize::saveHouseItems()
 {
-	int64_t start = OTSYS_TIME();
-	Database* db = Database::getInstance();
-	std::ostringstream query;
-
-	//Start the transaction
-	DBTransaction transaction;
-	if (!transaction.begin()) {
-		return false;
-	}
-
-	//clear old tile data
-	if (!db->executeQuery("DELETE FROM `tile_store`")) {
-		return false;
-	}
+	std::vector<HouseSaveData> houses;
+	captureHouses(houses);
+	return writeHouseItems(*Database::getInstance(), houses);
+}
 
-	DBInsert stmt("INSERT INTO `tile_store` (`house_id`, `data`) VALUES ");
+void IOMapSerialize::captureHouses(std::vector<HouseSaveData>& houses)
+{
+	houses.reserve(houses.size() + g_game.map.houses.getHouses().size());
 
 	PropWriteStream stream;
 	for (const auto& it : g_game.map.houses.getHouses()) {
-		//save house items
 		House* house = it.second;
+
+		houses.emplace_back();
+		HouseSaveData& data = houses.back();
+		data.id = house->getId();
+		data.owner = house->getOwner();
+		data.paidUntil = house->getPaidUntil();
+		data.payRentWarnings = house->getPayRentWarnings();
+		data.name = house->getName();
+		data.townId = house->getTownId();
+		data.rent = house->getRent();
+		data.size = house->getTiles().size();
+		data.beds = house->getBedCount();
+
+		std::string listText;
+		if (house->getAccessList(GUEST_LIST, listText) && !listText.empty()) {
+			data.accessLists.emplace_back(GUEST_LIST, std::move(listText));
+			listText.clear();
+		}
+
+		if (house->getAccessList(SUBOWNER_LIST, listText) && !listText.empty()) {
+			data.accessLists.emplace_back(SUBOWNER_LIST, std::move(listText));
+			listText.clear();
+		}
+
+		for (Door* door : house->getDoors()) {
+			if (door->getAccessList(listText) && !listText.empty()) {
+				data.accessLists.emplace_back(door->getDoorId(), std::move(listText));
+				listText.clear();
+			}
+		}
+
+		// untouched houses keep their tile_store rows
+		if (!house->isDirty()) {
+			continue;
+		}
+
+		house->setDirty(false);
+		data.saveTiles = true;
 		for (HouseTile* tile : house->getTiles()) {
 			saveTile(stream, tile);
 
 			size_t attributesSize;
 			const char* attributes = stream.getStream(attributesSize);
 			if (attributesSize > 0) {
-				query << house->getId() << ',' << db->escapeBlob(attributes, attributesSize);
-				if (!stmt.addRow(query)) {
-					return false;
-				}
+				data.tiles.emplace_back(attributes, attributesSize);
 				stream.clear();
 			}
 		}
 	}
-
-	if (!stmt.execute()) {
-		return false;
-	}
-
-	//End the transaction
-	bool success = transaction.commit();
-	std::cout << "> Saved house items in: " <<
-	          (OTSYS_TIME() - start) / (1000.) << " s" << std::endl;
-	return success;
 }
 
-bool IOMapSerialize::loadContainer(PropStream& propStream, Container* container)
+bool IOMapSerialize::writeHouseItems(Database& db, const std::vector<HouseSaveData>& houses)
 {
-	while (container->serializationCount > 0) {
-		if (!loadItem(propStream, container)) {
-			std::cout << "[Warning - IOMapSerialize::loadContainer] Unserialization error for container item: " << container->getID() << std::endl;
-			return false;
+	std::ostringstream query;
+	for (const HouseSaveData& house : houses) {
+		if (house.saveTiles) {
+			query << (query.tellp() == 0 ? "DELETE FROM `tile_store` WHERE `house_id` IN (" : ",") << house.id;
 		}
-		container->serializationCount--;
 	}
 
-	uint8_t endAttr;
-	if (!propStream.read<uint8_t>(endAttr) || endAttr != 0) {
-		std::cout << "[Warning - IOMapSerialize::loadContainer] Unserialization error for container item: " << container->getID() << std::endl;
-		return false;
+	if (query.tellp() == 0) {
+		return true;
 	}
-	return true;
-}
+	query << ')';
 
-bool IOMapSerialize::loadItem(PropStream& propStream, Cylinder* parent)
-{
-	uint16_t id;
-	if (!propStream.read<uint16_t>(id)) {
+	//Start the transaction
+	DBTransaction transaction(&db);
+	if (!transaction.begin()) {
 		return false;
 	}
 
-	Tile* tile = nullptr;
-	if (parent->getParent() == nullptr) {
-		tile = parent->getTile();
+	//clear old tile data of the changed houses
+	if (!db.executeQuery(query.str())) {
+		return false;
 	}
 
-	const ItemType& iType = Item::items[id];
-	if (iType.moveable || !tile || iType.especialTileHouse) {
-		//create a new item
-		Item* item = Item::CreateItem(id);
-		if (item) {
-			if (item->unserializeAttr(propStream)) {
-				Container* container = item->getContainer();
-				if (container && !loadContainer(propStream, container)) {
-					delete item;
-					return false;
-				}
-
-				parent->internalAddThing(item);
-				item->startDecaying();
-			} else {
-				std::cout << "WARNING: Unserialization error in IOMapSerialize::loadItem()" << id << std::endl;
-				delete item;
+	query.str(std::string());
+
+	DBInsert stmt("INSERT INTO `tile_store` (`house_id`, `data`) VALUES ", &db);
+	for (const HouseSaveData& house : houses) {
+		for (const std::string& tile : house.tiles) {
+			query << house.id << ',' << db.escapeBlob(tile.data(), tile.size());
+			if (!stmt.addRow(query)) {
 				return false;
 			}
 		}
-	} else {
-		// Stationary items like doors/beds/blackboards/bookcases
-		Item* item = nullptr;
-		if (const TileItemVector* items = tile->getItemList()) {
-			for (Item* findItem : *items) {
-				if (findItem->getID() == id) {
-					item = findItem;
-					break;
-				} else if (iType.isDoor() && findItem->getDoor()) {
-					item = findItem;
-					break;
-				} else if (iType.isBed() && findItem->getBed()) {
-					item = findItem;
-					break;
-				}
-			}
-		}
-
-		if (item) {
-			if (item->unserializeAttr(propStream)) {
-				Container* container = item->getContainer();
-				if (container && !loadContainer(propStream, container)) {
-					return false;
-				}
+	}
 
-				g_game.transformItem(item, id);
-			} else {
-				std::cout << "WARNING: Unserialization error in IOMapSerialize::loadItem()" << id << std::endl;
-			}
-		} else {
-			//The map changed since the last save, just read the attributes
-			std::unique_ptr<Item> dummy(Item::CreateItem(id));
-			if (dummy) {
-				dummy->unserializeAttr(propStream);
-				Container* container = dummy->getContainer();
-				if (container) {
-					if (!loadContainer(propStream, container)) {
-						return false;
-					}
-				} else if (BedItem* bedItem = dynamic_cast<BedItem*>(dummy.get())) {
-					uint32_t sleeperGUID = bedItem->getSleeper();
-					if (sleeperGUID != 0) {
-						g_game.removeBedSleeper(sleeperGUID);
-					}
-				}
-			}
-		}
+	if (!stmt.execute()) {
+		return false;
 	}
-	return true;
+
+	//End the transaction
+	return transaction.commit();
 }
 
 void IOMapSerialize::saveItem(PropWriteStream& stream, const Item* item)
@@ -301,67 +261,46 @@ bool IOMapSerialize::loadHouseInfo()
 
 bool IOMapSerialize::saveHouseInfo()
 {
-	Database* db = Database::getInstance();
+	std::vector<HouseSaveData> houses;
+	captureHouses(houses);
+	return writeHouseInfo(*Database::getInstance(), houses);
+}
 
-	DBTransaction transaction;
+bool IOMapSerialize::writeHouseInfo(Database& db, const std::vector<HouseSaveData>& houses)
+{
+	DBTransaction transaction(&db);
 	if (!transaction.begin()) {
 		return false;
 	}
 
-	if (!db->executeQuery("DELETE FROM `house_lists`")) {
+	if (!db.executeQuery("DELETE FROM `house_lists`")) {
 		return false;
 	}
 
 	std::ostringstream query;
-	for (const auto& it : g_game.map.houses.getHouses()) {
-		House* house = it.second;
-		query << "SELECT `id` FROM `houses` WHERE `id` = " << house->getId();
-		DBResult_ptr result = db->storeQuery(query.str());
+	for (const HouseSaveData& house : houses) {
+		query << "SELECT `id` FROM `houses` WHERE `id` = " << house.id;
+		DBResult_ptr result = db.storeQuery(query.str());
 		if (result) {
 			query.str(std::string());
-			query << "UPDATE `houses` SET `owner` = " << house->getOwner() << ", `paid` = " << house->getPaidUntil() << ", `warnings` = " << house->getPayRentWarnings() << ", `name` = " << db->escapeString(house->getName()) << ", `town_id` = " << house->getTownId() << ", `rent` = " << house->getRent() << ", `size` = " << house->getTiles().size() << ", `beds` = " << house->getBedCount() << " WHERE `id` = " << house->getId();
+			query << "UPDATE `houses` SET `owner` = " << house.owner << ", `paid` = " << house.paidUntil << ", `warnings` = " << house.payRentWarnings << ", `name` = " << db.escapeString(house.name) << ", `town_id` = " << house.townId << ", `rent` = " << house.rent << ", `size` = " << house.size << ", `beds` = " << house.beds << " WHERE `id` = " << house.id;
 		} else {
 			query.str(std::string());
-			query << "INSERT INTO `houses` (`id`, `owner`, `paid`, `warnings`, `name`, `town_id`, `rent`, `size`, `beds`) VALUES (" << house->getId() << ',' << house->getOwner() << ',' << house->getPaidUntil() << ',' << house->getPayRentWarnings() << ',' << db->escapeString(house->getName()) << ',' << house->getTownId() << ',' << house->getRent() << ',' << house->getTiles().size() << ',' << house->getBedCount() << ')';
+			query << "INSERT INTO `houses` (`id`, `owner`, `paid`, `warnings`, `name`, `town_id`, `rent`, `size`, `beds`) VALUES (" << house.id << ',' << house.owner << ',' << house.paidUntil << ',' << house.payRentWarnings << ',' << db.escapeString(house.name) << ',' << house.townId << ',' << house.rent << ',' << house.size << ',' << house.beds << ')';
 		}
 
-		db->executeQuery(query.str());
+		db.executeQuery(query.str());
 		query.str(std::string());
 	}
 
-	DBInsert stmt("INSERT INTO `house_lists` (`house_id` , `listid` , `list`) VALUES ");
+	DBInsert stmt("INSERT INTO `house_lists` (`house_id` , `listid` , `list`) VALUES ", &db);
 
-	for (const auto& it : g_game.map.houses.getHouses()) {
-		House* house = it.second;
-
-		std::string listText;
-		if (house->getAccessList(GUEST_LIST, listText) && !listText.empty()) {
-			query << house->getId() << ',' << GUEST_LIST << ',' << db->escapeString(listText);
-			if (!stmt.addRow(query)) {
-				return false;
-			}
-
-			listText.clear();
-		}
-
-		if (house->getAccessList(SUBOWNER_LIST, listText) && !listText.empty()) {
-			query << house->getId() << ',' << SUBOWNER_LIST << ',' << db->escapeString(listText);
+	for (const HouseSaveData& house : houses) {
+		for (const auto& accessList : house.accessLists) {
+			query << house.id << ',' << accessList.first << ',' << db.escapeString(accessList.second);
 			if (!stmt.addRow(query)) {
 				return false;
 			}
-
-			listText.clear();
-		}
-
-		for (Door* door : house->getDoors()) {
-			if (door->getAccessList(listText) && !listText.empty()) {
-				query << house->getId() << ',' << door->getDoorId() << ',' << db->escapeString(listText);
-				if (!stmt.addRow(query)) {
-					return false;
-				}
-
-				listText.clear();
-			}
 		}
 	}
 
@@ -23,6 +23,24 @@
 #include "database.h"
 #include "map.h"
 
+// what saveHouseInfo and saveHouseItems write for one house
+struct HouseSaveData {
+	uint32_t id;
+	uint32_t owner;
+	time_t paidUntil;
+	uint32_t payRentWarnings;
+	std::string name;
+	uint32_t townId;
+	uint32_t rent;
+	size_t size;
+	uint32_t beds;
+
+	std::vector<std::pair<uint32_t, std::string>> accessLists;
+	// one serialised tile each, see saveTile, only captured for dirty houses
+	std::vector<std::string> tiles;
+	bool saveTiles = false;
+};
+
 class IOMapSerialize
 {
 	public:
@@ -31,6 +49,10 @@ class IOMapSerialize
 		static bool loadHouseInfo();
 		static bool saveHouseInfo();
 
+		static void captureHouses(std::vector<HouseSaveData>& houses);
+		static bool writeHouseInfo(Database& db, const std::vector<HouseSaveData>& houses);
+		static bool writeHouseItems(Database& db, const std::vector<HouseSaveData>& houses);
+
 	protected:
 		static void saveItem(PropWriteStream& stream, const Item* item);
 		static void saveTile(PropWriteStream& stream, const Tile* tile);
@@ -34,10 +34,11 @@ MarketOfferList IOMarket::getActiveOffers(MarketAction_t action, uint16_t itemId
 {
 	MarketOfferList offerList;
 
-	std::ostringstream query;
-	query << "SELECT `id`, `amount`, `price`, `created`, `anonymous`, (SELECT `name` FROM `players` WHERE `id` = `player_id`) AS `player_name` FROM `market_offers` WHERE `sale` = " << action << " AND `itemtype` = " << itemId;
+	DBStatement* statement = Database::getInstance()->prepare("SELECT `id`, `amount`, `price`, `created`, `anonymous`, (SELECT `name` FROM `players` WHERE `id` = `player_id`) FROM `market_offers` WHERE `sale` = ? AND `itemtype` = ?");
+	statement->bind(0, action);
+	statement->bind(1, itemId);
 
-	DBResult_ptr result = Database::getInstance()->storeQuery(query.str());
+	DBStatementResult_ptr result = statement->storeQuery();
 	if (!result) {
 		return offerList;
 	}
@@ -46,12 +47,12 @@ MarketOfferList IOMarket::getActiveOffers(MarketAction_t action, uint16_t itemId
 
 	do {
 		MarketOffer offer;
-		offer.amount = result->getNumber<uint16_t>("amount");
-		offer.price = result->getNumber<uint32_t>("price");
-		offer.timestamp = result->getNumber<uint32_t>("created") + marketOfferDuration;
-		offer.counter = result->getNumber<uint32_t>("id") & 0xFFFF;
-		if (result->getNumber<uint16_t>("anonymous") == 0) {
-			offer.playerName = result->getString("player_name");
+		offer.amount = result->getNumber<uint16_t>(1);
+		offer.price = result->getNumber<uint32_t>(2);
+		offer.timestamp = result->getNumber<uint32_t>(3) + marketOfferDuration;
+		offer.counter = result->getNumber<uint32_t>(0) & 0xFFFF;
+		if (result->getNumber<uint16_t>(4) == 0) {
+			offer.playerName = result->getString(5);
 		} else {
 			offer.playerName = "Anonymous";
 		}
@@ -66,21 +67,22 @@ MarketOfferList IOMarket::getOwnOffers(MarketAction_t action, uint32_t playerId)
 
 	const int32_t marketOfferDuration = g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
 
-	std::ostringstream query;
-	query << "SELECT `id`, `amount`, `price`, `created`, `itemtype` FROM `market_offers` WHERE `player_id` = " << playerId << " AND `sale` = " << action;
+	DBStatement* statement = Database::getInstance()->prepare("SELECT `id`, `amount`, `price`, `created`, `itemtype` FROM `market_offers` WHERE `player_id` = ? AND `sale` = ?");
+	statement->bind(0, playerId);
+	statement->bind(1, action);
 
-	DBResult_ptr result = Database::getInstance()->storeQuery(query.str());
+	DBStatementResult_ptr result = statement->storeQuery();
 	if (!result) {
 		return offerList;
 	}
 
 	do {
 		MarketOffer offer;
-		offer.amount = result->getNumber<uint16_t>("amount");
-		offer.price = result->getNumber<uint32_t>("price");
-		offer.timestamp = result->getNumber<uint32_t>("created") + marketOfferDuration;
-		offer.counter = result->getNumber<uint32_t>("id") & 0xFFFF;
-		offer.itemId = result->getNumber<uint16_t>("itemtype");
+		offer.amount = result->getNumber<uint16_t>(1);
+		offer.price = result->getNumber<uint32_t>(2);
+		offer.timestamp = result->getNumber<uint32_t>(3) + marketOfferDuration;
+		offer.counter = result->getNumber<uint32_t>(0) & 0xFFFF;
+		offer.itemId = result->getNumber<uint16_t>(4);
 		offerList.push_back(offer);
 	} while (result->next());
 	return offerList;
@@ -90,22 +92,23 @@ HistoryMarketOfferList IOMarket::getOwnHistory(MarketAction_t action, uint32_t p
 {
 	HistoryMarketOfferList offerList;
 
-	std::ostringstream query;
-	query << "SELECT `itemtype`, `amount`, `price`, `expires_at`, `state` FROM `market_history` WHERE `player_id` = " << playerId << " AND `sale` = " << action;
+	DBStatement* statement = Database::getInstance()->prepare("SELECT `itemtype`, `amount`, `price`, `expires_at`, `state` FROM `market_history` WHERE `player_id` = ? AND `sale` = ?");
+	statement->bind(0, playerId);
+	statement->bind(1, action);
 
-	DBResult_ptr result = Database::getInstance()->storeQuery(query.str());
+	DBStatementResult_ptr result = statement->storeQuery();
 	if (!result) {
 		return offerList;
 	}
 
 	do {
 		HistoryMarketOffer offer;
-		offer.itemId = result->getNumber<uint16_t>("itemtype");
-		offer.amount = result->getNumber<uint16_t>("amount");
-		offer.price = result->getNumber<uint32_t>("price");
-		offer.timestamp = result->getNumber<uint32_t>("expires_at");
+		offer.itemId = result->getNumber<uint16_t>(0);
+		offer.amount = result->getNumber<uint16_t>(1);
+		offer.price = result->getNumber<uint32_t>(2);
+		offer.timestamp = result->getNumber<uint32_t>(3);
 
-		MarketOfferState_t offerState = static_cast<MarketOfferState_t>(result->getNumber<uint16_t>("state"));
+		MarketOfferState_t offerState = static_cast<MarketOfferState_t>(result->getNumber<uint16_t>(4));
 		if (offerState == OFFERSTATE_ACCEPTEDEX) {
 			offerState = OFFERSTATE_ACCEPTED;
 		}
@@ -209,14 +212,14 @@ void IOMarket::checkExpiredOffers()
 
 uint32_t IOMarket::getPlayerOfferCount(uint32_t playerId)
 {
-	std::ostringstream query;
-	query << "SELECT COUNT(*) AS `count` FROM `market_offers` WHERE `player_id` = " << playerId;
+	DBStatement* statement = Database::getInstance()->prepare("SELECT COUNT(*) FROM `market_offers` WHERE `player_id` = ?");
+	statement->bind(0, playerId);
 
-	DBResult_ptr result = Database::getInstance()->storeQuery(query.str());
+	DBStatementResult_ptr result = statement->storeQuery();
 	if (!result) {
 		return 0;
 	}
-	return result->getNumber<int32_t>("count");
+	return result->getNumber<int32_t>(0);
 }
 
 MarketOfferEx IOMarket::getOfferByCounter(uint32_t timestamp, uint16_t counter)
@@ -225,25 +228,26 @@ MarketOfferEx IOMarket::getOfferByCounter(uint32_t timestamp, uint16_t counter)
 
 	const int32_t created = timestamp - g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
 
-	std::ostringstream query;
-	query << "SELECT `id`, `sale`, `itemtype`, `amount`, `created`, `price`, `player_id`, `anonymous`, (SELECT `name` FROM `players` WHERE `id` = `player_id`) AS `player_name` FROM `market_offers` WHERE `created` = " << created << " AND (`id` & 65535) = " << counter << " LIMIT 1";
+	DBStatement* statement = Database::getInstance()->prepare("SELECT `id`, `sale`, `itemtype`, `amount`, `created`, `price`, `player_id`, `anonymous`, (SELECT `name` FROM `players` WHERE `id` = `player_id`) FROM `market_offers` WHERE `created` = ? AND (`id` & 65535) = ? LIMIT 1");
+	statement->bind(0, created);
+	statement->bind(1, counter);
 
-	DBResult_ptr result = Database::getInstance()->storeQuery(query.str());
+	DBStatementResult_ptr result = statement->storeQuery();
 	if (!result) {
 		offer.id = 0;
 		return offer;
 	}
 
-	offer.id = result->getNumber<uint32_t>("id");
-	offer.type = static_cast<MarketAction_t>(result->getNumber<uint16_t>("sale"));
-	offer.amount = result->getNumber<uint16_t>("amount");
-	offer.counter = result->getNumber<uint32_t>("id") & 0xFFFF;
-	offer.timestamp = result->getNumber<uint32_t>("created");
-	offer.price = result->getNumber<uint32_t>("price");
-	offer.itemId = result->getNumber<uint16_t>("itemtype");
-	offer.playerId = result->getNumber<uint32_t>("player_id");
-	if (result->getNumber<uint16_t>("anonymous") == 0) {
-		offer.playerName = result->getString("player_name");
+	offer.id = result->getNumber<uint32_t>(0);
+	offer.type = static_cast<MarketAction_t>(result->getNumber<uint16_t>(1));
+	offer.amount = result->getNumber<uint16_t>(3);
+	offer.counter = offer.id & 0xFFFF;
+	offer.timestamp = result->getNumber<uint32_t>(4);
+	offer.price = result->getNumber<uint32_t>(5);
+	offer.itemId = result->getNumber<uint16_t>(2);
+	offer.playerId = result->getNumber<uint32_t>(6);
+	if (result->getNumber<uint16_t>(7) == 0) {
+		offer.playerName = result->getString(8);
 	} else {
 		offer.playerName = "Anonymous";
 	}
@@ -252,23 +256,30 @@ MarketOfferEx IOMarket::getOfferByCounter(uint32_t timestamp, uint16_t counter)
 
 void IOMarket::createOffer(uint32_t playerId, MarketAction_t action, uint32_t itemId, uint16_t amount, uint32_t price, bool anonymous)
 {
-	std::ostringstream query;
-	query << "INSERT INTO `market_offers` (`player_id`, `sale`, `itemtype`, `amount`, `price`, `created`, `anonymous`) VALUES (" << playerId << ',' << action << ',' << itemId << ',' << amount << ',' << price << ',' << time(nullptr) << ',' << anonymous << ')';
-	Database::getInstance()->executeQuery(query.str());
+	DBStatement* statement = Database::getInstance()->prepare("INSERT INTO `market_offers` (`player_id`, `sale`, `itemtype`, `amount`, `price`, `created`, `anonymous`) VALUES (?, ?, ?, ?, ?, ?, ?)");
+	statement->bind(0, playerId);
+	statement->bind(1, action);
+	statement->bind(2, itemId);
+	statement->bind(3, amount);
+	statement->bind(4, price);
+	statement->bind(5, time(nullptr));
+	statement->bind(6, anonymous);
+	statement->executeQuery();
 }
 
 void IOMarket::acceptOffer(uint32_t offerId, uint16_t amount)
 {
-	std::ostringstream query;
-	query << "UPDATE `market_offers` SET `amount` = `amount` - " << amount << " WHERE `id` = " << offerId;
-	Database::getInstance()->executeQuery(query.str());
+	DBStatement* statement = Database::getInstance()->prepare("UPDATE `market_offers` SET `amount` = `amount` - ? WHERE `id` = ?");
+	statement->bind(0, amount);
+	statement->bind(1, offerId);
+	statement->executeQuery();
 }
 
 void IOMarket::deleteOffer(uint32_t offerId)
 {
-	std::ostringstream query;
-	query << "DELETE FROM `market_offers` WHERE `id` = " << offerId;
-	Database::getInstance()->executeQuery(query.str());
+	DBStatement* statement = Database::getInstance()->prepare("DELETE FROM `market_offers` WHERE `id` = ?");
+	statement->bind(0, offerId);
+	statement->executeQuery();
 }
 
 void IOMarket::appendHistory(uint32_t playerId, MarketAction_t type, uint16_t itemId, uint16_t amount, uint32_t price, time_t timestamp, MarketOfferState_t state)
@@ -277,7 +288,7 @@ void IOMarket::appendHistory(uint32_t playerId, MarketAction_t type, uint16_t it
 	query << "INSERT INTO `market_history` (`player_id`, `sale`, `itemtype`, `amount`, `price`, `expires_at`, `inserted`, `state`) VALUES ("
 		<< playerId << ',' << type << ',' << itemId << ',' << amount << ',' << price << ','
 		<< timestamp << ',' << time(nullptr) << ',' << state << ')';
-	g_databaseTasks.addTask(query.str());
+	g_databaseTasks.addTask(query.str(), nullptr, false, playerId);
 }
 
 bool IOMarket::moveOfferToHistory(uint32_t offerId, MarketOfferState_t state)
@@ -286,45 +297,46 @@ bool IOMarket::moveOfferToHistory(uint32_t offerId, MarketOfferState_t state)
 
 	Database* db = Database::getInstance();
 
-	std::ostringstream query;
-	query << "SELECT `player_id`, `sale`, `itemtype`, `amount`, `price`, `created` FROM `market_offers` WHERE `id` = " << offerId;
+	DBStatement* statement = db->prepare("SELECT `player_id`, `sale`, `itemtype`, `amount`, `price`, `created` FROM `market_offers` WHERE `id` = ?");
+	statement->bind(0, offerId);
 
-	DBResult_ptr result = db->storeQuery(query.str());
+	DBStatementResult_ptr result = statement->storeQuery();
 	if (!result) {
 		return false;
 	}
 
-	query.str(std::string());
-	query << "DELETE FROM `market_offers` WHERE `id` = " << offerId;
-	if (!db->executeQuery(query.str())) {
+	statement = db->prepare("DELETE FROM `market_offers` WHERE `id` = ?");
+	statement->bind(0, offerId);
+	if (!statement->executeQuery()) {
 		return false;
 	}
 
-	appendHistory(result->getNumber<uint32_t>("player_id"), static_cast<MarketAction_t>(result->getNumber<uint16_t>("sale")), result->getNumber<uint16_t>("itemtype"), result->getNumber<uint16_t>("amount"), result->getNumber<uint32_t>("price"), result->getNumber<uint32_t>("created") + marketOfferDuration, state);
+	appendHistory(result->getNumber<uint32_t>(0), static_cast<MarketAction_t>(result->getNumber<uint16_t>(1)), result->getNumber<uint16_t>(2), result->getNumber<uint16_t>(3), result->getNumber<uint32_t>(4), result->getNumber<uint32_t>(5) + marketOfferDuration, state);
 	return true;
 }
 
 void IOMarket::updateStatistics()
 {
-	std::ostringstream query;
-	query << "SELECT `sale` AS `sale`, `itemtype` AS `itemtype`, COUNT(`price`) AS `num`, MIN(`price`) AS `min`, MAX(`price`) AS `max`, SUM(`price`) AS `sum` FROM `market_history` WHERE `state` = " << OFFERSTATE_ACCEPTED << " GROUP BY `itemtype`, `sale`";
-	DBResult_ptr result = Database::getInstance()->storeQuery(query.str());
+	DBStatement* statement = Database::getInstance()->prepare("SELECT `sale`, `itemtype`, COUNT(`price`), MIN(`price`), MAX(`price`), SUM(`price`) FROM `market_history` WHERE `state` = ? GROUP BY `itemtype`, `sale`");
+	statement->bind(0, OFFERSTATE_ACCEPTED);
+
+	DBStatementResult_ptr result = statement->storeQuery();
 	if (!result) {
 		return;
 	}
 
 	do {
 		MarketStatistics* statistics;
-		if (result->getNumber<uint16_t>("sale") == MARKETACTION_BUY) {
-			statistics = &purchaseStatistics[result->getNumber<uint16_t>("itemtype")];
+		if (result->getNumber<uint16_t>(0) == MARKETACTION_BUY) {
+			statistics = &purchaseStatistics[result->getNumber<uint16_t>(1)];
 		} else {
-			statistics = &saleStatistics[result->getNumber<uint16_t>("itemtype")];
+			statistics = &saleStatistics[result->getNumber<uint16_t>(1)];
 		}
 
-		statistics->numTransactions = result->getNumber<uint32_t>("num");
-		statistics->lowestPrice = result->getNumber<uint32_t>("min");
-		statistics->totalPrice = result->getNumber<uint64_t>("sum");
-		statistics->highestPrice = result->getNumber<uint32_t>("max");
+		statistics->numTransactions = result->getNumber<uint32_t>(2);
+		statistics->lowestPrice = result->getNumber<uint32_t>(3);
+		statistics->totalPrice = result->getNumber<uint64_t>(5);
+		statistics->highestPrice = result->getNumber<uint32_t>(4);
 	} while (result->next());
 }
 
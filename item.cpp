@@ -1770,6 +1770,12 @@ void Item::setUniqueId(uint16_t n)
 	}
 }
 
+void Item::setDuration(int32_t time)
+{
+	setIntAttr(ITEM_ATTRIBUTE_DURATION, time);
+	HouseTile::setHouseDirty(this);
+}
+
 bool Item::canDecay() const
 {
 	if (isRemoved()) {
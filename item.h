@@ -501,9 +501,7 @@ class Item : virtual public Thing
 			return getIntAttr(ITEM_ATTRIBUTE_CORPSEOWNER);
 		}
 
-		void setDuration(int32_t time) {
-			setIntAttr(ITEM_ATTRIBUTE_DURATION, time);
-		}
+		void setDuration(int32_t time);
 		void decreaseDuration(int32_t time) {
 			increaseIntAttr(ITEM_ATTRIBUTE_DURATION, -time);
 		}
@@ -0,0 +1,901 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2015  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+// Headless bot clients for load tests. Every bot logs in through the login
+// protocol, enters the game with the character list entry it got back and
+// then walks, talks, attacks and uses items at a fixed pace. Round trips are
+// measured by following each action with a say carrying a unique token and
+// waiting for the server to echo it back, so the latency covers the network
+// threads, the dispatcher and the autosend of the reply.
+
+#include "otpch.h"
+
+#include <deque>
+#include <random>
+
+#include <gmp.h>
+
+#include "const.h"
+#include "enums.h"
+#include "xtea.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// modulus of the key set up in otserv.cpp
+const char* DEFAULT_RSA_MODULUS = "109120132967399429278860960508995541528237502902798129123468757937266291492576446330739696001110603907230888610072655818825358503429057592827629436413108566029093628212635953836686562675849720620786279431090218017681061521755056710823876476444260558147179707119674283982419152118103759076030616683978566631413";
+
+struct Options {
+	std::string host = "127.0.0.1";
+	uint16_t loginPort = 7171;
+	std::string accountPrefix = "bot";
+	std::string password = "bot";
+	uint32_t firstAccount = 0;
+	uint32_t botCount = 10;
+	uint32_t duration = 60;
+	uint32_t actionInterval = 500;
+	uint32_t rampInterval = 20;
+	uint16_t version = CLIENT_VERSION_MIN;
+	std::string rsaModulus = DEFAULT_RSA_MODULUS;
+};
+
+enum ActionType {
+	ACTION_WALK,
+	ACTION_SAY,
+	ACTION_ATTACK,
+	ACTION_USEITEM,
+	ACTION_LAST = ACTION_USEITEM
+};
+
+const char* actionNames[] = {"walk", "say", "attack", "use item"};
+
+class LatencyStats
+{
+	public:
+		void add(Clock::duration latency) {
+			samples.push_back(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+		}
+
+		size_t size() const {
+			return samples.size();
+		}
+
+		void clear() {
+			samples.clear();
+		}
+
+		// percentile in milliseconds, p in [0, 1]
+		double percentile(double p) {
+			if (samples.empty()) {
+				return 0;
+			}
+
+			size_t index = std::min<size_t>(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+			std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+			return samples[index] / 1000.;
+		}
+
+		void print(const char* name) {
+			std::cout << std::left << std::setw(12) << name << std::right << std::setw(9) << samples.size();
+			if (!samples.empty()) {
+				std::cout << std::fixed << std::setprecision(2)
+				          << std::setw(10) << percentile(0.5) << std::setw(10) << percentile(0.9)
+				          << std::setw(10) << percentile(0.99) << std::setw(10) << percentile(1.0);
+			}
+			std::cout << std::endl;
+		}
+
+	private:
+		std::vector<int64_t> samples;
+};
+
+struct LoadStats {
+	LatencyStats connect;
+	LatencyStats login;
+	LatencyStats actions[ACTION_LAST + 1];
+	LatencyStats interval;
+
+	uint32_t online = 0;
+	uint32_t loginFailures = 0;
+	uint32_t disconnects = 0;
+	uint32_t timeouts = 0;
+	uint64_t bytesReceived = 0;
+
+	// creature ids of the bots in game, used as attack targets
+	std::vector<uint32_t> creatureIds;
+};
+
+uint32_t adlerChecksum(const uint8_t* data, size_t length)
+{
+	const uint16_t adler = 65521;
+
+	uint32_t a = 1, b = 0;
+	while (length > 0) {
+		size_t tmp = length > 5552 ? 5552 : length;
+		length -= tmp;
+
+		do {
+			a += *data++;
+			b += a;
+		} while (--tmp);
+
+		a %= adler;
+		b %= adler;
+	}
+
+	return (b << 16) | a;
+}
+
+// Outgoing client packet, framed like the client does it: length, checksum
+// and, once the session key is known, the XTEA encrypted body.
+class ClientMessage
+{
+	public:
+		void addByte(uint8_t value) {
+			body.push_back(value);
+		}
+
+		template<typename T>
+		void add(T value) {
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+			body.insert(body.end(), bytes, bytes + sizeof(T));
+		}
+
+		void addString(const std::string& value) {
+			add<uint16_t>(value.size());
+			body.insert(body.end(), value.begin(), value.end());
+		}
+
+		void addBytes(const uint8_t* bytes, size_t size) {
+			body.insert(body.end(), bytes, bytes + size);
+		}
+
+		size_t size() const {
+			return body.size();
+		}
+
+		std::vector<uint8_t> finish(const uint32_t* key) const {
+			std::vector<uint8_t> data;
+			if (key) {
+				data.resize(2);
+				data[0] = body.size() & 0xFF;
+				data[1] = body.size() >> 8;
+				data.insert(data.end(), body.begin(), body.end());
+				data.resize((data.size() + 7) & ~7);
+				xteaEncrypt(data.data(), data.size(), key);
+			} else {
+				data = body;
+			}
+
+			std::vector<uint8_t> packet(6 + data.size());
+			uint16_t length = data.size() + 4;
+			uint32_t checksum = adlerChecksum(data.data(), data.size());
+			memcpy(packet.data(), &length, 2);
+			memcpy(packet.data() + 2, &checksum, 4);
+			std::copy(data.begin(), data.end(), packet.begin() + 6);
+			return packet;
+		}
+
+	private:
+		std::vector<uint8_t> body;
+};
+
+// Cursor over a decrypted server message.
+class ServerMessage
+{
+	public:
+		ServerMessage(const uint8_t* data, size_t length) : data(data), length(length), position(0) {}
+
+		bool canRead(size_t size) const {
+			return position + size <= length;
+		}
+
+		uint8_t getByte() {
+			return canRead(1) ? data[position++] : 0;
+		}
+
+		template<typename T>
+		T get() {
+			T value = T();
+			if (canRead(sizeof(T))) {
+				memcpy(&value, data + position, sizeof(T));
+				position += sizeof(T);
+			}
+			return value;
+		}
+
+		std::string getString() {
+			uint16_t size = get<uint16_t>();
+			if (!canRead(size)) {
+				position = length;
+				return std::string();
+			}
+
+			std::string value(reinterpret_cast<const char*>(data + position), size);
+			position += size;
+			return value;
+		}
+
+	private:
+		const uint8_t* data;
+		size_t length;
+		size_t position;
+};
+
+class Bot : public std::enable_shared_from_this<Bot>
+{
+	public:
+		Bot(boost::asio::io_service& io_service, const Options& options, LoadStats& stats, uint32_t index) :
+			options(options), stats(stats), socket(io_service), actionTimer(io_service),
+			resolver(io_service), rng(index), index(index) {}
+
+		// non-copyable
+		Bot(const Bot&) = delete;
+		Bot& operator=(const Bot&) = delete;
+
+		void start() {
+			state = STATE_LOGIN;
+			connect(options.host, options.loginPort);
+		}
+
+		void stop() {
+			stopping = true;
+			actionTimer.cancel();
+			if (state == STATE_GAME) {
+				ClientMessage msg;
+				msg.addByte(0x14); // logout
+				send(msg);
+			} else {
+				close();
+			}
+		}
+
+	private:
+		enum State {
+			STATE_LOGIN,
+			STATE_CHALLENGE,
+			STATE_ENTERING,
+			STATE_GAME,
+			STATE_CLOSED,
+		};
+
+		void connect(const std::string& host, uint16_t port) {
+			boost::asio::ip::tcp::resolver::query query(host, std::to_string(port));
+			boost::system::error_code error;
+			auto endpoint = resolver.resolve(query, error);
+			if (error) {
+				fail("resolve: " + error.message());
+				return;
+			}
+
+			connectStart = Clock::now();
+			boost::asio::async_connect(socket, endpoint,
+			                           std::bind(&Bot::onConnect, shared_from_this(), std::placeholders::_1));
+		}
+
+		void onConnect(const boost::system::error_code& error) {
+			if (error) {
+				fail("connect: " + error.message());
+				return;
+			}
+
+			stats.connect.add(Clock::now() - connectStart);
+			socket.set_option(boost::asio::ip::tcp::no_delay(true));
+
+			if (state == STATE_LOGIN) {
+				loginStart = Clock::now();
+				sendLogin();
+			}
+			readHeader();
+		}
+
+		void sendLogin() {
+			generateKey();
+
+			ClientMessage msg;
+			msg.addByte(0x01); // protocol id
+			msg.add<uint16_t>(CLIENTOS_WINDOWS);
+			msg.add<uint16_t>(options.version);
+			msg.add<uint32_t>(options.version); // protocol version
+			for (int i = 0; i < 13; ++i) {
+				msg.addByte(0); // dat, spr, pic signatures, preview state
+			}
+
+			ClientMessage block;
+			block.addByte(0);
+			block.addBytes(reinterpret_cast<const uint8_t*>(key), sizeof(key));
+			block.addString(accountName());
+			block.addString(options.password);
+			addRSABlock(msg, block);
+
+			ClientMessage tokenBlock;
+			tokenBlock.addByte(0);
+			tokenBlock.addString(std::string()); // authenticator token
+			tokenBlock.addByte(0); // stay logged in
+			addRSABlock(msg, tokenBlock);
+
+			send(msg, false);
+		}
+
+		void sendGameLogin(uint32_t timestamp, uint8_t random) {
+			ClientMessage msg;
+			msg.addByte(0x0A); // protocol id
+			msg.add<uint16_t>(CLIENTOS_WINDOWS);
+			msg.add<uint16_t>(options.version);
+			msg.add<uint32_t>(options.version); // client version
+			msg.addByte(0); // client type
+			msg.add<uint16_t>(0); // dat revision
+
+			ClientMessage block;
+			block.addByte(0);
+			block.addBytes(reinterpret_cast<const uint8_t*>(key), sizeof(key));
+			block.addByte(0); // gamemaster flag
+			block.addString(accountName() + '\n' + options.password);
+			block.addString(characterName);
+			block.add<uint32_t>(timestamp);
+			block.addByte(random);
+			addRSABlock(msg, block);
+
+			send(msg, false);
+			state = STATE_ENTERING;
+		}
+
+		void addRSABlock(ClientMessage& msg, ClientMessage& block) {
+			std::vector<uint8_t> plain = block.finish(nullptr);
+			plain.erase(plain.begin(), plain.begin() + 6);
+			while (plain.size() < 128) {
+				plain.push_back(rng());
+			}
+
+			mpz_t m, n;
+			mpz_init(m);
+			mpz_init(n);
+			mpz_set_str(n, options.rsaModulus.c_str(), 10);
+			mpz_import(m, 128, 1, 1, 0, 0, plain.data());
+
+			// c = m^e mod n
+			mpz_powm_ui(m, m, 65537, n);
+
+			uint8_t encrypted[128] = {};
+			size_t count = (mpz_sizeinbase(m, 2) + 7) / 8;
+			mpz_export(encrypted + (128 - count), nullptr, 1, 1, 0, 0, m);
+			msg.addBytes(encrypted, sizeof(encrypted));
+
+			mpz_clear(m);
+			mpz_clear(n);
+		}
+
+		void readHeader() {
+			boost::asio::async_read(socket, boost::asio::buffer(input, 2),
+			                        std::bind(&Bot::onReadHeader, shared_from_this(), std::placeholders::_1));
+		}
+
+		void onReadHeader(const boost::system::error_code& error) {
+			if (error) {
+				onReadError(error);
+				return;
+			}
+
+			uint16_t length;
+			memcpy(&length, input, 2);
+			if (length == 0 || length > sizeof(input)) {
+				fail("bad message length");
+				return;
+			}
+
+			boost::asio::async_read(socket, boost::asio::buffer(input, length),
+			                        std::bind(&Bot::onReadBody, shared_from_this(), std::placeholders::_1, length));
+		}
+
+		void onReadBody(const boost::system::error_code& error, uint16_t length) {
+			if (error) {
+				onReadError(error);
+				return;
+			}
+
+			stats.bytesReceived += length + 2;
+
+			if (state == STATE_CHALLENGE) {
+				// checksum, inner length, 0x1F, timestamp, random number
+				if (length < 12 || input[6] != 0x1F) {
+					fail("unexpected challenge");
+					return;
+				}
+
+				uint32_t timestamp;
+				memcpy(&timestamp, input + 7, 4);
+				sendGameLogin(timestamp, input[11]);
+				readHeader();
+				return;
+			}
+
+			// checksum followed by whole XTEA blocks
+			if (length < 12 || ((length - 4) & 7) != 0) {
+				fail("bad encrypted message");
+				return;
+			}
+
+			uint8_t* data = input + 4;
+			xteaDecrypt(data, length - 4, key);
+
+			uint16_t innerLength;
+			memcpy(&innerLength, data, 2);
+			if (innerLength > length - 6) {
+				fail("bad inner length");
+				return;
+			}
+
+			ServerMessage msg(data + 2, innerLength);
+			if (state == STATE_LOGIN) {
+				parseCharacterList(msg);
+				return;
+			}
+
+			if (state == STATE_ENTERING) {
+				parseEnterGame(msg);
+			} else {
+				checkProbe(data + 2, innerLength);
+			}
+
+			if (state != STATE_CLOSED) {
+				readHeader();
+			}
+		}
+
+		void onReadError(const boost::system::error_code& error) {
+			if (state == STATE_LOGIN && error == boost::asio::error::eof) {
+				fail("login server closed without a character list");
+			} else if (stopping) {
+				close();
+			} else if (state == STATE_GAME) {
+				++stats.disconnects;
+				std::cout << accountName() << ": disconnected (" << error.message() << ")" << std::endl;
+				close();
+			} else {
+				fail(error.message());
+			}
+		}
+
+		void parseCharacterList(ServerMessage& msg) {
+			std::string gameHost;
+			uint16_t gamePort = 0;
+
+			while (msg.canRead(1)) {
+				uint8_t opcode = msg.getByte();
+				switch (opcode) {
+					case 0x0B:
+						fail(msg.getString());
+						return;
+
+					case 0x0C:
+					case 0x0D:
+						msg.getByte();
+						break;
+
+					case 0x14:
+					case 0x28:
+						msg.getString();
+						break;
+
+					case 0x64: {
+						uint8_t worlds = msg.getByte();
+						for (uint8_t i = 0; i < worlds; ++i) {
+							msg.getByte(); // world id
+							msg.getString(); // name
+							gameHost = msg.getString();
+							gamePort = msg.get<uint16_t>();
+							msg.getByte(); // preview
+						}
+
+						uint8_t characters = msg.getByte();
+						if (characters != 0) {
+							msg.getByte(); // world id
+							characterName = msg.getString();
+						}
+
+						// the rest are premium flags
+						msg = ServerMessage(nullptr, 0);
+						break;
+					}
+
+					default:
+						fail("unknown login opcode");
+						return;
+				}
+			}
+
+			if (characterName.empty()) {
+				fail("no character on account");
+				return;
+			}
+
+			// connect where the server says it is unless it is not reachable
+			// from here (0.0.0.0, the public address of a NAT, ...)
+			boost::system::error_code error;
+			socket.close(error);
+			state = STATE_CHALLENGE;
+			connect(options.host, gamePort);
+			(void)gameHost;
+		}
+
+		void parseEnterGame(ServerMessage& msg) {
+			uint8_t opcode = msg.getByte();
+			if (opcode == 0x14 || opcode == 0x16) {
+				// disconnect reason or waiting list
+				fail(msg.getString());
+				return;
+			}
+
+			if (opcode != 0x17) {
+				return;
+			}
+
+			creatureId = msg.get<uint32_t>();
+			stats.login.add(Clock::now() - loginStart);
+			stats.creatureIds.push_back(creatureId);
+			++stats.online;
+			state = STATE_GAME;
+			lastPing = Clock::now();
+			scheduleAction();
+		}
+
+		void scheduleAction() {
+			std::uniform_int_distribution<uint32_t> jitter(options.actionInterval / 2, options.actionInterval * 3 / 2);
+			actionTimer.expires_from_now(std::chrono::milliseconds(jitter(rng)));
+			actionTimer.async_wait(std::bind(&Bot::onActionTimer, shared_from_this(), std::placeholders::_1));
+		}
+
+		void onActionTimer(const boost::system::error_code& error) {
+			if (error || state != STATE_GAME || stopping) {
+				return;
+			}
+
+			const auto now = Clock::now();
+			if (now - lastPing >= std::chrono::seconds(5)) {
+				// keeps the server from dropping us for not answering its pings
+				ClientMessage ping;
+				ping.addByte(0x1E);
+				send(ping);
+				lastPing = now;
+			}
+
+			if (!probeToken.empty()) {
+				if (now - probeStart < std::chrono::seconds(10)) {
+					scheduleAction();
+					return;
+				}
+
+				++stats.timeouts;
+				probeToken.clear();
+			}
+
+			static const uint32_t weights[] = {50, 20, 15, 15};
+			std::discrete_distribution<uint32_t> pick(std::begin(weights), std::end(weights));
+			probeAction = static_cast<ActionType>(pick(rng));
+
+			ClientMessage msg;
+			switch (probeAction) {
+				case ACTION_WALK:
+					msg.addByte(0x65 + rng() % 4);
+					break;
+
+				case ACTION_ATTACK: {
+					uint32_t target = stats.creatureIds[rng() % stats.creatureIds.size()];
+					msg.addByte(0xA1);
+					msg.add<uint32_t>(target);
+					msg.add<uint32_t>(target);
+					break;
+				}
+
+				case ACTION_USEITEM:
+					// the backpack slot, toggles the container window
+					msg.addByte(0x82);
+					msg.add<uint16_t>(0xFFFF);
+					msg.add<uint16_t>(3); // CONST_SLOT_BACKPACK
+					msg.addByte(0);
+					msg.add<uint16_t>(0);
+					msg.addByte(0);
+					msg.addByte(0);
+					break;
+
+				default:
+					break;
+			}
+
+			if (msg.size() != 0) {
+				send(msg);
+			}
+
+			// the echo of this say arrives after the reply to the action above
+			probeToken = "lg" + std::to_string(index) + "." + std::to_string(++probeSequence);
+			ClientMessage say;
+			say.addByte(0x96);
+			say.addByte(TALKTYPE_SAY);
+			say.addString(probeToken);
+			send(say);
+
+			probeStart = now;
+			scheduleAction();
+		}
+
+		void checkProbe(const uint8_t* data, size_t length) {
+			if (probeToken.empty()) {
+				return;
+			}
+
+			// the token is followed by its terminator in the say packet, the
+			// length prefix makes lg1.2 and lg1.23 distinct
+			std::string needle(2, '\0');
+			needle[0] = probeToken.size() & 0xFF;
+			needle[1] = probeToken.size() >> 8;
+			needle += probeToken;
+
+			const uint8_t* end = data + length;
+			if (std::search(data, end, needle.begin(), needle.end()) != end) {
+				const auto latency = Clock::now() - probeStart;
+				stats.actions[probeAction].add(latency);
+				stats.interval.add(latency);
+				probeToken.clear();
+			}
+		}
+
+		void send(const ClientMessage& msg, bool encrypted = true) {
+			bool writing = !outputQueue.empty();
+			outputQueue.push_back(msg.finish(encrypted ? key : nullptr));
+			if (!writing) {
+				write();
+			}
+		}
+
+		void write() {
+			const std::vector<uint8_t>& packet = outputQueue.front();
+			boost::asio::async_write(socket, boost::asio::buffer(packet),
+			                         std::bind(&Bot::onWrite, shared_from_this(), std::placeholders::_1));
+		}
+
+		void onWrite(const boost::system::error_code& error) {
+			outputQueue.pop_front();
+			if (error) {
+				return;
+			}
+
+			if (!outputQueue.empty()) {
+				write();
+			} else if (stopping) {
+				close();
+			}
+		}
+
+		void generateKey() {
+			for (uint32_t& part : key) {
+				part = rng();
+			}
+		}
+
+		std::string accountName() const {
+			return options.accountPrefix + std::to_string(index);
+		}
+
+		void fail(const std::string& reason) {
+			if (state != STATE_GAME) {
+				++stats.loginFailures;
+			}
+			std::cout << accountName() << ": " << reason << std::endl;
+			close();
+		}
+
+		void close() {
+			if (state == STATE_GAME) {
+				--stats.online;
+			}
+
+			state = STATE_CLOSED;
+			actionTimer.cancel();
+
+			boost::system::error_code error;
+			socket.close(error);
+		}
+
+		const Options& options;
+		LoadStats& stats;
+
+		boost::asio::ip::tcp::socket socket;
+		boost::asio::steady_timer actionTimer;
+		boost::asio::ip::tcp::resolver resolver;
+		std::mt19937 rng;
+
+		uint8_t input[NETWORKMESSAGE_MAXSIZE];
+		std::deque<std::vector<uint8_t>> outputQueue;
+
+		uint32_t key[4];
+		std::string characterName;
+		uint32_t creatureId = 0;
+		uint32_t index;
+		State state = STATE_CLOSED;
+		bool stopping = false;
+
+		Clock::time_point connectStart;
+		Clock::time_point loginStart;
+		Clock::time_point lastPing;
+
+		std::string probeToken;
+		uint32_t probeSequence = 0;
+		ActionType probeAction = ACTION_WALK;
+		Clock::time_point probeStart;
+};
+
+void printUsage(const char* name)
+{
+	std::cout << "Usage: " << name << " [options]\n"
+	          "  --host <address>        server address (127.0.0.1)\n"
+	          "  --port <port>           login port (7171)\n"
+	          "  --bots <count>          number of bots (10)\n"
+	          "  --account-prefix <s>    bots log in as <s><n> (bot)\n"
+	          "  --first-account <n>     number of the first account (0)\n"
+	          "  --password <s>          password of every bot account (bot)\n"
+	          "  --duration <seconds>    run time (60)\n"
+	          "  --interval <ms>         mean time between actions of a bot (500)\n"
+	          "  --ramp <ms>             delay between two bot logins, 0 logs in all at once (20)\n"
+	          "  --version <n>           client version sent at login (" << CLIENT_VERSION_MIN << ")\n"
+	          "  --rsa-modulus <n>       public key modulus in decimal (the one in otserv.cpp)\n"
+	          "\n"
+	          "Every account needs one character. Set maxMessageBuffer = 0 in config.lua,\n"
+	          "otherwise the bots get muted for talking too much and probes time out.\n"
+	          "Server lag is the median action round trip minus the median TCP connect time.\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h" || i + 1 >= argc) {
+			return false;
+		}
+
+		std::string value = argv[++i];
+		if (arg == "--host") {
+			options.host = value;
+		} else if (arg == "--port") {
+			options.loginPort = std::stoi(value);
+		} else if (arg == "--bots") {
+			options.botCount = std::stoul(value);
+		} else if (arg == "--account-prefix") {
+			options.accountPrefix = value;
+		} else if (arg == "--first-account") {
+			options.firstAccount = std::stoul(value);
+		} else if (arg == "--password") {
+			options.password = value;
+		} else if (arg == "--duration") {
+			options.duration = std::stoul(value);
+		} else if (arg == "--interval") {
+			options.actionInterval = std::max<uint32_t>(1, std::stoul(value));
+		} else if (arg == "--ramp") {
+			options.rampInterval = std::stoul(value);
+		} else if (arg == "--version") {
+			options.version = std::stoi(value);
+		} else if (arg == "--rsa-modulus") {
+			options.rsaModulus = value;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+void printReport(LoadStats& stats, double seconds)
+{
+	std::cout << std::endl << std::left << std::setw(12) << "round trip" << std::right << std::setw(9) << "count"
+	          << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "max ms" << std::endl;
+
+	stats.connect.print("tcp connect");
+	stats.login.print("login");
+
+	LatencyStats all;
+	size_t actions = 0;
+	for (int type = ACTION_WALK; type <= ACTION_LAST; ++type) {
+		stats.actions[type].print(actionNames[type]);
+		actions += stats.actions[type].size();
+	}
+
+	double lag = 0;
+	for (int type = ACTION_WALK; type <= ACTION_LAST; ++type) {
+		lag += stats.actions[type].percentile(0.5) * stats.actions[type].size();
+	}
+	if (actions != 0) {
+		lag = lag / actions - stats.connect.percentile(0.5);
+	}
+
+	std::cout << std::endl << std::fixed << std::setprecision(2)
+	          << "actions/s: " << actions / seconds
+	          << ", server lag: " << std::max(0., lag) << " ms"
+	          << ", login failures: " << stats.loginFailures
+	          << ", disconnects: " << stats.disconnects
+	          << ", probe timeouts: " << stats.timeouts
+	          << ", received: " << stats.bytesReceived / 1024 << " KiB" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	boost::asio::io_service io_service;
+	LoadStats stats;
+
+	std::vector<std::shared_ptr<Bot>> bots;
+	for (uint32_t i = 0; i < options.botCount; ++i) {
+		bots.push_back(std::make_shared<Bot>(io_service, options, stats, options.firstAccount + i));
+	}
+
+	boost::asio::steady_timer rampTimer(io_service);
+	size_t nextBot = 0;
+	std::function<void(const boost::system::error_code&)> startNext = [&](const boost::system::error_code& error) {
+		if (error) {
+			return;
+		}
+
+		do {
+			bots[nextBot++]->start();
+		} while (options.rampInterval == 0 && nextBot < bots.size());
+
+		if (nextBot < bots.size()) {
+			rampTimer.expires_from_now(std::chrono::milliseconds(options.rampInterval));
+			rampTimer.async_wait(startNext);
+		}
+	};
+	if (!bots.empty()) {
+		io_service.post(std::bind(startNext, boost::system::error_code()));
+	}
+
+	const auto start = Clock::now();
+	boost::asio::steady_timer reportTimer(io_service);
+	std::function<void(const boost::system::error_code&)> report = [&](const boost::system::error_code&) {
+		const auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - start).count();
+		std::cout << std::fixed << std::setprecision(2) << "[" << elapsed << "s] online: " << stats.online
+		          << ", round trips: " << stats.interval.size()
+		          << ", p50: " << stats.interval.percentile(0.5) << " ms"
+		          << ", p99: " << stats.interval.percentile(0.99) << " ms" << std::endl;
+		stats.interval.clear();
+
+		if (elapsed >= static_cast<int64_t>(options.duration)) {
+			rampTimer.cancel();
+			for (const auto& bot : bots) {
+				bot->stop();
+			}
+			return;
+		}
+
+		reportTimer.expires_from_now(std::chrono::seconds(10));
+		reportTimer.async_wait(report);
+	};
+	reportTimer.expires_from_now(std::chrono::seconds(10));
+	reportTimer.async_wait(report);
+
+	io_service.run();
+
+	printReport(stats, std::chrono::duration<double>(Clock::now() - start).count());
+	return 0;
+}
@@ -0,0 +1,213 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2014  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "otpch.h"
+
+#include <fstream>
+
+#include "luaprofiler.h"
+
+static int64_t getMicroseconds()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ';' separates frames in the folded format
+static void appendFrame(std::string& stack, const std::string& frame)
+{
+	if (!stack.empty()) {
+		stack.push_back(';');
+	}
+
+	size_t first = stack.size();
+	stack += frame;
+	std::replace(stack.begin() + first, stack.end(), ';', ':');
+}
+
+static bool writeFolded(const std::string& fileName, const std::unordered_map<std::string, uint64_t>& stacks)
+{
+	std::ofstream out(fileName, std::ios::trunc);
+	if (!out.is_open()) {
+		return false;
+	}
+
+	std::vector<const std::pair<const std::string, uint64_t>*> sorted;
+	sorted.reserve(stacks.size());
+	for (const auto& it : stacks) {
+		sorted.push_back(&it);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const std::pair<const std::string, uint64_t>* lhs, const std::pair<const std::string, uint64_t>* rhs) {
+		return lhs->first < rhs->first;
+	});
+
+	for (const auto* it : sorted) {
+		out << it->first << ' ' << it->second << '\n';
+	}
+	return out.good();
+}
+
+bool LuaProfiler::start(lua_State* L, uint32_t interval)
+{
+	if (running || !L) {
+		return false;
+	}
+
+	frames.clear();
+	wallTime.clear();
+	instructions.clear();
+	events = 0;
+
+	instructionInterval = interval;
+	if (instructionInterval != 0) {
+		lua_sethook(L, &LuaProfiler::hook, LUA_MASKCOUNT, instructionInterval);
+	}
+
+	startTime = getMicroseconds();
+	++session;
+	running = true;
+	return true;
+}
+
+bool LuaProfiler::stop(lua_State* L, const std::string& path)
+{
+	if (!running) {
+		return false;
+	}
+
+	if (L) {
+		lua_sethook(L, nullptr, 0, 0);
+	}
+
+	// events still on the stack are left out, leaveEvent ignores their session
+	running = false;
+	frames.clear();
+
+	bool written = writeFolded(path + ".wall.folded", wallTime);
+	if (instructionInterval != 0) {
+		written = writeFolded(path + ".instructions.folded", instructions) && written;
+	}
+
+	uint64_t totalTime = 0;
+	for (const auto& it : wallTime) {
+		totalTime += it.second;
+	}
+
+	std::cout << ">> Lua profiler: " << events << " script calls took " << totalTime / 1000 << " ms in "
+	          << (getMicroseconds() - startTime) / 1000 << " ms";
+	if (written) {
+		std::cout << ", written to " << path << ".*.folded" << std::endl;
+	} else {
+		std::cout << ", could not write " << path << ".*.folded" << std::endl;
+	}
+
+	wallTime.clear();
+	instructions.clear();
+	return written;
+}
+
+int LuaProfiler::getStackDepth(lua_State* L)
+{
+	lua_Debug ar;
+	int depth = 0;
+	while (lua_getstack(L, depth, &ar)) {
+		++depth;
+	}
+	return depth;
+}
+
+uint32_t LuaProfiler::enterEvent(lua_State* L, const std::string& interfaceName, const std::string& file)
+{
+	Frame frame;
+	if (!frames.empty()) {
+		frame.stack = frames.back().stack;
+	}
+	appendFrame(frame.stack, interfaceName);
+	appendFrame(frame.stack, file);
+	frame.childTime = 0;
+	frame.luaDepth = instructionInterval != 0 ? getStackDepth(L) : 0;
+	frame.startTime = getMicroseconds();
+	frames.push_back(std::move(frame));
+	return session;
+}
+
+void LuaProfiler::leaveEvent(uint32_t eventSession)
+{
+	if (!running || eventSession != session) {
+		// the profiler was stopped or restarted while this event ran
+		return;
+	}
+
+	Frame& frame = frames.back();
+	int64_t elapsed = getMicroseconds() - frame.startTime;
+	wallTime[frame.stack] += std::max<int64_t>(0, elapsed - frame.childTime);
+	++events;
+	frames.pop_back();
+
+	if (!frames.empty()) {
+		frames.back().childTime += elapsed;
+	}
+}
+
+void LuaProfiler::hook(lua_State* L, lua_Debug* ar)
+{
+	if (ar->event == LUA_HOOKCOUNT) {
+		g_luaProfiler.sample(L);
+	}
+}
+
+void LuaProfiler::sample(lua_State* L)
+{
+	// only the Lua frames above the innermost event belong to it
+	int baseDepth = 0;
+	std::string stack;
+	if (!frames.empty()) {
+		baseDepth = frames.back().luaDepth;
+		stack = frames.back().stack;
+	} else {
+		stack = "(no event)";
+	}
+
+	std::vector<std::string> luaFrames;
+	lua_Debug ar;
+	for (int level = 0, depth = getStackDepth(L) - baseDepth; level < depth && lua_getstack(L, level, &ar); ++level) {
+		lua_getinfo(L, "Sn", &ar);
+
+		std::ostringstream ss;
+		if (ar.name) {
+			ss << ar.name;
+		} else if (*ar.what == 'm') {
+			ss << "(main chunk)";
+		} else {
+			ss << "(anonymous)";
+		}
+
+		if (*ar.what == 'C') {
+			ss << " [C]";
+		} else {
+			ss << " (" << ar.short_src << ':' << ar.linedefined << ')';
+		}
+		luaFrames.push_back(ss.str());
+	}
+
+	for (auto it = luaFrames.rbegin(); it != luaFrames.rend(); ++it) {
+		appendFrame(stack, *it);
+	}
+	instructions[stack] += instructionInterval;
+}
@@ -0,0 +1,81 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2014  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef FS_LUAPROFILER_H_3E8A61C2D94B4F07A5B1E6C7D8F90A12
+#define FS_LUAPROFILER_H_3E8A61C2D94B4F07A5B1E6C7D8F90A12
+
+#include <lua.hpp>
+
+// Finds the scripts that stall the dispatcher. While running, every call
+// into Lua is timed and its self time is charged to the folded stack of the
+// events it is nested in ("interface;script file;interface;script file").
+// A count hook samples the Lua call stack every N VM instructions on top of
+// that. Both are written in the folded format that flamegraph.pl reads.
+// NOTE: under LuaJIT, compiled traces do not run count hooks, so the
+// instruction samples only cover interpreted code.
+class LuaProfiler
+{
+	public:
+		LuaProfiler() = default;
+
+		// non-copyable
+		LuaProfiler(const LuaProfiler&) = delete;
+		LuaProfiler& operator=(const LuaProfiler&) = delete;
+
+		bool start(lua_State* L, uint32_t instructionInterval);
+		// writes <path>.wall.folded (microseconds) and <path>.instructions.folded
+		bool stop(lua_State* L, const std::string& path);
+
+		bool isRunning() const {
+			return running;
+		}
+
+		// returns the session to pass to leaveEvent, events entered before a
+		// restart are left without touching the frames of the new session
+		uint32_t enterEvent(lua_State* L, const std::string& interfaceName, const std::string& file);
+		void leaveEvent(uint32_t eventSession);
+
+	private:
+		static void hook(lua_State* L, lua_Debug* ar);
+		static int getStackDepth(lua_State* L);
+
+		void sample(lua_State* L);
+
+		struct Frame {
+			std::string stack;
+			int64_t startTime;
+			int64_t childTime;
+			int luaDepth;
+		};
+
+		std::vector<Frame> frames;
+		std::unordered_map<std::string, uint64_t> wallTime;
+		std::unordered_map<std::string, uint64_t> instructions;
+
+		int64_t startTime = 0;
+		uint32_t instructionInterval = 0;
+		uint64_t events = 0;
+		uint32_t session = 0;
+		bool running = false;
+};
+
+extern LuaProfiler g_luaProfiler;
+
+#endif
@@ -49,6 +49,7 @@
 #include "databasetasks.h"
 #include "scriptmanager.h"
 #include "store.h"
+#include "luaprofiler.h"
 
 extern Chat* g_chat;
 extern Game g_game;
@@ -69,6 +70,7 @@ uint32_t ScriptEnvironment::m_lastResultId = 0;
 std::multimap<ScriptEnvironment*, Item*> ScriptEnvironment::tempItems;
 
 LuaEnvironment g_luaEnvironment;
+LuaProfiler g_luaProfiler;
 
 ScriptEnvironment::ScriptEnvironment()
 {
@@ -537,12 +539,22 @@ bool LuaScriptInterface::callFunction(int params)
 {
 	bool result = false;
 	int size = lua_gettop(m_luaState);
+
+	uint32_t profilerSession = 0;
+	if (g_luaProfiler.isRunning()) {
+		profilerSession = g_luaProfiler.enterEvent(m_luaState, m_interfaceName, getFileById(getScriptEnv()->getScriptId()));
+	}
+
 	if (protectedCall(m_luaState, params, 1) != 0) {
 		LuaScriptInterface::reportError(nullptr, LuaScriptInterface::getString(m_luaState, -1));
 	} else {
 		result = LuaScriptInterface::getBoolean(m_luaState, -1);
 	}
 
+	if (profilerSession != 0) {
+		g_luaProfiler.leaveEvent(profilerSession);
+	}
+
 	lua_pop(m_luaState, 1);
 	if ((lua_gettop(m_luaState) + params + 1) != size) {
 		LuaScriptInterface::reportError(nullptr, "Stack size changed!");
@@ -555,10 +567,20 @@ bool LuaScriptInterface::callFunction(int params)
 void LuaScriptInterface::callVoidFunction(int params)
 {
 	int size = lua_gettop(m_luaState);
+
+	uint32_t profilerSession = 0;
+	if (g_luaProfiler.isRunning()) {
+		profilerSession = g_luaProfiler.enterEvent(m_luaState, m_interfaceName, getFileById(getScriptEnv()->getScriptId()));
+	}
+
 	if (protectedCall(m_luaState, params, 0) != 0) {
 		LuaScriptInterface::reportError(nullptr, LuaScriptInterface::popString(m_luaState));
 	}
 
+	if (profilerSession != 0) {
+		g_luaProfiler.leaveEvent(profilerSession);
+	}
+
 	if ((lua_gettop(m_luaState) + params + 1) != size) {
 		LuaScriptInterface::reportError(nullptr, "Stack size changed!");
 	}
@@ -1878,6 +1900,11 @@ void LuaScriptInterface::registerFunctions()
 
 	registerMethod("Game", "startRaid", LuaScriptInterface::luaGameStartRaid);
 
+	registerMethod("Game", "getPathCacheStats", LuaScriptInterface::luaGameGetPathCacheStats);
+
+	registerMethod("Game", "startLuaProfiler", LuaScriptInterface::luaGameStartLuaProfiler);
+	registerMethod("Game", "stopLuaProfiler", LuaScriptInterface::luaGameStopLuaProfiler);
+
 	// Variant
 	registerClass("Variant", "", LuaScriptInterface::luaVariantCreate);
 
@@ -3712,7 +3739,7 @@ int LuaScriptInterface::luaAddEvent(lua_State* L)
 
 	auto& lastTimerEventId = g_luaEnvironment.m_lastEventTimerId;
 	eventDesc.eventId = g_scheduler.addEvent(createSchedulerTask(
-		delay, std::bind(&LuaEnvironment::executeTimerEvent, &g_luaEnvironment, lastTimerEventId)
+		delay, std::bind(&LuaEnvironment::executeTimerEvent, &g_luaEnvironment, lastTimerEventId), TASK_CATEGORY_LUA_EVENT
 	));
 
 	g_luaEnvironment.m_timerEvents.emplace(lastTimerEventId, std::move(eventDesc));
@@ -3979,7 +4006,7 @@ int LuaScriptInterface::luaDatabaseAsyncExecute(lua_State* L)
 			luaL_unref(luaState, LUA_REGISTRYINDEX, ref);
 		};
 	}
-	g_databaseTasks.addTask(getString(L, -1), callback);
+	g_databaseTasks.addTask(getString(L, -1), callback, false, DATABASE_TASK_KEY_SCRIPTS);
 	return 0;
 }
 
@@ -4023,7 +4050,7 @@ int LuaScriptInterface::luaDatabaseAsyncStoreQuery(lua_State* L)
 			luaL_unref(luaState, LUA_REGISTRYINDEX, ref);
 		};
 	}
-	g_databaseTasks.addTask(getString(L, -1), callback, true);
+	g_databaseTasks.addTask(getString(L, -1), callback, true, DATABASE_TASK_KEY_SCRIPTS);
 	return 0;
 }
 
@@ -4495,6 +4522,35 @@ int LuaScriptInterface::luaGameStartRaid(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaGameGetPathCacheStats(lua_State* L)
+{
+	// Game.getPathCacheStats()
+	const PathCacheStats& stats = g_game.map.pathCacheStats;
+	lua_createtable(L, 0, 4);
+	setField(L, "hits", stats.hits.load());
+	setField(L, "repairs", stats.repairs.load());
+	setField(L, "misses", stats.misses.load());
+	setField(L, "flowFieldPaths", stats.flowFieldPaths.load());
+	return 1;
+}
+
+int LuaScriptInterface::luaGameStartLuaProfiler(lua_State* L)
+{
+	// Game.startLuaProfiler([instructionInterval = 1000])
+	// 0 turns the instruction sampling off and only times the script calls
+	uint32_t instructionInterval = getNumber<uint32_t>(L, 1, 1000);
+	pushBoolean(L, g_luaProfiler.start(g_luaEnvironment.getLuaState(), instructionInterval));
+	return 1;
+}
+
+int LuaScriptInterface::luaGameStopLuaProfiler(lua_State* L)
+{
+	// Game.stopLuaProfiler([path = "data/logs/luaprofile"])
+	std::string path = getString(L, 1);
+	pushBoolean(L, g_luaProfiler.stop(g_luaEnvironment.getLuaState(), path.empty() ? "data/logs/luaprofile" : path));
+	return 1;
+}
+
 // Variant
 int LuaScriptInterface::luaVariantCreate(lua_State* L)
 {
@@ -6008,6 +6064,7 @@ int LuaScriptInterface::luaItemSetActionId(lua_State* L)
 	Item* item = getUserdata<Item>(L, 1);
 	if (item) {
 		item->setActionId(actionId);
+		HouseTile::setHouseDirty(item);
 		pushBoolean(L, true);
 	} else {
 		lua_pushnil(L);
@@ -6218,9 +6275,11 @@ int LuaScriptInterface::luaItemSetAttribute(lua_State* L)
 		}
 
 		item->setIntAttr(attribute, getNumber<int32_t>(L, 3));
+		HouseTile::setHouseDirty(item);
 		pushBoolean(L, true);
 	} else if (ItemAttributes::isStrAttrType(attribute)) {
 		item->setStrAttr(attribute, getString(L, 3));
+		HouseTile::setHouseDirty(item);
 		pushBoolean(L, true);
 	} else {
 		lua_pushnil(L);
@@ -6249,6 +6308,7 @@ int LuaScriptInterface::luaItemRemoveAttribute(lua_State* L)
 	bool ret = attribute != ITEM_ATTRIBUTE_UNIQUEID;
 	if (ret) {
 		item->removeAttribute(attribute);
+		HouseTile::setHouseDirty(item);
 	} else {
 		reportErrorFunc("Attempt to erase protected key \"uid\"");
 	}
@@ -7711,6 +7771,7 @@ int LuaScriptInterface::luaPlayerSetKills(lua_State* L)
 	}
 
 	player->unjustifiedKills = std::move(newKills);
+	player->dirtySections |= PLAYER_SAVE_KILLS;
 	player->sendUnjustifiedPoints();
 	pushBoolean(L, true);
 	return 1;
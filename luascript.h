@@ -569,6 +569,11 @@ class LuaScriptInterface
 
 		static int luaGameStartRaid(lua_State* L);
 
+		static int luaGameGetPathCacheStats(lua_State* L);
+
+		static int luaGameStartLuaProfiler(lua_State* L);
+		static int luaGameStopLuaProfiler(lua_State* L);
+
 		// Variant
 		static int luaVariantCreate(lua_State* L);
 
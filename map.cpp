@@ -27,8 +27,10 @@
 #include "combat.h"
 #include "creature.h"
 #include "game.h"
+#include "configmanager.h"
 
 extern Game g_game;
+extern ConfigManager g_config;
 
 bool Map::loadMap(const std::string& identifier, bool loadHouses)
 {
@@ -225,6 +227,8 @@ bool Map::placeCreature(const Position& centerPos, Creature* creature, bool exte
 
 	const Position& dest = toCylinder->getPosition();
 	getQTNode(dest.x, dest.y)->addCreature(creature);
+	// internalAddThing leaves the stamp alone, paths across dest now run into the creature
+	markTileChanged(dest);
 	return true;
 }
 
@@ -238,10 +242,9 @@ void Map::moveCreature(Creature& creature, Tile& newTile, bool forceTeleport/* =
 	bool teleport = forceTeleport || !newTile.getGround() || !Position::areInRange<1, 1, 0>(oldPos, newPos);
 
 	SpectatorVec list;
-	getSpectators(list, oldPos, true);
-	getSpectators(list, newPos, true);
+	getSpectators(list, oldPos, newPos, true);
 
-	std::vector<int32_t> oldStackPosVector;
+	SmallVector<int32_t, SPECTATOR_INLINE_SIZE> oldStackPosVector;
 	for (Creature* spectator : list) {
 		if (Player* tmpPlayer = spectator->getPlayer()) {
 			if (tmpPlayer->canSeeCreature(&creature)) {
@@ -302,7 +305,7 @@ void Map::moveCreature(Creature& creature, Tile& newTile, bool forceTeleport/* =
 	newTile.postAddNotification(&creature, &oldTile, 0);
 }
 
-void Map::getSpectatorsInternal(SpectatorVec& list, const Position& centerPos, int32_t minRangeX, int32_t maxRangeX, int32_t minRangeY, int32_t maxRangeY, int32_t minRangeZ, int32_t maxRangeZ, bool onlyPlayers) const
+void Map::getSpectatorsInternal(SpectatorVec& list, const Position& centerPos, int32_t minRangeX, int32_t maxRangeX, int32_t minRangeY, int32_t maxRangeY, int32_t minRangeZ, int32_t maxRangeZ, bool onlyPlayers, const Position* skipCenterPos/* = nullptr*/) const
 {
 	int_fast16_t min_y = centerPos.y + minRangeY;
 	int_fast16_t min_x = centerPos.x + minRangeX;
@@ -322,6 +325,11 @@ void Map::getSpectatorsInternal(SpectatorVec& list, const Position& centerPos, i
 	int32_t endx2 = x2 - (x2 % FLOOR_SIZE);
 	int32_t endy2 = y2 - (y2 % FLOOR_SIZE);
 
+	// every creature lives in exactly one leaf, so new entries only need to
+	// be checked against what the caller already had in the list, unless the
+	// caller says those are exactly the ones in range of skipCenterPos
+	const size_t first = list.size();
+
 	const QTreeLeafNode* startLeaf = QTreeNode::getLeafStatic<const QTreeLeafNode*, const QTreeNode*>(&root, startx1, starty1);
 	const QTreeLeafNode* leafS = startLeaf;
 	const QTreeLeafNode* leafE;
@@ -351,7 +359,16 @@ void Map::getSpectatorsInternal(SpectatorVec& list, const Position& centerPos, i
 							continue;
 						}
 
-						list.insert(creature);
+						if (skipCenterPos) {
+							int_fast32_t skipX = skipCenterPos->x + offsetZ;
+							int_fast32_t skipY = skipCenterPos->y + offsetZ;
+							if (cpos.x >= skipX + minRangeX && cpos.x <= skipX + maxRangeX &&
+							        cpos.y >= skipY + minRangeY && cpos.y <= skipY + maxRangeY) {
+								continue;
+							}
+						}
+
+						list.push_back(creature);
 					} while (++node_iter != node_end);
 				}
 				leafE = leafE->m_leafE;
@@ -366,6 +383,10 @@ void Map::getSpectatorsInternal(SpectatorVec& list, const Position& centerPos, i
 			leafS = QTreeNode::getLeafStatic<const QTreeLeafNode*, const QTreeNode*>(&root, startx1, ny + FLOOR_SIZE);
 		}
 	}
+
+	if (!skipCenterPos) {
+		list.removeDuplicates(first);
+	}
 }
 
 void Map::getSpectators(SpectatorVec& list, const Position& centerPos, bool multifloor /*= false*/, bool onlyPlayers /*= false*/, int32_t minRangeX /*= 0*/, int32_t maxRangeX /*= 0*/, int32_t minRangeY /*= 0*/, int32_t maxRangeY /*= 0*/)
@@ -374,97 +395,65 @@ void Map::getSpectators(SpectatorVec& list, const Position& centerPos, bool mult
 		return;
 	}
 
-	bool foundCache = false;
-	bool cacheResult = false;
-
 	minRangeX = (minRangeX == 0 ? -maxViewportX : -minRangeX);
 	maxRangeX = (maxRangeX == 0 ? maxViewportX : maxRangeX);
 	minRangeY = (minRangeY == 0 ? -maxViewportY : -minRangeY);
 	maxRangeY = (maxRangeY == 0 ? maxViewportY : maxRangeY);
 
-	if (minRangeX == -maxViewportX && maxRangeX == maxViewportX && minRangeY == -maxViewportY && maxRangeY == maxViewportY && multifloor) {
-		if (onlyPlayers) {
-			auto it = playersSpectatorCache.find(centerPos);
-			if (it != playersSpectatorCache.end()) {
-				if (!list.empty()) {
-					const SpectatorVec& cachedList = it->second;
-					list.insert(cachedList.begin(), cachedList.end());
-				} else {
-					list = it->second;
-				}
-
-				foundCache = true;
-			}
-		}
+	int32_t minRangeZ;
+	int32_t maxRangeZ;
+	getSpectatorsRangeZ(centerPos, multifloor, minRangeZ, maxRangeZ);
 
-		if (!foundCache) {
-			auto it = spectatorCache.find(centerPos);
-			if (it != spectatorCache.end()) {
-				if (!onlyPlayers) {
-					if (!list.empty()) {
-						const SpectatorVec& cachedList = it->second;
-						list.insert(cachedList.begin(), cachedList.end());
-					} else {
-						list = it->second;
-					}
-				} else {
-					const SpectatorVec& cachedList = it->second;
-					for (Creature* spectator : cachedList) {
-						if (spectator->getPlayer()) {
-							list.insert(spectator);
-						}
-					}
-				}
+	getSpectatorsInternal(list, centerPos, minRangeX, maxRangeX, minRangeY, maxRangeY, minRangeZ, maxRangeZ, onlyPlayers);
+}
 
-				foundCache = true;
-			} else {
-				cacheResult = true;
-			}
-		}
+void Map::getSpectators(SpectatorVec& list, const Position& fromPos, const Position& toPos, bool multifloor /*= false*/, bool onlyPlayers /*= false*/)
+{
+	if (fromPos.z != toPos.z || !list.empty()) {
+		getSpectators(list, fromPos, multifloor, onlyPlayers);
+		getSpectators(list, toPos, multifloor, onlyPlayers);
+		return;
 	}
 
-	if (!foundCache) {
-		int32_t minRangeZ;
-		int32_t maxRangeZ;
-
-		if (multifloor) {
-			if (centerPos.z > 7) {
-				//underground
-
-				//8->15
-				minRangeZ = std::max<int32_t>(centerPos.getZ() - 2, 0);
-				maxRangeZ = std::min<int32_t>(centerPos.getZ() + 2, MAP_MAX_LAYERS - 1);
-			} else if (centerPos.z == 6) {
-				minRangeZ = 0;
-				maxRangeZ = 8;
-			} else if (centerPos.z == 7) {
-				minRangeZ = 0;
-				maxRangeZ = 9;
-			} else {
-				minRangeZ = 0;
-				maxRangeZ = 7;
-			}
-		} else {
-			minRangeZ = centerPos.z;
-			maxRangeZ = centerPos.z;
-		}
+	if (fromPos.z >= MAP_MAX_LAYERS) {
+		return;
+	}
 
-		getSpectatorsInternal(list, centerPos, minRangeX, maxRangeX, minRangeY, maxRangeY, minRangeZ, maxRangeZ, onlyPlayers);
+	int32_t minRangeZ;
+	int32_t maxRangeZ;
+	getSpectatorsRangeZ(fromPos, multifloor, minRangeZ, maxRangeZ);
 
-		if (cacheResult) {
-			if (onlyPlayers) {
-				playersSpectatorCache[centerPos] = list;
-			} else {
-				spectatorCache[centerPos] = list;
-			}
-		}
+	// both viewports cover the same floors, so anything the first pass found
+	// can be recognised by position in the second one
+	getSpectatorsInternal(list, fromPos, -maxViewportX, maxViewportX, -maxViewportY, maxViewportY, minRangeZ, maxRangeZ, onlyPlayers);
+	if (fromPos != toPos) {
+		getSpectatorsInternal(list, toPos, -maxViewportX, maxViewportX, -maxViewportY, maxViewportY, minRangeZ, maxRangeZ, onlyPlayers, &fromPos);
 	}
 }
 
-void Map::clearSpectatorCache()
+void Map::getSpectatorsRangeZ(const Position& centerPos, bool multifloor, int32_t& minRangeZ, int32_t& maxRangeZ)
 {
-	spectatorCache.clear();
-	playersSpectatorCache.clear();
+	if (multifloor) {
+		if (centerPos.z > 7) {
+			//underground
+
+			//8->15
+			minRangeZ = std::max<int32_t>(centerPos.getZ() - 2, 0);
+			maxRangeZ = std::min<int32_t>(centerPos.getZ() + 2, MAP_MAX_LAYERS - 1);
+		} else if (centerPos.z == 6) {
+			minRangeZ = 0;
+			maxRangeZ = 8;
+		} else if (centerPos.z == 7) {
+			minRangeZ = 0;
+			maxRangeZ = 9;
+		} else {
+			minRangeZ = 0;
+			maxRangeZ = 7;
+		}
+	} else {
+		minRangeZ = centerPos.z;
+		maxRangeZ = centerPos.z;
+	}
 }
 
 bool Map::canThrowObjectTo(const Position& fromPos, const Position& toPos, bool checkLineOfSight /*= true*/,
@@ -579,7 +568,9 @@ bool Map::getPathMatching(const Creature& creature, std::forward_list<Direction>
 	Position pos = creature.getPosition();
 	Position endPos;
 
-	AStarNodes nodes(pos.x, pos.y);
+	AStarNodes& nodes = AStarNodes::getThreadInstance();
+	nodes.reset(pos.x, pos.y, g_config.getNumber(ConfigManager::PATHFINDING_MAX_NODES));
+	const int_fast32_t maxClosedNodes = g_config.getNumber(ConfigManager::PATHFINDING_MAX_CLOSED_NODES);
 
 	int32_t bestMatch = 0;
 
@@ -600,7 +591,7 @@ bool Map::getPathMatching(const Creature& creature, std::forward_list<Direction>
 	const Position startPos = pos;
 
 	AStarNode* found = nullptr;
-	while (fpp.maxSearchDist != 0 || nodes.getClosedNodes() < 100) {
+	while (fpp.maxSearchDist != 0 || nodes.getClosedNodes() < maxClosedNodes) {
 		AStarNode* n = nodes.getBestNode();
 		if (!n) {
 			if (found) {
@@ -668,6 +659,10 @@ bool Map::getPathMatching(const Creature& creature, std::forward_list<Direction>
 				continue;
 			}
 
+			if (!nodes.isInWindow(pos.x, pos.y)) {
+				continue;
+			}
+
 			const Tile* tile;
 			AStarNode* neighborNode = nodes.getNodeByPosition(pos.x, pos.y);
 			if (neighborNode) {
@@ -749,78 +744,322 @@ bool Map::getPathMatching(const Creature& creature, std::forward_list<Direction>
 	return true;
 }
 
+// the cost of stepping onto a flow field tile on top of the step itself, the
+// same extras A* charges; the target tile costs nothing
+static uint32_t getFlowFieldTileCost(const Tile& tile, const Position& targetPos)
+{
+	if (tile.getPosition() == targetPos) {
+		return 0;
+	}
+
+	uint32_t cost = 0;
+	if (tile.getCreatureCount() != 0) {
+		cost += MAP_NORMALWALKCOST * 3;
+	}
+
+	if (tile.getFieldItem()) {
+		cost += MAP_NORMALWALKCOST * 18;
+	}
+	return cost;
+}
+
+bool Map::getPathFromFlowField(const Creature& creature, const FlowField& field, std::forward_list<Direction>& dirList, const FindPathParams& fpp) const
+{
+	static const int_fast32_t allNeighbors[8][2] = {
+		{-1, 0}, {0, 1}, {1, 0}, {0, -1}, {-1, -1}, {1, -1}, {1, 1}, {-1, 1}
+	};
+
+	const Position startPos = creature.getPosition();
+	uint16_t distance = field.getDistance(startPos);
+	if (distance == FLOW_FIELD_UNREACHABLE) {
+		return false;
+	}
+
+	FrozenPathingConditionCall pathCondition(field.getTargetPosition());
+	int32_t bestMatch = 0;
+
+	// walk downhill along the cheapest step, each one strictly lowers the
+	// distance. A distance already includes the cost of stepping onto its
+	// tile, so the step that built it is the one with the lowest total.
+	Position pos = startPos;
+	auto tail = dirList.before_begin();
+	while (!pathCondition(startPos, pos, fpp, bestMatch)) {
+		Position bestPos;
+		uint16_t bestDistance = distance;
+		uint32_t bestCost = std::numeric_limits<uint32_t>::max();
+		for (uint_fast32_t i = 0; i < 8; ++i) {
+			Position nextPos(pos.x + allNeighbors[i][0], pos.y + allNeighbors[i][1], pos.z);
+
+			uint16_t nextDistance = field.getDistance(nextPos);
+			if (nextDistance >= distance) {
+				continue;
+			}
+
+			const Tile* tile = getTile(nextPos.x, nextPos.y, nextPos.z);
+			if (!tile) {
+				continue;
+			}
+
+			uint32_t cost = nextDistance + getFlowFieldTileCost(*tile, field.getTargetPosition()) + (i < 4 ? MAP_NORMALWALKCOST : MAP_DIAGONALWALKCOST);
+			if (cost >= bestCost) {
+				continue;
+			}
+
+			if (fpp.maxSearchDist != 0 && (Position::getDistanceX(startPos, nextPos) > fpp.maxSearchDist || Position::getDistanceY(startPos, nextPos) > fpp.maxSearchDist)) {
+				continue;
+			}
+
+			if (!canWalkTo(creature, nextPos)) {
+				continue;
+			}
+
+			bestPos = nextPos;
+			bestDistance = nextDistance;
+			bestCost = cost;
+		}
+
+		if (bestDistance == distance) {
+			dirList.clear();
+			return false;
+		}
+
+		tail = dirList.insert_after(tail, getDirectionTo(pos, bestPos));
+		pos = bestPos;
+		distance = bestDistance;
+	}
+	return true;
+}
+
+const FlowField* Map::getFlowField(const Creature& target, bool build)
+{
+	const Position& targetPos = target.getPosition();
+	if (!build) {
+		auto it = flowFields.find(target.getID());
+		if (it == flowFields.end()) {
+			return nullptr;
+		}
+
+		const FlowField& field = it->second;
+		if (!field.built || field.tick != flowFieldTick || field.targetPos != targetPos) {
+			return nullptr;
+		}
+		return &field;
+	}
+
+	FlowField& field = flowFields[target.getID()];
+	if (field.tick != flowFieldTick || field.targetPos != targetPos) {
+		field.tick = flowFieldTick;
+		field.targetPos = targetPos;
+		field.requests = 0;
+		field.built = false;
+	}
+
+	if (!field.built) {
+		// a single chaser is better off with a plain A* search
+		if (++field.requests < 2) {
+			return nullptr;
+		}
+		field.build(*this, targetPos);
+	}
+	return &field;
+}
+
+void Map::nextFlowFieldTick()
+{
+	for (auto it = flowFields.begin(); it != flowFields.end();) {
+		if (it->second.tick != flowFieldTick) {
+			it = flowFields.erase(it);
+		} else {
+			++it;
+		}
+	}
+	++flowFieldTick;
+}
+
+// FlowField
+
+void FlowField::build(const Map& map, const Position& targetPos)
+{
+	static const int_fast32_t allNeighbors[8][2] = {
+		{-1, 0}, {0, 1}, {1, 0}, {0, -1}, {-1, -1}, {1, -1}, {1, 1}, {-1, 1}
+	};
+
+	this->targetPos = targetPos;
+	built = true;
+
+	distances.assign(FLOW_FIELD_SIZE * FLOW_FIELD_SIZE, FLOW_FIELD_UNREACHABLE);
+
+	const int_fast32_t originX = targetPos.x - FLOW_FIELD_RADIUS;
+	const int_fast32_t originY = targetPos.y - FLOW_FIELD_RADIUS;
+
+	static const tileflags_t blockingFlags = static_cast<tileflags_t>(TILESTATE_PROTECTIONZONE | TILESTATE_FLOORCHANGE | TILESTATE_TELEPORT |
+	        TILESTATE_IMMOVABLEBLOCKSOLID | TILESTATE_IMMOVABLENOFIELDBLOCKPATH | TILESTATE_BLOCKSOLID | TILESTATE_NOFIELDBLOCKPATH);
+
+	// Dijkstra outwards from the target with a bucket queue: a step never
+	// costs more than FLOW_FIELD_BUCKETS, so buckets can be reused in a ring.
+	// Fields are only built by the dispatcher thread.
+	static std::vector<uint16_t> buckets[FLOW_FIELD_BUCKETS];
+
+	const uint16_t targetCell = FLOW_FIELD_RADIUS * FLOW_FIELD_SIZE + FLOW_FIELD_RADIUS;
+	distances[targetCell] = 0;
+	buckets[0].push_back(targetCell);
+	size_t pending = 1;
+
+	for (uint32_t distance = 0; pending != 0; ++distance) {
+		std::vector<uint16_t>& bucket = buckets[distance % FLOW_FIELD_BUCKETS];
+		for (size_t i = 0; i < bucket.size(); ++i) {
+			const uint16_t cell = bucket[i];
+			--pending;
+
+			if (distance != distances[cell]) {
+				continue;
+			}
+
+			const int_fast32_t x = cell % FLOW_FIELD_SIZE;
+			const int_fast32_t y = cell / FLOW_FIELD_SIZE;
+
+			// only cells with a tile get a distance
+			const uint32_t tileCost = getFlowFieldTileCost(*map.getTile(originX + x, originY + y, targetPos.z), targetPos);
+
+			for (uint_fast32_t dir = 0; dir < 8; ++dir) {
+				const int_fast32_t nx = x + allNeighbors[dir][0];
+				const int_fast32_t ny = y + allNeighbors[dir][1];
+				if (nx < 0 || ny < 0 || nx >= FLOW_FIELD_SIZE || ny >= FLOW_FIELD_SIZE) {
+					continue;
+				}
+
+				const uint32_t newDistance = distance + tileCost + (dir < 4 ? MAP_NORMALWALKCOST : MAP_DIAGONALWALKCOST);
+				const uint16_t neighborCell = ny * FLOW_FIELD_SIZE + nx;
+				if (newDistance >= distances[neighborCell]) {
+					continue;
+				}
+
+				const int_fast32_t tileX = originX + nx;
+				const int_fast32_t tileY = originY + ny;
+				if (tileX < 0 || tileY < 0 || tileX > 0xFFFF || tileY > 0xFFFF) {
+					continue;
+				}
+
+				// tiles no monster can stand on never get a distance
+				const Tile* tile = map.getTile(tileX, tileY, targetPos.z);
+				if (!tile || tile->hasFlag(blockingFlags)) {
+					continue;
+				}
+
+				distances[neighborCell] = newDistance;
+				buckets[newDistance % FLOW_FIELD_BUCKETS].push_back(neighborCell);
+				++pending;
+			}
+		}
+		bucket.clear();
+	}
+}
+
 // AStarNodes
 
-AStarNodes::AStarNodes(uint32_t x, uint32_t y)
-	: nodes(), openNodes()
+AStarNodes::AStarNodes()
+	: cellNodes(PATHFINDING_WINDOW_SIZE * PATHFINDING_WINDOW_SIZE), closedCells(PATHFINDING_WINDOW_SIZE * PATHFINDING_WINDOW_SIZE / 64)
 {
-	curNode = 1;
+	curNode = 0;
+	maxNodes = 0;
 	closedNodes = 0;
-	openNodes[0] = true;
-
-	AStarNode& startNode = nodes[0];
-	startNode.parent = nullptr;
-	startNode.x = x;
-	startNode.y = y;
-	startNode.f = 0;
-	nodeTable[(x << 16) | y] = nodes;
+	windowX = 0;
+	windowY = 0;
+}
+
+AStarNodes& AStarNodes::getThreadInstance()
+{
+	// heap allocated so threads that never search do not carry the buffers
+	static thread_local std::unique_ptr<AStarNodes> instance;
+	if (!instance) {
+		instance.reset(new AStarNodes);
+	}
+	return *instance;
+}
+
+void AStarNodes::reset(uint32_t x, uint32_t y, size_t maxNodes)
+{
+	// only the cells touched by the previous search need clearing
+	for (size_t i = 0; i < curNode; ++i) {
+		uint32_t cell = getCell(nodes[i].x, nodes[i].y);
+		cellNodes[cell] = 0;
+		closedCells[cell >> 6] = 0;
+	}
+
+	this->maxNodes = std::min<size_t>(std::max<size_t>(maxNodes, 1), MAX_NODES);
+	if (nodes.size() < this->maxNodes) {
+		nodes.resize(this->maxNodes);
+		openHeap.reserve(this->maxNodes);
+	}
+
+	openHeap.clear();
+	curNode = 0;
+	closedNodes = 0;
+	windowX = x - PATHFINDING_WINDOW_SIZE / 2;
+	windowY = y - PATHFINDING_WINDOW_SIZE / 2;
+
+	createOpenNode(nullptr, x, y, 0);
 }
 
 AStarNode* AStarNodes::createOpenNode(AStarNode* parent, uint32_t x, uint32_t y, int_fast32_t f)
 {
-	if (curNode >= MAX_NODES) {
+	if (curNode >= maxNodes) {
 		return nullptr;
 	}
 
 	size_t retNode = curNode++;
-	openNodes[retNode] = true;
+	cellNodes[getCell(x, y)] = retNode + 1;
 
-	AStarNode* node = nodes + retNode;
-	nodeTable[(x << 16) | y] = node;
+	AStarNode* node = &nodes[retNode];
 	node->parent = parent;
 	node->x = x;
 	node->y = y;
 	node->f = f;
+	pushOpen(node);
 	return node;
 }
 
 AStarNode* AStarNodes::getBestNode()
 {
-	if (curNode == 0) {
+	if (openHeap.empty()) {
 		return nullptr;
 	}
 
-	int32_t best_node_f = std::numeric_limits<int32_t>::max();
-	int32_t best_node = -1;
-	for (size_t i = 0; i < curNode; i++) {
-		if (openNodes[i] && nodes[i].f < best_node_f) {
-			best_node_f = nodes[i].f;
-			best_node = i;
-		}
-	}
+	AStarNode* best = openHeap.front();
+	best->heapIndex = -1;
 
-	if (best_node >= 0) {
-		return nodes + best_node;
+	AStarNode* last = openHeap.back();
+	openHeap.pop_back();
+	if (last != best) {
+		openHeap.front() = last;
+		last->heapIndex = 0;
+		siftDown(0);
 	}
-	return nullptr;
+	return best;
 }
 
 void AStarNodes::closeNode(AStarNode* node)
 {
-	size_t index = node - nodes;
-	assert(index < MAX_NODES);
-	openNodes[index] = false;
+	uint32_t cell = getCell(node->x, node->y);
+	closedCells[cell >> 6] |= uint64_t(1) << (cell & 63);
 	++closedNodes;
 }
 
 void AStarNodes::openNode(AStarNode* node)
 {
-	size_t index = node - nodes;
-	assert(index < MAX_NODES);
-	if (!openNodes[index]) {
-		openNodes[index] = true;
+	uint32_t cell = getCell(node->x, node->y);
+	uint64_t bit = uint64_t(1) << (cell & 63);
+	if (closedCells[cell >> 6] & bit) {
+		closedCells[cell >> 6] &= ~bit;
 		--closedNodes;
 	}
+
+	if (node->heapIndex < 0) {
+		pushOpen(node);
+	} else {
+		// the cost only ever goes down
+		siftUp(node->heapIndex);
+	}
 }
 
 int_fast32_t AStarNodes::getClosedNodes() const
@@ -830,11 +1069,68 @@ int_fast32_t AStarNodes::getClosedNodes() const
 
 AStarNode* AStarNodes::getNodeByPosition(uint32_t x, uint32_t y)
 {
-	auto it = nodeTable.find((x << 16) | y);
-	if (it == nodeTable.end()) {
+	if (!isInWindow(x, y)) {
 		return nullptr;
 	}
-	return it->second;
+
+	uint16_t index = cellNodes[getCell(x, y)];
+	if (index == 0) {
+		return nullptr;
+	}
+	return &nodes[index - 1];
+}
+
+void AStarNodes::pushOpen(AStarNode* node)
+{
+	node->heapIndex = openHeap.size();
+	openHeap.push_back(node);
+	siftUp(node->heapIndex);
+}
+
+void AStarNodes::siftUp(int32_t index)
+{
+	AStarNode* node = openHeap[index];
+	while (index > 0) {
+		int32_t parentIndex = (index - 1) / 2;
+		AStarNode* parent = openHeap[parentIndex];
+		if (!isCheaper(node, parent)) {
+			break;
+		}
+
+		openHeap[index] = parent;
+		parent->heapIndex = index;
+		index = parentIndex;
+	}
+
+	openHeap[index] = node;
+	node->heapIndex = index;
+}
+
+void AStarNodes::siftDown(int32_t index)
+{
+	const int32_t size = openHeap.size();
+	AStarNode* node = openHeap[index];
+	while (true) {
+		int32_t child = index * 2 + 1;
+		if (child >= size) {
+			break;
+		}
+
+		if (child + 1 < size && isCheaper(openHeap[child + 1], openHeap[child])) {
+			++child;
+		}
+
+		if (!isCheaper(openHeap[child], node)) {
+			break;
+		}
+
+		openHeap[index] = openHeap[child];
+		openHeap[index]->heapIndex = index;
+		index = child;
+	}
+
+	openHeap[index] = node;
+	node->heapIndex = index;
 }
 
 int_fast32_t AStarNodes::getMapWalkCost(AStarNode* node, const Position& neighborPos)
@@ -20,6 +20,8 @@
 #ifndef FS_MAP_H_E3953D57C058461F856F5221D359DAFA
 #define FS_MAP_H_E3953D57C058461F856F5221D359DAFA
 
+#include <atomic>
+
 #include "position.h"
 #include "item.h"
 #include "fileloader.h"
@@ -43,17 +45,38 @@ struct AStarNode {
 	AStarNode* parent;
 	int_fast32_t f;
 	uint16_t x, y;
+	int32_t heapIndex;
 };
 
-#define MAX_NODES 512
+#define MAX_NODES 65535
 
 #define MAP_NORMALWALKCOST 10
 #define MAP_DIAGONALWALKCOST 25
 
+// nodes are only created within this many tiles of the start position
+#define PATHFINDING_WINDOW_BITS 8
+#define PATHFINDING_WINDOW_SIZE (1 << PATHFINDING_WINDOW_BITS)
+#define PATHFINDING_WINDOW_MASK (PATHFINDING_WINDOW_SIZE - 1)
+
+/**
+  * Working set of one path search. Each thread keeps its own instance
+  * (getThreadInstance) which reset() prepares for the next search, so
+  * nothing is allocated once the buffers have grown to the node limit.
+  * Open nodes are kept in an indexed binary heap, nodes and closed flags
+  * are looked up through flat arrays over a window around the start.
+  */
 class AStarNodes
 {
 	public:
-		AStarNodes(uint32_t x, uint32_t y);
+		AStarNodes();
+
+		// non-copyable
+		AStarNodes(const AStarNodes&) = delete;
+		AStarNodes& operator=(const AStarNodes&) = delete;
+
+		static AStarNodes& getThreadInstance();
+
+		void reset(uint32_t x, uint32_t y, size_t maxNodes);
 
 		AStarNode* createOpenNode(AStarNode* parent, uint32_t x, uint32_t y, int_fast32_t f);
 		AStarNode* getBestNode();
@@ -62,18 +85,89 @@ class AStarNodes
 		int_fast32_t getClosedNodes() const;
 		AStarNode* getNodeByPosition(uint32_t x, uint32_t y);
 
+		bool isInWindow(uint32_t x, uint32_t y) const {
+			return (x - windowX) < PATHFINDING_WINDOW_SIZE && (y - windowY) < PATHFINDING_WINDOW_SIZE;
+		}
+
 		static int_fast32_t getMapWalkCost(AStarNode* node, const Position& neighborPos);
 		static int_fast32_t getTileWalkCost(const Creature& creature, const Tile* tile);
 
 	private:
-		AStarNode nodes[MAX_NODES];
-		bool openNodes[MAX_NODES];
-		std::unordered_map<uint32_t, AStarNode*> nodeTable;
+		static uint32_t getCell(uint32_t x, uint32_t y) {
+			return ((y & PATHFINDING_WINDOW_MASK) << PATHFINDING_WINDOW_BITS) | (x & PATHFINDING_WINDOW_MASK);
+		}
+
+		bool isCheaper(const AStarNode* a, const AStarNode* b) const {
+			return a->f < b->f || (a->f == b->f && a < b);
+		}
+		void pushOpen(AStarNode* node);
+		void siftUp(int32_t index);
+		void siftDown(int32_t index);
+
+		std::vector<AStarNode> nodes;
+		std::vector<AStarNode*> openHeap;
+		std::vector<uint16_t> cellNodes; // node index + 1 per window cell
+		std::vector<uint64_t> closedCells;
 		size_t curNode;
+		size_t maxNodes;
 		int_fast32_t closedNodes;
+		uint32_t windowX;
+		uint32_t windowY;
+};
+
+// tile change stamps are hashed over this many x/y bits, floors share them
+#define TILE_STAMP_BITS 8
+#define TILE_STAMP_MASK ((1 << TILE_STAMP_BITS) - 1)
+
+struct PathCacheStats {
+	std::atomic<uint64_t> hits;
+	std::atomic<uint64_t> repairs;
+	std::atomic<uint64_t> misses;
+	std::atomic<uint64_t> flowFieldPaths;
+
+	PathCacheStats() : hits(0), repairs(0), misses(0), flowFieldPaths(0) {}
 };
 
-typedef std::map<Position, SpectatorVec> SpectatorCache;
+#define FLOW_FIELD_RADIUS 16
+#define FLOW_FIELD_SIZE (FLOW_FIELD_RADIUS * 2 + 1)
+#define FLOW_FIELD_UNREACHABLE 0xFFFF
+#define FLOW_FIELD_BUCKETS 256 // more than the most a single step can cost
+
+/**
+  * Walking cost from every tile around a target to the target itself,
+  * computed once and shared by all monsters chasing that target. Only
+  * tile properties that hold for any monster are considered; the steps
+  * taken from it are still checked with Map::canWalkTo.
+  */
+class FlowField
+{
+	public:
+		FlowField() : tick(0), requests(0), built(false) {}
+
+		void build(const Map& map, const Position& targetPos);
+
+		uint16_t getDistance(const Position& pos) const {
+			uint32_t x = pos.x - (targetPos.x - FLOW_FIELD_RADIUS);
+			uint32_t y = pos.y - (targetPos.y - FLOW_FIELD_RADIUS);
+			if (pos.z != targetPos.z || x >= FLOW_FIELD_SIZE || y >= FLOW_FIELD_SIZE) {
+				return FLOW_FIELD_UNREACHABLE;
+			}
+			return distances[y * FLOW_FIELD_SIZE + x];
+		}
+
+		const Position& getTargetPosition() const {
+			return targetPos;
+		}
+
+	private:
+		std::vector<uint16_t> distances;
+		Position targetPos;
+		uint32_t tick;
+		uint32_t requests;
+		bool built;
+
+		friend class Map;
+};
 
 #define FLOOR_BITS 3
 #define FLOOR_SIZE (1 << FLOOR_BITS)
@@ -172,7 +266,7 @@ class QTreeLeafNode final : public QTreeNode
 class Map
 {
 	public:
-		Map() : width(0), height(0) {}
+		Map() : tileStamps(), flowFieldTick(0), width(0), height(0) {}
 
 		static const int32_t maxViewportX = 11; //min value: maxClientViewportX + 1
 		static const int32_t maxViewportY = 11; //min value: maxClientViewportY + 1
@@ -231,8 +325,13 @@ class Map
 		                   int32_t minRangeX = 0, int32_t maxRangeX = 0,
 		                   int32_t minRangeY = 0, int32_t maxRangeY = 0);
 
-		void clearSpectatorCache();
-		
+		/**
+		  * Gets the spectators of two positions at once, e.g. both ends of
+		  * a step. Uses the default viewport range.
+		  */
+		void getSpectators(SpectatorVec& list, const Position& fromPos, const Position& toPos,
+		                   bool multifloor = false, bool onlyPlayers = false);
+
 		/**
 		  * Checks if you can throw an object to that position
 		  *	\param fromPos from Source point
@@ -260,6 +359,8 @@ class Map
 
 		bool getPathMatching(const Creature& creature, std::forward_list<Direction>& dirList,
 		                     const FrozenPathingConditionCall& pathCondition, const FindPathParams& fpp) const;
+		bool getPathFromFlowField(const Creature& creature, const FlowField& field, std::forward_list<Direction>& dirList,
+		                          const FindPathParams& fpp) const;
 
 		std::map<std::string, Position> waypoints;
 
@@ -267,15 +368,41 @@ class Map
 			return QTreeNode::getLeafStatic<QTreeLeafNode*, QTreeNode*>(&root, x, y);
 		}
 
+		/**
+		  * Cached paths remember the stamp of every tile they cross and are
+		  * dropped once one of them changes, see Creature::findFollowPath.
+		  */
+		void markTileChanged(const Position& pos) {
+			++tileStamps[getTileStampIndex(pos)];
+		}
+		uint32_t getTileStamp(const Position& pos) const {
+			return tileStamps[getTileStampIndex(pos)];
+		}
+
+		PathCacheStats pathCacheStats;
+
+		/**
+		  * Gets the flow field around target for the current think round.
+		  * With build set, the field is computed on the second request for
+		  * the same target position; without it the call only reads.
+		  */
+		const FlowField* getFlowField(const Creature& target, bool build);
+		void nextFlowFieldTick();
+
 		Spawns spawns;
 		Towns towns;
 		Houses houses;
 	protected:
-		SpectatorCache spectatorCache;
-		SpectatorCache playersSpectatorCache;
-
 		QTreeNode root;
 
+		static uint32_t getTileStampIndex(const Position& pos) {
+			return ((pos.y & TILE_STAMP_MASK) << TILE_STAMP_BITS) | (pos.x & TILE_STAMP_MASK);
+		}
+		uint32_t tileStamps[1 << (TILE_STAMP_BITS * 2)];
+
+		std::unordered_map<uint32_t, FlowField> flowFields;
+		uint32_t flowFieldTick;
+
 		std::string spawnfile;
 		std::string housefile;
 
@@ -285,7 +412,9 @@ class Map
 		void getSpectatorsInternal(SpectatorVec& list, const Position& centerPos,
 		                           int32_t minRangeX, int32_t maxRangeX,
 		                           int32_t minRangeY, int32_t maxRangeY,
-		                           int32_t minRangeZ, int32_t maxRangeZ, bool onlyPlayers) const;
+		                           int32_t minRangeZ, int32_t maxRangeZ, bool onlyPlayers,
+		                           const Position* skipCenterPos = nullptr) const;
+		static void getSpectatorsRangeZ(const Position& centerPos, bool multifloor, int32_t& minRangeZ, int32_t& maxRangeZ);
 
 		friend class Game;
 		friend class IOMap;
@@ -28,7 +28,7 @@
 #include "position.h"
 #include "rsa.h"
 
-int32_t NetworkMessage::decodeHeader()
+int32_t NetworkMessageBase::decodeHeader()
 {
 	int32_t newSize = static_cast<int32_t>(buffer[0] | buffer[1] << 8);
 	length = newSize;
@@ -36,7 +36,7 @@ int32_t NetworkMessage::decodeHeader()
 }
 
 /******************************************************************************/
-std::string NetworkMessage::getString(uint16_t stringLen/* = 0*/)
+std::string NetworkMessageBase::getString(uint16_t stringLen/* = 0*/)
 {
 	if (stringLen == 0) {
 		stringLen = get<uint16_t>();
@@ -51,7 +51,7 @@ std::string NetworkMessage::getString(uint16_t stringLen/* = 0*/)
 	return std::string(v, stringLen);
 }
 
-Position NetworkMessage::getPosition()
+Position NetworkMessageBase::getPosition()
 {
 	Position pos;
 	pos.x = get<uint16_t>();
@@ -61,7 +61,7 @@ Position NetworkMessage::getPosition()
 }
 /******************************************************************************/
 
-void NetworkMessage::addString(const std::string& value)
+void NetworkMessageBase::addString(const std::string& value)
 {
 	size_t stringLen = value.length();
 	if (!canAdd(stringLen + 2) || stringLen > 8192) {
@@ -74,7 +74,7 @@ void NetworkMessage::addString(const std::string& value)
 	length += stringLen;
 }
 
-void NetworkMessage::addString(const char* value)
+void NetworkMessageBase::addString(const char* value)
 {
 	size_t stringLen = strlen(value);
 	if (!canAdd(stringLen + 2) || stringLen > 8192) {
@@ -87,13 +87,13 @@ void NetworkMessage::addString(const char* value)
 	length += stringLen;
 }
 
-void NetworkMessage::addDouble(double value, uint8_t precision/* = 2*/)
+void NetworkMessageBase::addDouble(double value, uint8_t precision/* = 2*/)
 {
 	addByte(precision);
 	add<uint32_t>((value * std::pow(static_cast<float>(10), precision)) + std::numeric_limits<int32_t>::max());
 }
 
-void NetworkMessage::addBytes(const char* bytes, size_t size)
+void NetworkMessageBase::addBytes(const char* bytes, size_t size)
 {
 	if (!canAdd(size) || size > 8192) {
 		return;
@@ -104,7 +104,7 @@ void NetworkMessage::addBytes(const char* bytes, size_t size)
 	length += size;
 }
 
-void NetworkMessage::addPaddingBytes(size_t n)
+void NetworkMessageBase::addPaddingBytes(size_t n)
 {
 	if (!canAdd(n)) {
 		return;
@@ -114,14 +114,14 @@ void NetworkMessage::addPaddingBytes(size_t n)
 	length += n;
 }
 
-void NetworkMessage::addPosition(const Position& pos)
+void NetworkMessageBase::addPosition(const Position& pos)
 {
 	add<uint16_t>(pos.x);
 	add<uint16_t>(pos.y);
 	addByte(pos.z);
 }
 
-void NetworkMessage::addItem(uint16_t id, uint8_t count)
+void NetworkMessageBase::addItem(uint16_t id, uint8_t count)
 {
 	const ItemType& it = Item::items[id];
 
@@ -140,7 +140,7 @@ void NetworkMessage::addItem(uint16_t id, uint8_t count)
 	}
 }
 
-void NetworkMessage::addItem(const Item* item)
+void NetworkMessageBase::addItem(const Item* item)
 {
 	const ItemType& it = Item::items[item->getID()];
 
@@ -158,7 +158,7 @@ void NetworkMessage::addItem(const Item* item)
 	}
 }
 
-void NetworkMessage::addItemId(uint16_t itemId)
+void NetworkMessageBase::addItemId(uint16_t itemId)
 {
 	add<uint16_t>(Item::items[itemId].clientId);
 }
@@ -28,7 +28,10 @@ class Player;
 struct Position;
 class RSA;
 
-class NetworkMessage
+// Read/write cursor over a message buffer. The storage belongs to the
+// subclass: NetworkMessage embeds a full sized one, OutputMessage borrows
+// pooled buffers and grows into a larger one when a write does not fit.
+class NetworkMessageBase
 {
 	public:
 		enum { header_length = 2 };
@@ -37,10 +40,7 @@ class NetworkMessage
 		enum { max_body_length = NETWORKMESSAGE_MAXSIZE - header_length - crypto_length - xtea_multiple };
 		enum { max_protocol_body_length = max_body_length - 10 };
 
-		// constructor
-		NetworkMessage() {
-			reset();
-		}
+		virtual ~NetworkMessageBase() = default;
 
 		void reset() {
 			overrun = false;
@@ -153,8 +153,17 @@ class NetworkMessage
 		}
 
 	protected:
-		inline bool canAdd(size_t size) const {
-			return (size + position) < max_body_length;
+		NetworkMessageBase(uint8_t* buffer, int32_t bufferLimit) : buffer(buffer), bufferLimit(bufferLimit) {
+			reset();
+		}
+
+		inline bool canAdd(size_t size) {
+			return (size + position) < static_cast<size_t>(bufferLimit) || grow(size + position);
+		}
+
+		// called when a write would reach bufferLimit, may swap in a bigger buffer
+		virtual bool grow(size_t) {
+			return false;
 		}
 
 		inline bool canRead(int32_t size) {
@@ -165,11 +174,38 @@ class NetworkMessage
 			return true;
 		}
 
+		uint8_t* buffer;
+		int32_t bufferLimit;
+
 		int32_t length;
 		int32_t position;
 		bool overrun;
+};
 
-		uint8_t buffer[NETWORKMESSAGE_MAXSIZE];
+class NetworkMessage : public NetworkMessageBase
+{
+	public:
+		// constructor
+		NetworkMessage() : NetworkMessageBase(storage, max_body_length) {}
+
+		NetworkMessage(const NetworkMessage& other) : NetworkMessageBase(storage, max_body_length) {
+			*this = other;
+		}
+
+		NetworkMessage& operator=(const NetworkMessage& other) {
+			if (this == &other) {
+				return *this;
+			}
+
+			length = other.length;
+			position = other.position;
+			overrun = other.overrun;
+			memcpy(storage, other.storage, sizeof(storage));
+			return *this;
+		}
+
+	protected:
+		uint8_t storage[NETWORKMESSAGE_MAXSIZE];
 };
 
 #endif // #ifndef __NETWORK_MESSAGE_H__
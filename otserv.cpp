@@ -47,10 +47,16 @@
 #include "databasemanager.h"
 #include "scheduler.h"
 #include "databasetasks.h"
+#include "cryptotasks.h"
+#include "taskstats.h"
+#include "worldsave.h"
 
 DatabaseTasks g_databaseTasks;
+CryptoTasks g_cryptoTasks;
 Dispatcher g_dispatcher;
 Scheduler g_scheduler;
+TaskStats g_taskStats;
+WorldSave g_worldSave;
 
 Game g_game;
 ConfigManager g_config;
@@ -121,11 +127,15 @@ int main(int argc, char* argv[])
 		std::cout << ">> No services running. The server is NOT online." << std::endl;
 		g_scheduler.shutdown();
 		g_databaseTasks.shutdown();
+		g_worldSave.shutdown();
+		g_cryptoTasks.shutdown();
 		g_dispatcher.shutdown();
 	}
 
 	g_scheduler.join();
 	g_databaseTasks.join();
+	g_worldSave.join();
+	g_cryptoTasks.join();
 	g_dispatcher.join();
 	return 0;
 }
@@ -165,6 +175,8 @@ void mainLoader(int, char*[], ServiceManager* services)
 		return;
 	}
 
+	g_scheduler.setTimerWheel(g_config.getBoolean(ConfigManager::SCHEDULER_TIMER_WHEEL));
+
 #ifdef _WIN32
 	const std::string& defaultPriority = g_config.getString(ConfigManager::DEFAULT_PRIORITY);
 	if (strcasecmp(defaultPriority.c_str(), "high") == 0) {
@@ -178,6 +190,7 @@ void mainLoader(int, char*[], ServiceManager* services)
 	const char* p("14299623962416399520070177382898895550795403345466153217470516082934737582776038882967213386204600674145392845853859217990626450972452084065728686565928113");
 	const char* q("7630979195970404721891201847792002125535401292779123937207447574596692788513647179235335529307251350570728407373705564708871762033017096809910315212884101");
 	g_RSA.setKey(p, q);
+	g_cryptoTasks.start(std::max<int32_t>(0, g_config.getNumber(ConfigManager::LOGIN_CRYPTO_THREADS)));
 
 	std::cout << ">> Establishing database connection..." << std::flush;
 
@@ -196,7 +209,8 @@ void mainLoader(int, char*[], ServiceManager* services)
 		startupErrorMessage("The database you have specified in config.lua is empty, please import the schema.sql to your database.");
 		return;
 	}
-	g_databaseTasks.start();
+	g_databaseTasks.start(std::max<int32_t>(1, g_config.getNumber(ConfigManager::DATABASE_THREADS)));
+	g_worldSave.start();
 
 	DatabaseManager::updateDatabase();
 
@@ -23,21 +23,117 @@
 #include "protocol.h"
 #include "scheduler.h"
 
-const uint16_t OUTPUTMESSAGE_FREE_LIST_CAPACITY = 2048;
-const std::chrono::milliseconds OUTPUTMESSAGE_AUTOSEND_DELAY {10};
+// per thread and size class, half of it moves to or from the depot at once
+const size_t OUTPUTMESSAGE_CACHE_MESSAGES = 64;
+const size_t OUTPUTMESSAGE_CACHE_LARGE_BUFFERS = 8;
+// anything beyond this stays with the allocator
+const size_t OUTPUTMESSAGE_DEPOT_MESSAGES = 4096;
+const size_t OUTPUTMESSAGE_DEPOT_LARGE_BUFFERS = 256;
+
+// Messages are mostly taken on the dispatcher and dropped on the network
+// threads, so each thread keeps its own free lists and only the overflow or
+// refill goes through the shared depot.
+struct OutputMessageCache {
+	~OutputMessageCache();
+
+	std::vector<OutputMessage*> messages;
+	std::vector<uint8_t*> largeBuffers;
+};
+
+namespace {
+
+thread_local OutputMessageCache threadCache;
+// messages still dropped during thread or process exit bypass the cache
+thread_local bool threadCacheDestroyed = false;
+
+OutputMessageCache* getThreadCache()
+{
+	return threadCacheDestroyed ? nullptr : &threadCache;
+}
+
+template <typename T>
+void moveBlocks(std::vector<T*>& from, std::vector<T*>& to, size_t count)
+{
+	count = std::min(count, from.size());
+	to.insert(to.end(), from.end() - count, from.end());
+	from.resize(from.size() - count);
+}
+
+}
+
+OutputMessageCache::~OutputMessageCache()
+{
+	threadCacheDestroyed = true;
+
+	OutputMessagePool* pool = OutputMessagePool::getInstance();
+	std::lock_guard<std::mutex> lockClass(pool->depotLock);
+	pool->messageDepot.insert(pool->messageDepot.end(), messages.begin(), messages.end());
+	pool->largeBufferDepot.insert(pool->largeBufferDepot.end(), largeBuffers.begin(), largeBuffers.end());
+}
 
-OutputMessage::OutputMessage()
+OutputMessage::OutputMessage() : NetworkMessageBase(smallBuffer, OUTPUTMESSAGE_SMALL_SIZE)
 {
+	refCount = 0;
+	largeBuffer = nullptr;
 	freeMessage();
 }
 
+bool OutputMessage::grow(size_t size)
+{
+	if (largeBuffer || size >= static_cast<size_t>(max_body_length)) {
+		return false;
+	}
+
+	largeBuffer = OutputMessagePool::getInstance()->allocateLargeBuffer();
+	memcpy(largeBuffer, smallBuffer, position);
+	buffer = largeBuffer;
+	bufferLimit = max_body_length;
+	return true;
+}
+
+void OutputMessage::freeMessage()
+{
+	castFrames.clear();
+	setConnection(Connection_ptr());
+	setProtocol(nullptr);
+	frame = 0;
+
+	if (largeBuffer) {
+		OutputMessagePool::getInstance()->freeLargeBuffer(largeBuffer);
+		largeBuffer = nullptr;
+		buffer = smallBuffer;
+		bufferLimit = OUTPUTMESSAGE_SMALL_SIZE;
+	}
+
+	// Allocate enough size for headers:
+	// 2 bytes for unencrypted message size
+	// 4 bytes for checksum
+	// 2 bytes for encrypted message size
+	outputBufferStart = 8;
+
+	//setState have to be the last one
+	setState(OutputMessage::STATE_FREE);
+}
+
+void intrusive_ptr_add_ref(OutputMessage* msg)
+{
+	msg->refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void intrusive_ptr_release(OutputMessage* msg)
+{
+	if (msg->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		OutputMessagePool::getInstance()->releaseMessage(msg);
+	}
+}
+
 // OutputMessagePool
 
 OutputMessagePool::OutputMessagePool()
 {
+	messageDepot.reserve(OUTPUT_POOL_SIZE);
 	for (uint32_t i = 0; i < OUTPUT_POOL_SIZE; ++i) {
-		OutputMessage* msg = new OutputMessage();
-		outputMessages.push_back(msg);
+		messageDepot.push_back(new OutputMessage());
 	}
 
 	frameTime = OTSYS_TIME();
@@ -46,15 +142,86 @@ OutputMessagePool::OutputMessagePool()
 
 void OutputMessagePool::startExecutionFrame()
 {
-	//std::lock_guard<std::recursive_mutex> lockClass(outputPoolLock);
 	frameTime = OTSYS_TIME();
 }
 
 OutputMessagePool::~OutputMessagePool()
 {
-	for (OutputMessage* msg : outputMessages) {
+	autoSendOutputMessages.clear();
+
+	for (OutputMessage* msg : messageDepot) {
 		delete msg;
 	}
+
+	for (uint8_t* largeBuffer : largeBufferDepot) {
+		delete[] largeBuffer;
+	}
+}
+
+OutputMessage* OutputMessagePool::allocateMessage()
+{
+	OutputMessageCache* cache = getThreadCache();
+	if (!cache) {
+		return new OutputMessage();
+	}
+
+	std::vector<OutputMessage*>& messages = cache->messages;
+	if (messages.empty()) {
+		std::lock_guard<std::mutex> lockClass(depotLock);
+		moveBlocks(messageDepot, messages, OUTPUTMESSAGE_CACHE_MESSAGES / 2);
+	}
+
+	if (messages.empty()) {
+		return new OutputMessage();
+	}
+
+	OutputMessage* msg = messages.back();
+	messages.pop_back();
+	return msg;
+}
+
+uint8_t* OutputMessagePool::allocateLargeBuffer()
+{
+	OutputMessageCache* cache = getThreadCache();
+	if (!cache) {
+		return new uint8_t[NETWORKMESSAGE_MAXSIZE];
+	}
+
+	std::vector<uint8_t*>& largeBuffers = cache->largeBuffers;
+	if (largeBuffers.empty()) {
+		std::lock_guard<std::mutex> lockClass(depotLock);
+		moveBlocks(largeBufferDepot, largeBuffers, OUTPUTMESSAGE_CACHE_LARGE_BUFFERS / 2);
+	}
+
+	if (largeBuffers.empty()) {
+		return new uint8_t[NETWORKMESSAGE_MAXSIZE];
+	}
+
+	uint8_t* largeBuffer = largeBuffers.back();
+	largeBuffers.pop_back();
+	return largeBuffer;
+}
+
+void OutputMessagePool::freeLargeBuffer(uint8_t* largeBuffer)
+{
+	OutputMessageCache* cache = getThreadCache();
+	if (!cache) {
+		delete[] largeBuffer;
+		return;
+	}
+
+	std::vector<uint8_t*>& largeBuffers = cache->largeBuffers;
+	largeBuffers.push_back(largeBuffer);
+	if (largeBuffers.size() <= OUTPUTMESSAGE_CACHE_LARGE_BUFFERS) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lockClass(depotLock);
+	moveBlocks(largeBuffers, largeBufferDepot, OUTPUTMESSAGE_CACHE_LARGE_BUFFERS / 2);
+	while (largeBufferDepot.size() > OUTPUTMESSAGE_DEPOT_LARGE_BUFFERS) {
+		delete[] largeBufferDepot.back();
+		largeBufferDepot.pop_back();
+	}
 }
 
 void OutputMessagePool::send(OutputMessage_ptr msg)
@@ -77,26 +244,8 @@ void OutputMessagePool::sendAll()
 {
 	std::lock_guard<std::recursive_mutex> lockClass(outputPoolLock);
 
-	const int64_t dropTime = frameTime - 10000;
 	const int64_t staleTime = frameTime - 10;
 
-	for (OutputMessage_ptr msg : toAddQueue) {
-		const int64_t msgFrame = msg->getFrame();
-		if (msgFrame >= dropTime) {
-			msg->setState(OutputMessage::STATE_ALLOCATED);
-
-			if (msgFrame < staleTime) {
-				autoSendOutputMessages.push_front(msg);
-			} else {
-				autoSendOutputMessages.push_back(msg);
-			}
-		} else {
-			//drop messages that are older than 10 seconds
-			msg->getProtocol()->onSendMessage(msg);
-		}
-	}
-	toAddQueue.clear();
-
 	for (auto it = autoSendOutputMessages.begin(), end = autoSendOutputMessages.end(); it != end; it = autoSendOutputMessages.erase(it)) {
 		OutputMessage_ptr msg = *it;
 		if (staleTime <= msg->getFrame()) {
@@ -114,12 +263,7 @@ void OutputMessagePool::sendAll()
 
 void OutputMessagePool::releaseMessage(OutputMessage* msg)
 {
-	g_dispatcher.addTask(
-	    createTask(std::bind(&OutputMessagePool::internalReleaseMessage, this, msg)));
-}
-
-void OutputMessagePool::internalReleaseMessage(OutputMessage* msg)
-{
+	//any thread, whichever dropped the last reference
 	if (msg->getProtocol()) {
 		msg->getProtocol()->unRef();
 	} else {
@@ -134,9 +278,24 @@ void OutputMessagePool::internalReleaseMessage(OutputMessage* msg)
 
 	msg->freeMessage();
 
-	outputPoolLock.lock();
-	outputMessages.push_back(msg);
-	outputPoolLock.unlock();
+	OutputMessageCache* cache = getThreadCache();
+	if (!cache) {
+		delete msg;
+		return;
+	}
+
+	std::vector<OutputMessage*>& messages = cache->messages;
+	messages.push_back(msg);
+	if (messages.size() <= OUTPUTMESSAGE_CACHE_MESSAGES) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lockClass(depotLock);
+	moveBlocks(messages, messageDepot, OUTPUTMESSAGE_CACHE_MESSAGES / 2);
+	while (messageDepot.size() > OUTPUTMESSAGE_DEPOT_MESSAGES) {
+		delete messageDepot.back();
+		messageDepot.pop_back();
+	}
 }
 
 OutputMessage_ptr OutputMessagePool::getOutputMessage(Protocol* protocol, bool autosend /*= true*/)
@@ -145,23 +304,13 @@ OutputMessage_ptr OutputMessagePool::getOutputMessage(Protocol* protocol, bool a
 		return OutputMessage_ptr();
 	}
 
-	std::lock_guard<std::recursive_mutex> lockClass(outputPoolLock);
-
 	if (!protocol->getConnection()) {
 		return OutputMessage_ptr();
 	}
 
-	if (outputMessages.empty()) {
-		OutputMessage* msg = new OutputMessage();
-		outputMessages.push_back(msg);
-	}
-
-	OutputMessage_ptr outputmessage;
-	outputmessage.reset(outputMessages.back(),
-	                    std::bind(&OutputMessagePool::releaseMessage, this, std::placeholders::_1));
-
-	outputMessages.pop_back();
+	OutputMessage_ptr outputmessage(allocateMessage());
 
+	std::lock_guard<std::recursive_mutex> lockClass(outputPoolLock);
 	configureOutputMessage(outputmessage, protocol, autosend);
 	return outputmessage;
 }
@@ -188,10 +337,3 @@ void OutputMessagePool::configureOutputMessage(OutputMessage_ptr msg, Protocol*
 
 	msg->setFrame(frameTime);
 }
-
-void OutputMessagePool::addToAutoSend(OutputMessage_ptr msg)
-{
-	outputPoolLock.lock();
-	toAddQueue.push_back(msg);
-	outputPoolLock.unlock();
-}
@@ -28,7 +28,50 @@ class Protocol;
 
 #define OUTPUT_POOL_SIZE 100
 
-class OutputMessage : public NetworkMessage
+// Most frames fit the small buffer every message carries; login map
+// descriptions and similar bursts move to a pooled full size buffer.
+#define OUTPUTMESSAGE_SMALL_SIZE 4096
+
+// Broadcast bytes of a live cast, written once by the caster and shared by
+// all spectator messages. Bytes below getLength() are never modified while
+// a spectator message still holds the frame.
+class CastFrame
+{
+	public:
+		CastFrame() : length(0) {}
+
+		// non-copyable
+		CastFrame(const CastFrame&) = delete;
+		CastFrame& operator=(const CastFrame&) = delete;
+
+		bool canAppend(uint32_t size) const {
+			return length + size <= sizeof(buffer);
+		}
+
+		uint32_t append(const NetworkMessage& msg) {
+			uint32_t offset = length;
+			memcpy(buffer + length, msg.getBuffer() + 8, msg.getLength());
+			length += msg.getLength();
+			return offset;
+		}
+
+		const uint8_t* getBuffer() const {
+			return buffer;
+		}
+		uint32_t getLength() const {
+			return length;
+		}
+
+		void reset() {
+			length = 0;
+		}
+
+	protected:
+		uint8_t buffer[NETWORKMESSAGE_MAXSIZE];
+		uint32_t length;
+};
+
+class OutputMessage : public NetworkMessageBase
 {
 	private:
 		OutputMessage();
@@ -73,6 +116,10 @@ class OutputMessage : public NetworkMessage
 
 		inline void append(const NetworkMessage& msg) {
 			int32_t msgLen = msg.getLength();
+			if (!canAdd(msgLen)) {
+				return;
+			}
+
 			memcpy(buffer + position, msg.getBuffer() + 8, msgLen);
 			length += msgLen;
 			position += msgLen;
@@ -80,11 +127,47 @@ class OutputMessage : public NetworkMessage
 
 		inline void append(OutputMessage_ptr msg) {
 			int32_t msgLen = msg->getLength();
+			if (!canAdd(msgLen)) {
+				return;
+			}
+
 			memcpy(buffer + position, msg->getBuffer() + 8, msgLen);
 			length += msgLen;
 			position += msgLen;
 		}
 
+		// reserves room for a slice of a cast frame, filled in by copyCastFrames
+		void appendCastFrame(const CastFrame_ptr& castFrame, uint32_t offset, uint32_t size) {
+			if (!canAdd(size)) {
+				return;
+			}
+
+			if (!castFrames.empty()) {
+				CastFrameSlice& last = castFrames.back();
+				if (last.frame == castFrame && last.frameOffset + last.length == offset && last.position + last.length == static_cast<uint32_t>(position)) {
+					last.length += size;
+					length += size;
+					position += size;
+					return;
+				}
+			}
+
+			castFrames.push_back({castFrame, offset, static_cast<uint32_t>(position), size});
+			length += size;
+			position += size;
+		}
+
+		bool hasCastFrames() const {
+			return !castFrames.empty();
+		}
+
+		void copyCastFrames() {
+			for (const CastFrameSlice& slice : castFrames) {
+				memcpy(buffer + slice.position, slice.frame->getBuffer() + slice.frameOffset, slice.length);
+			}
+			castFrames.clear();
+		}
+
 		void setFrame(int64_t new_frame) {
 			frame = new_frame;
 		}
@@ -104,22 +187,13 @@ class OutputMessage : public NetworkMessage
 			length += sizeof(T);
 		}
 
-		void freeMessage() {
-			setConnection(Connection_ptr());
-			setProtocol(nullptr);
-			frame = 0;
-
-			// Allocate enough size for headers:
-			// 2 bytes for unencrypted message size
-			// 4 bytes for checksum
-			// 2 bytes for encrypted message size
-			outputBufferStart = 8;
+		bool grow(size_t size) override;
 
-			//setState have to be the last one
-			setState(OutputMessage::STATE_FREE);
-		}
+		void freeMessage();
 
 		friend class OutputMessagePool;
+		friend void intrusive_ptr_add_ref(OutputMessage* msg);
+		friend void intrusive_ptr_release(OutputMessage* msg);
 
 		void setProtocol(Protocol* protocol) {
 			m_protocol = protocol;
@@ -135,6 +209,15 @@ class OutputMessage : public NetworkMessage
 			return state;
 		}
 
+		struct CastFrameSlice {
+			CastFrame_ptr frame;
+			uint32_t frameOffset;
+			uint32_t position;
+			uint32_t length;
+		};
+
+		std::vector<CastFrameSlice> castFrames;
+
 		Connection_ptr connection;
 		Protocol* m_protocol;
 
@@ -142,6 +225,12 @@ class OutputMessage : public NetworkMessage
 		uint32_t outputBufferStart;
 
 		OutputMessageState state;
+
+		std::atomic<uint32_t> refCount;
+
+		// set while the message has outgrown smallBuffer
+		uint8_t* largeBuffer;
+		uint8_t smallBuffer[OUTPUTMESSAGE_SMALL_SIZE];
 };
 
 class OutputMessagePool
@@ -170,25 +259,33 @@ class OutputMessagePool
 		void startExecutionFrame();
 
 		int64_t getFrameTime() const {
-			return frameTime;
+			return frameTime.load(std::memory_order_relaxed);
 		}
 
-		void addToAutoSend(OutputMessage_ptr msg);
-
 	protected:
 		void configureOutputMessage(OutputMessage_ptr msg, Protocol* protocol, bool autosend);
 		void releaseMessage(OutputMessage* msg);
-		void internalReleaseMessage(OutputMessage* msg);
 
-		typedef std::list<OutputMessage*> InternalOutputMessageList;
+		OutputMessage* allocateMessage();
+		uint8_t* allocateLargeBuffer();
+		void freeLargeBuffer(uint8_t* largeBuffer);
+
+		friend class OutputMessage;
+		friend struct OutputMessageCache;
+		friend void intrusive_ptr_release(OutputMessage* msg);
+
 		typedef std::list<OutputMessage_ptr> OutputMessageMessageList;
 
-		InternalOutputMessageList outputMessages;
-		InternalOutputMessageList allOutputMessages;
 		OutputMessageMessageList autoSendOutputMessages;
-		OutputMessageMessageList toAddQueue;
 		std::recursive_mutex outputPoolLock;
-		int64_t frameTime;
-		bool m_open;
+
+		// shared between the per-thread caches, refilled and drained in batches
+		std::vector<OutputMessage*> messageDepot;
+		std::vector<uint8_t*> largeBufferDepot;
+		std::mutex depotLock;
+
+		std::atomic<int64_t> frameTime;
+		std::atomic<bool> m_open;
 };
+
 #endif
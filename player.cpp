@@ -118,6 +118,9 @@ Player::Player(ProtocolGame* p) :
 	inMarket = false;
 	lastDepotId = -1;
 
+	dirtySections = PLAYER_SAVE_NONE;
+	std::fill_n(itemsFingerprint, PLAYER_SAVE_ITEM_SECTIONS, 0);
+
 	hasLostConnection = false;
 
 	chaseMode = CHASEMODE_STANDSTILL;
@@ -813,6 +816,11 @@ void Player::addStorageValue(const uint32_t key, const int32_t value, const bool
 				value >> 16,
 				value & 0xFF
 			);
+
+			// as genReservedStorageRange would, so the next save sees it unchanged
+			if (isLogin) {
+				storageMap[key] = value;
+			}
 			return;
 		} else if (IS_IN_KEYRANGE(key, MOUNTS_RANGE)) {
 			// do nothing
@@ -829,14 +837,18 @@ void Player::addStorageValue(const uint32_t key, const int32_t value, const bool
 		storageMap[key] = value;
 
 		if (!isLogin) {
+			if (oldValue != value) {
+				dirtyStorageKeys.insert(key);
+			}
+
 			int64_t currentFrameTime = OutputMessagePool::getInstance()->getFrameTime();
 			if (lastQuestlogUpdate != currentFrameTime && g_game.quests.isQuestStorage(key, value, oldValue)) {
 				lastQuestlogUpdate = currentFrameTime;
 				sendTextMessage(MESSAGE_EVENT_ADVANCE, "Your questlog has been updated.");
 			}
 		}
-	} else {
-		storageMap.erase(key);
+	} else if (storageMap.erase(key) != 0 && !isLogin) {
+		dirtyStorageKeys.insert(key);
 	}
 }
 
@@ -3828,6 +3840,7 @@ bool Player::onKilledCreature(Creature* target, bool lastHit/* = true*/)
 					for (auto& kill : targetPlayer->unjustifiedKills) {
 						if (kill.target == getGUID() && kill.unavenged) {
 							kill.unavenged = false;
+							targetPlayer->dirtySections |= PLAYER_SAVE_KILLS;
 							auto it = attackedSet.find(targetPlayer->guid);
 							attackedSet.erase(it);
 							break;
@@ -3977,7 +3990,17 @@ void Player::genReservedStorageRange()
 	//generate outfits range
 	uint32_t base_key = PSTRG_OUTFITS_RANGE_START;
 	for (const OutfitEntry& entry : outfits) {
-		storageMap[++base_key] = (entry.lookType << 16) | entry.addons;
+		int32_t value = (entry.lookType << 16) | entry.addons;
+
+		auto it = storageMap.find(++base_key);
+		if (it == storageMap.end()) {
+			storageMap.emplace(base_key, value);
+		} else if (it->second != value) {
+			it->second = value;
+		} else {
+			continue;
+		}
+		dirtyStorageKeys.insert(base_key);
 	}
 }
 
@@ -4137,6 +4160,7 @@ void Player::addUnjustifiedDead(const Player* attacked)
 	sendTextMessage(MESSAGE_EVENT_ADVANCE, "Warning! The murder of " + attacked->getName() + " was not justified.");
 
 	unjustifiedKills.emplace_back(attacked->getGUID(), time(nullptr), true);
+	dirtySections |= PLAYER_SAVE_KILLS;
 
 	uint8_t dayKills = 0;
 	uint8_t weekKills = 0;
@@ -4224,12 +4248,14 @@ void Player::learnInstantSpell(const std::string& spellName)
 {
 	if (!hasLearnedInstantSpell(spellName)) {
 		learnedInstantSpellList.push_front(spellName);
+		dirtySections |= PLAYER_SAVE_SPELLS;
 	}
 }
 
 void Player::forgetInstantSpell(const std::string& spellName)
 {
 	learnedInstantSpellList.remove(spellName);
+	dirtySections |= PLAYER_SAVE_SPELLS;
 }
 
 bool Player::hasLearnedInstantSpell(const std::string& spellName) const
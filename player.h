@@ -144,6 +144,7 @@ typedef std::map<uint32_t, uint32_t> MuteCountMap;
 
 #define PLAYER_MAX_SPEED 3000
 #define PLAYER_MIN_SPEED 10
+#define PLAYER_SAVE_ITEM_SECTIONS 5
 
 class Player final : public Creature, public Cylinder
 {
@@ -1298,6 +1299,8 @@ class Player final : public Creature, public Cylinder
 		std::map<uint32_t, DepotChest*> depotChests;
 		std::map<uint32_t, DepotChest*> depotBoxs;
 		std::map<uint32_t, int32_t> storageMap;
+		// storage keys set or removed since the last save captured them
+		std::unordered_set<uint32_t> dirtyStorageKeys;
 
 		std::vector<OutfitEntry> outfits;
 		GuildWarList guildWarList;
@@ -1337,6 +1340,9 @@ class Player final : public Creature, public Cylinder
 
 		std::vector<Kill> unjustifiedKills;
 
+		// rows of each item table as last loaded or captured, see IOLoginData::trackItems
+		uint64_t itemsFingerprint[PLAYER_SAVE_ITEM_SECTIONS];
+
 		BedItem* bedItem;
 		Guild* guild;
 		Group* group;
@@ -1394,6 +1400,7 @@ class Player final : public Creature, public Cylinder
 
 		uint8_t soul;
 		uint8_t blessings;
+		uint8_t dirtySections;
 		uint8_t guildLevel;
 		uint8_t levelPercent;
 		uint8_t magLevelPercent;
@@ -24,23 +24,29 @@
 #include "connection.h"
 #include "outputmessage.h"
 #include "rsa.h"
+#include "xtea.h"
 
 extern RSA g_RSA;
 
 void Protocol::onSendMessage(OutputMessage_ptr msg)
 {
+	prepareMessage(*msg);
+	releaseOutputBuffer(msg);
+}
+
+void Protocol::prepareMessage(OutputMessage& msg) const
+{
+	//may run on the network thread, only touches the message and the session key
+	msg.copyCastFrames();
+
 	if (!m_rawMessages) {
-		msg->writeMessageLength();
+		msg.writeMessageLength();
 
 		if (m_encryptionEnabled) {
-			XTEA_encrypt(*msg);
-			msg->addCryptoHeader(m_checksumEnabled);
+			XTEA_encrypt(msg);
+			msg.addCryptoHeader(m_checksumEnabled);
 		}
 	}
-
-	if (msg == m_outputBuffer) {
-		m_outputBuffer.reset();
-	}
 }
 
 void Protocol::onRecvMessage(NetworkMessage& msg)
@@ -84,37 +90,13 @@ void Protocol::deleteProtocolTask()
 
 void Protocol::XTEA_encrypt(OutputMessage& msg) const
 {
-	const uint32_t delta = 0x61C88647;
-
 	// The message must be a multiple of 8
 	size_t paddingBytes = msg.getLength() % 8;
 	if (paddingBytes != 0) {
 		msg.addPaddingBytes(8 - paddingBytes);
 	}
 
-	uint8_t* buffer = msg.getOutputBuffer();
-	const size_t messageLength = msg.getLength();
-	size_t readPos = 0;
-	const uint32_t k[] = {m_key[0], m_key[1], m_key[2], m_key[3]};
-	while (readPos < messageLength) {
-		uint32_t v0;
-		memcpy(&v0, buffer + readPos, 4);
-		uint32_t v1;
-		memcpy(&v1, buffer + readPos + 4, 4);
-
-		uint32_t sum = 0;
-
-		for (int32_t i = 32; --i >= 0;) {
-			v0 += ((v1 << 4 ^ v1 >> 5) + v1) ^ (sum + k[sum & 3]);
-			sum -= delta;
-			v1 += ((v0 << 4 ^ v0 >> 5) + v0) ^ (sum + k[(sum >> 11) & 3]);
-		}
-
-		memcpy(buffer + readPos, &v0, 4);
-		readPos += 4;
-		memcpy(buffer + readPos, &v1, 4);
-		readPos += 4;
-	}
+	xteaEncrypt(msg.getOutputBuffer(), msg.getLength(), m_key);
 }
 
 bool Protocol::XTEA_decrypt(NetworkMessage& msg) const
@@ -123,31 +105,7 @@ bool Protocol::XTEA_decrypt(NetworkMessage& msg) const
 		return false;
 	}
 
-	const uint32_t delta = 0x61C88647;
-
-	uint8_t* buffer = msg.getBuffer() + msg.getBufferPosition();
-	const size_t messageLength = (msg.getLength() - 6);
-	size_t readPos = 0;
-	const uint32_t k[] = {m_key[0], m_key[1], m_key[2], m_key[3]};
-	while (readPos < messageLength) {
-		uint32_t v0;
-		memcpy(&v0, buffer + readPos, 4);
-		uint32_t v1;
-		memcpy(&v1, buffer + readPos + 4, 4);
-
-		uint32_t sum = 0xC6EF3720;
-
-		for (int32_t i = 32; --i >= 0;) {
-			v1 -= ((v0 << 4 ^ v0 >> 5) + v0) ^ (sum + k[(sum >> 11) & 3]);
-			sum += delta;
-			v0 -= ((v1 << 4 ^ v1 >> 5) + v1) ^ (sum + k[sum & 3]);
-		}
-
-		memcpy(buffer + readPos, &v0, 4);
-		readPos += 4;
-		memcpy(buffer + readPos, &v1, 4);
-		readPos += 4;
-	}
+	xteaDecrypt(msg.getBuffer() + msg.getBufferPosition(), msg.getLength() - 6, m_key);
 
 	int innerLength = msg.get<uint16_t>();
 	if (innerLength > msg.getLength() - 8) {
@@ -35,8 +35,19 @@ class Protocol
 		virtual void parsePacket(NetworkMessage&) {}
 
 		virtual void onSendMessage(OutputMessage_ptr msg);
+		void prepareMessage(OutputMessage& msg) const;
+		void releaseOutputBuffer(const OutputMessage_ptr& msg) {
+			if (msg == m_outputBuffer) {
+				m_outputBuffer.reset();
+			}
+		}
 		void onRecvMessage(NetworkMessage& msg);
 		virtual void onRecvFirstMessage(NetworkMessage& msg) = 0;
+		// whether the first message starts with an RSA block, those are
+		// handled on the crypto pool
+		virtual bool hasRSAFirstMessage() const {
+			return true;
+		}
 		virtual void onConnect() {}
 
 		Connection_ptr getConnection() const {
@@ -92,7 +103,7 @@ class Protocol
 	private:
 		Connection_ptr m_connection;
 		uint32_t m_key[4];
-		uint32_t m_refCount;
+		std::atomic<uint32_t> m_refCount;
 		bool m_encryptionEnabled;
 		bool m_checksumEnabled;
 		bool m_rawMessages;
@@ -19,6 +19,8 @@
 
 #include "otpch.h"
 
+#include <atomic>
+
 #include "protocolcaster.h"
 #include "protocolspectator.h"
 
@@ -121,6 +123,7 @@ bool ProtocolCaster::stopLiveCast()
 
 	std::swap(spectators, m_spectators);
 	m_isLiveCaster = false;
+	m_castFrame.reset();
 	m_liveCasts.erase(player);
 
 	for (auto& spectator : spectators) {
@@ -145,7 +148,8 @@ void ProtocolCaster::clearLiveCastInfo()
 		assert(g_game.getGameState() == GAME_STATE_INIT);
 		std::ostringstream query;
 		query << "DELETE FROM `live_casts`;";
-		g_databaseTasks.addTask(query.str());
+		// not queued, the keyed inserts of the first casts could overtake it
+		Database::getInstance()->executeQuery(query.str());
 	});
 }
 
@@ -155,14 +159,14 @@ void ProtocolCaster::registerLiveCast()
 	Database* db = Database::getInstance();
 	query << "INSERT into `live_casts` (`player_id`, `cast_name`, `password`) VALUES (" << player->getGUID() << ", "
 		<< db->escapeString(getLiveCastName()) << ", " << isPasswordProtected() << ");";
-	g_databaseTasks.addTask(query.str());
+	g_databaseTasks.addTask(query.str(), nullptr, false, player->getGUID());
 }
 
 void ProtocolCaster::unregisterLiveCast()
 {
 	std::ostringstream query;
 	query << "DELETE FROM `live_casts` WHERE `player_id`=" << player->getGUID() << ";";
-	g_databaseTasks.addTask(query.str());
+	g_databaseTasks.addTask(query.str(), nullptr, false, player->getGUID());
 }
 
 void ProtocolCaster::updateLiveCastInfo()
@@ -172,7 +176,7 @@ void ProtocolCaster::updateLiveCastInfo()
 	query << "UPDATE `live_casts` SET `cast_name`=" << db->escapeString(getLiveCastName()) << ", `password`="
 		<< isPasswordProtected() << ", `spectators`=" << getSpectatorCount()
 		<< " WHERE `player_id`=" << player->getGUID() << ";";
-	g_databaseTasks.addTask(query.str());
+	g_databaseTasks.addTask(query.str(), nullptr, false, player->getGUID());
 }
 
 void ProtocolCaster::addSpectator(ProtocolGame* spectatorClient)
@@ -203,6 +207,28 @@ void ProtocolCaster::removeSpectator(ProtocolGame* spectatorClient)
 	updateLiveCastInfo();
 }
 
+void ProtocolCaster::broadcastToSpectators(const NetworkMessage& msg)
+{
+	const uint32_t size = msg.getLength();
+	if (!m_castFrame || !m_castFrame->canAppend(size)) {
+		if (m_castFrame && m_castFrame.use_count() == 1) {
+			//every spectator already copied it out, recycle the frame.
+			//use_count() is a relaxed load: the fence orders the network
+			//threads' reads, which end in a releasing decrement, before the
+			//writes below
+			std::atomic_thread_fence(std::memory_order_acquire);
+			m_castFrame->reset();
+		} else {
+			m_castFrame = std::make_shared<CastFrame>();
+		}
+	}
+
+	const uint32_t offset = m_castFrame->append(msg);
+	for (auto& spectator : m_spectators) {
+		spectator->writeToOutputBuffer(m_castFrame, offset, size);
+	}
+}
+
 ProtocolGame* ProtocolCaster::getSpectatorByName(std::string name)
 {
 	std::string tmpName = name;
@@ -148,14 +148,17 @@ class ProtocolCaster : public ProtocolGame
 			if (!m_isLiveCaster)
 				return;
 
-			if (!broadcast)
+			if (!broadcast || m_spectators.empty())
 				return;
 
-			for (auto& spectator : m_spectators) {
-				spectator->writeToOutputBuffer(msg, broadcast);
-			}
+			broadcastToSpectators(msg);
 		}
 
+		/** \brief Copies a message into the shared cast frame once and queues it for every spectator.
+		 *  \param msg message to broadcast
+		 */
+		void broadcastToSpectators(const NetworkMessage& msg);
+
 	private:
 
 		void releaseProtocol() override;
@@ -171,6 +174,9 @@ class ProtocolCaster : public ProtocolGame
 		///< list of spectators \warning This variable should only be accessed after locking \ref liveCastLock
 		CastSpectatorVec m_spectators;
 
+		///< frame currently being filled with broadcast messages, shared with the spectators' output messages
+		CastFrame_ptr m_castFrame;
+
 		// just to name spectators with a number
 		uint32_t m_spectatorsCount;
 
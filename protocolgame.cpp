@@ -57,15 +57,19 @@ extern CreatureEvents* g_creatureEvents;
 extern Chat* g_chat;
 extern Store* g_store;
 
+// opcode of the packet being parsed on this thread, game tasks are tagged with it
+static thread_local uint8_t parsingOpcode = 0;
+
 // Helping templates to add dispatcher tasks
 
 template<class FunctionType>
-void ProtocolGame::addGameTaskInternal(bool droppable, uint32_t delay, const FunctionType& func)
+void ProtocolGame::addGameTaskInternal(bool droppable, uint32_t delay, FunctionType&& func)
 {
+	// the bound call is moved straight into the pooled task's inline storage
 	if (droppable) {
-		g_dispatcher.addTask(createTask(delay, func));
+		g_dispatcher.addTask(createTask(delay, std::forward<FunctionType>(func), TASK_CATEGORY_PACKET, parsingOpcode));
 	} else {
-		g_dispatcher.addTask(createTask(func));
+		g_dispatcher.addTask(createTask(std::forward<FunctionType>(func), TASK_CATEGORY_PACKET, parsingOpcode));
 	}
 }
 
@@ -497,6 +501,14 @@ void ProtocolGame::writeToOutputBuffer(const NetworkMessage& msg, bool broadcast
 	}
 }
 
+void ProtocolGame::writeToOutputBuffer(const CastFrame_ptr& castFrame, uint32_t offset, uint32_t size)
+{
+	OutputMessage_ptr out = getOutputBuffer(size);
+	if (out) {
+		out->appendCastFrame(castFrame, offset, size);
+	}
+}
+
 void ProtocolGame::parsePacket(NetworkMessage& msg)
 {
 	if (!m_acceptPackets || g_game.getGameState() == GAME_STATE_SHUTDOWN || msg.getLength() <= 0) {
@@ -524,8 +536,9 @@ void ProtocolGame::parsePacket(NetworkMessage& msg)
 			return;
 		}
 	}
+	parsingOpcode = recvbyte;
 		switch (recvbyte) {
-		case 0x14: g_dispatcher.addTask(createTask(std::bind(&ProtocolGame::logout, this, true, false))); break;
+		case 0x14: g_dispatcher.addTask(createTask(std::bind(&ProtocolGame::logout, this, true, false), TASK_CATEGORY_PACKET, recvbyte)); break;
 		case 0x1D: addGameTask(&Game::playerReceivePingBack, player->getID()); break;
 		case 0x1E: addGameTask(&Game::playerReceivePing, player->getID()); break;
 		case 0x32: parseExtendedOpcode(msg); break; //otclient extended opcode
@@ -618,6 +631,7 @@ void ProtocolGame::parsePacket(NetworkMessage& msg)
 			// std::cout << "Player: " << player->getName() << " sent an unknown packet header: 0x" << std::hex << static_cast<uint16_t>(recvbyte) << std::dec << "!" << std::endl;
 			break;
 	}
+	parsingOpcode = 0;
 
 	if (msg.isOverrun()) {
 		disconnect();
@@ -625,27 +639,61 @@ void ProtocolGame::parsePacket(NetworkMessage& msg)
 }
 
 
-void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
+static const TileItemCache& getTileItemCache(const Tile* tile)
 {
-	msg.add<uint16_t>(0x00); //environmental effects
+	TileItemCache* cache = tile->getItemCache();
+	if (cache && cache->version == tile->getItemVersion()) {
+		return *cache;
+	}
+
+	cache = tile->makeItemCache();
+
+	NetworkMessage itemMsg;
+	uint8_t count = 0;
+	auto addItem = [&](const Item* item) {
+		itemMsg.addItem(item);
+		cache->ends[count++] = itemMsg.getLength();
+	};
 
-	int32_t count;
 	Item* ground = tile->getGround();
 	if (ground) {
-		msg.addItem(ground);
-		count = 1;
-	} else {
-		count = 0;
+		addItem(ground);
 	}
 
 	const TileItemVector* items = tile->getItemList();
 	if (items) {
-		for (auto it = items->getBeginTopItem(), end = items->getEndTopItem(); it != end; ++it) {
-			msg.addItem(*it);
+		for (auto it = items->getBeginTopItem(), end = items->getEndTopItem(); it != end && count < TileItemCache::max_items; ++it) {
+			addItem(*it);
+		}
+	}
 
-			if (++count == 10) {
-				return;
-			}
+	cache->topCount = count;
+
+	if (items) {
+		for (auto it = items->getBeginDownItem(), end = items->getEndDownItem(); it != end && count < TileItemCache::max_items; ++it) {
+			addItem(*it);
+		}
+	}
+
+	cache->count = count;
+	memcpy(cache->data, itemMsg.getBuffer() + itemMsg.getBufferPosition() - itemMsg.getLength(), itemMsg.getLength());
+	cache->version = tile->getItemVersion();
+	return *cache;
+}
+
+void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
+{
+	msg.add<uint16_t>(0x00); //environmental effects
+
+	// items look the same to everyone and are copied from the tile's cache
+	const TileItemCache& cache = getTileItemCache(tile);
+
+	int32_t count = cache.topCount;
+	if (count != 0) {
+		msg.addBytes(reinterpret_cast<const char*>(cache.data), cache.ends[count - 1]);
+
+		if (count == TileItemCache::max_items) {
+			return;
 		}
 	}
 
@@ -667,14 +715,11 @@ void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
 		}
 	}
 
-	if (items) {
-		for (auto it = items->getBeginDownItem(), end = items->getEndDownItem(); it != end; ++it) {
-			msg.addItem(*it);
-
-			if (++count == 10) {
-				return;
-			}
-		}
+	int32_t downCount = std::min<int32_t>(cache.count - cache.topCount, TileItemCache::max_items - count);
+	if (downCount > 0) {
+		int32_t begin = cache.topCount != 0 ? cache.ends[cache.topCount - 1] : 0;
+		int32_t end = cache.ends[cache.topCount + downCount - 1];
+		msg.addBytes(reinterpret_cast<const char*>(cache.data) + begin, end - begin);
 	}
 }
 
@@ -99,6 +99,7 @@ protected:
 		void disconnect() const;
 		virtual void disconnectClient(const std::string& message);
 		virtual void writeToOutputBuffer(const NetworkMessage& msg, bool broadcast = true);
+		void writeToOutputBuffer(const CastFrame_ptr& castFrame, uint32_t offset, uint32_t size);
 
 		void releaseProtocol();
 		void deleteProtocolTask();
@@ -360,7 +361,7 @@ protected:
 #define addGameTaskTimed(delay, f, ...) ProtocolGame::addGameTaskInternal(true, delay, std::bind(f, &g_game, __VA_ARGS__))
 
 		template<class FunctionType>
-		static void addGameTaskInternal(bool droppable, uint32_t delay, const FunctionType&);
+		static void addGameTaskInternal(bool droppable, uint32_t delay, FunctionType&& func);
 
 		Player* player;
 
@@ -27,11 +27,15 @@
 #include "outputmessage.h"
 #include "tools.h"
 #include "tasks.h"
+#include "scheduler.h"
+#include "taskstats.h"
+#include "databasetasks.h"
 
 extern ConfigManager g_config;
 extern Game g_game;
 
 std::map<uint32_t, int64_t> ProtocolStatus::ipConnectMap;
+std::mutex ProtocolStatus::ipConnectMapLock;
 const uint64_t ProtocolStatus::start = OTSYS_TIME();
 
 enum RequestedInfo_t : uint16_t {
@@ -43,23 +47,37 @@ enum RequestedInfo_t : uint16_t {
 	REQUEST_EXT_PLAYERS_INFO = 1 << 5,
 	REQUEST_PLAYER_STATUS_INFO = 1 << 6,
 	REQUEST_SERVER_SOFTWARE_INFO = 1 << 7,
+	REQUEST_TASK_STATS_INFO = 1 << 8,
 };
 
+static void addHistogram(const OutputMessage_ptr& output, const HistogramSnapshot& histogram)
+{
+	output->add<uint64_t>(histogram.count);
+	output->add<uint32_t>(std::min<uint64_t>(histogram.getPercentile(0.5), std::numeric_limits<uint32_t>::max()));
+	output->add<uint32_t>(std::min<uint64_t>(histogram.getPercentile(0.9), std::numeric_limits<uint32_t>::max()));
+	output->add<uint32_t>(std::min<uint64_t>(histogram.getPercentile(0.99), std::numeric_limits<uint32_t>::max()));
+	output->add<uint32_t>(std::min<uint64_t>(histogram.max, std::numeric_limits<uint32_t>::max()));
+}
+
 void ProtocolStatus::onRecvFirstMessage(NetworkMessage& msg)
 {
 	uint32_t ip = getIP();
-	if (ip != 0x0100007F) {
-		std::string ipStr = convertIPToString(ip);
-		if (ipStr != g_config.getString(ConfigManager::IP)) {
-			std::map<uint32_t, int64_t>::const_iterator it = ipConnectMap.find(ip);
-			if (it != ipConnectMap.end() && (OTSYS_TIME() < (it->second + g_config.getNumber(ConfigManager::STATUSQUERY_TIMEOUT)))) {
-				getConnection()->close();
-				return;
+	{
+		//network threads may accept status requests concurrently
+		std::lock_guard<std::mutex> lockClass(ipConnectMapLock);
+		if (ip != 0x0100007F) {
+			std::string ipStr = convertIPToString(ip);
+			if (ipStr != g_config.getString(ConfigManager::IP)) {
+				std::map<uint32_t, int64_t>::const_iterator it = ipConnectMap.find(ip);
+				if (it != ipConnectMap.end() && (OTSYS_TIME() < (it->second + g_config.getNumber(ConfigManager::STATUSQUERY_TIMEOUT)))) {
+					getConnection()->close();
+					return;
+				}
 			}
 		}
-	}
 
-	ipConnectMap[ip] = OTSYS_TIME();
+		ipConnectMap[ip] = OTSYS_TIME();
+	}
 
 	switch (msg.getByte()) {
 		//XML info protocol
@@ -234,6 +252,53 @@ void ProtocolStatus::sendInfo(uint16_t requestedInfo, const std::string& charact
 		output->addString(STATUS_SERVER_VERSION);
 		output->addString(CLIENT_VERSION_STR);
 	}
+
+	if (requestedInfo & REQUEST_TASK_STATS_INFO) {
+		output->addByte(0x24); // dispatcher statistics since startup, in microseconds
+
+		std::unique_ptr<TaskStatsSnapshot> stats(new TaskStatsSnapshot);
+		g_taskStats.snapshot(*stats);
+
+		output->addByte(TASK_CATEGORY_LAST + 1);
+		for (int category = TASK_CATEGORY_OTHER; category <= TASK_CATEGORY_LAST; ++category) {
+			output->addString(TaskStats::getCategoryName(static_cast<TaskCategory>(category)));
+			output->add<uint64_t>(stats->expired[category]);
+			addHistogram(output, stats->queueDelay[category]);
+			addHistogram(output, stats->executionTime[category]);
+		}
+
+		addHistogram(output, stats->schedulerLateness);
+		addHistogram(output, stats->queueDepth);
+		output->add<uint32_t>(g_dispatcher.getQueueDepth());
+		output->add<uint32_t>(g_scheduler.getPendingEvents());
+
+		// opcodes by total execution time
+		std::vector<uint8_t> opcodes;
+		for (size_t opcode = 0; opcode < 256; ++opcode) {
+			if (stats->opcodeCount[opcode] != 0) {
+				opcodes.push_back(opcode);
+			}
+		}
+		std::sort(opcodes.begin(), opcodes.end(), [&stats](uint8_t lhs, uint8_t rhs) {
+			return stats->opcodeTime[lhs] > stats->opcodeTime[rhs];
+		});
+		if (opcodes.size() > 10) {
+			opcodes.resize(10);
+		}
+
+		output->addByte(opcodes.size());
+		for (uint8_t opcode : opcodes) {
+			output->addByte(opcode);
+			output->add<uint64_t>(stats->opcodeCount[opcode]);
+			output->add<uint64_t>(stats->opcodeTime[opcode]);
+		}
+
+		// asynchronous database queries
+		addHistogram(output, stats->databaseQueueDelay);
+		addHistogram(output, stats->databaseQueryTime);
+		addHistogram(output, stats->databaseQueueDepth);
+		output->add<uint32_t>(g_databaseTasks.getQueueDepth());
+	}
 	OutputMessagePool::getInstance()->send(output);
 	getConnection()->close();
 }
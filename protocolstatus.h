@@ -37,6 +37,9 @@ class ProtocolStatus final : public Protocol
 		explicit ProtocolStatus(Connection_ptr connection) : Protocol(connection) {}
 
 		void onRecvFirstMessage(NetworkMessage& msg) final;
+		bool hasRSAFirstMessage() const final {
+			return false;
+		}
 
 		void sendStatusString();
 		void sendInfo(uint16_t requestedInfo, const std::string& characterName);
@@ -45,6 +48,7 @@ class ProtocolStatus final : public Protocol
 
 	protected:
 		static std::map<uint32_t, int64_t> ipConnectMap;
+		static std::mutex ipConnectMapLock;
 };
 
 #endif
@@ -32,14 +32,16 @@ class RSA
 		RSA(const RSA&) = delete;
 		RSA& operator=(const RSA&) = delete;
 
+		// must be called before any decrypt, the key is read without locking
 		void setKey(const char* p, const char* q);
-		void decrypt(char* msg);
+		void decrypt(char* msg) const;
 
 	protected:
-		std::recursive_mutex lock;
-
 		//use only GMP
 		mpz_t m_n, m_d;
+
+		// CRT parameters: dp = d mod (p - 1), dq = d mod (q - 1), qinv = q^-1 mod p
+		mpz_t m_p, m_q, m_dp, m_dq, m_qinv;
 };
 
 #endif
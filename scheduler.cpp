@@ -20,10 +20,241 @@
 #include "otpch.h"
 
 #include "scheduler.h"
+#include "taskstats.h"
+
+static size_t findFirstBit(const uint64_t* words, size_t from)
+{
+	for (size_t i = from; i < SCHEDULER_WHEEL_SIZE; i = (i & ~static_cast<size_t>(63)) + 64) {
+		uint64_t bits = words[i / 64] >> (i % 64);
+		if (bits == 0) {
+			continue;
+		}
+
+		while ((bits & 1) == 0) {
+			bits >>= 1;
+			++i;
+		}
+		return i;
+	}
+	return SCHEDULER_WHEEL_SIZE;
+}
+
+TimerWheel::TimerWheel()
+{
+	m_start = std::chrono::system_clock::now();
+	m_currentTick = 0;
+	m_size = 0;
+
+	for (uint8_t level = 0; level < SCHEDULER_WHEEL_LEVELS; ++level) {
+		for (size_t slot = 0; slot < SCHEDULER_WHEEL_SIZE; ++slot) {
+			m_slots[level][slot] = nullptr;
+		}
+
+		for (size_t word = 0; word < SCHEDULER_WHEEL_SIZE / 64; ++word) {
+			m_occupied[level][word] = 0;
+		}
+	}
+}
+
+uint64_t TimerWheel::getTick(std::chrono::system_clock::time_point time, bool roundUp) const
+{
+	const std::chrono::milliseconds tickDuration(SCHEDULER_WHEEL_TICK);
+
+	auto elapsed = time - m_start;
+	if (elapsed <= elapsed.zero()) {
+		return 0;
+	}
+
+	uint64_t tick = elapsed / tickDuration;
+	if (roundUp && elapsed % tickDuration != elapsed.zero()) {
+		++tick;
+	}
+	return tick;
+}
+
+std::chrono::system_clock::time_point TimerWheel::getTickTime(uint64_t tick) const
+{
+	return m_start + std::chrono::milliseconds(tick * SCHEDULER_WHEEL_TICK);
+}
+
+void TimerWheel::insert(SchedulerTask* task)
+{
+	link(task, getTick(task->getCycle(), true));
+	++m_size;
+}
+
+void TimerWheel::remove(SchedulerTask* task)
+{
+	unlink(task);
+	--m_size;
+}
+
+void TimerWheel::link(SchedulerTask* task, uint64_t tick)
+{
+	if (tick < m_currentTick) {
+		tick = m_currentTick;
+	}
+
+	// pick the lowest level whose span still covers the remaining delay
+	uint64_t delta = tick - m_currentTick;
+	uint8_t level = 0;
+	while (level + 1 < SCHEDULER_WHEEL_LEVELS && delta >= (static_cast<uint64_t>(1) << ((level + 1) * SCHEDULER_WHEEL_BITS))) {
+		++level;
+	}
+
+	const uint64_t maxDelta = (static_cast<uint64_t>(1) << (SCHEDULER_WHEEL_LEVELS * SCHEDULER_WHEEL_BITS)) - 1;
+	if (delta > maxDelta) {
+		tick = m_currentTick + maxDelta;
+	}
+
+	uint8_t slot = (tick >> (level * SCHEDULER_WHEEL_BITS)) & SCHEDULER_WHEEL_MASK;
+
+	SchedulerTask*& head = m_slots[level][slot];
+	task->m_wheelLevel = level;
+	task->m_wheelSlot = slot;
+	task->m_wheelPrev = nullptr;
+	task->m_wheelNext = head;
+	if (head) {
+		head->m_wheelPrev = task;
+	}
+	head = task;
+
+	m_occupied[level][slot / 64] |= static_cast<uint64_t>(1) << (slot % 64);
+}
+
+void TimerWheel::unlink(SchedulerTask* task)
+{
+	uint8_t level = task->m_wheelLevel;
+	uint8_t slot = task->m_wheelSlot;
+
+	if (task->m_wheelPrev) {
+		task->m_wheelPrev->m_wheelNext = task->m_wheelNext;
+	} else {
+		m_slots[level][slot] = task->m_wheelNext;
+	}
+
+	if (task->m_wheelNext) {
+		task->m_wheelNext->m_wheelPrev = task->m_wheelPrev;
+	}
+
+	task->m_wheelPrev = nullptr;
+	task->m_wheelNext = nullptr;
+
+	if (!m_slots[level][slot]) {
+		m_occupied[level][slot / 64] &= ~(static_cast<uint64_t>(1) << (slot % 64));
+	}
+}
+
+void TimerWheel::cascade(uint8_t level, uint8_t slot)
+{
+	SchedulerTask* task = m_slots[level][slot];
+	m_slots[level][slot] = nullptr;
+	m_occupied[level][slot / 64] &= ~(static_cast<uint64_t>(1) << (slot % 64));
+
+	while (task) {
+		SchedulerTask* next = task->m_wheelNext;
+		link(task, getTick(task->getCycle(), true));
+		task = next;
+	}
+}
+
+void TimerWheel::advance(std::chrono::system_clock::time_point now, std::vector<SchedulerTask*>& expired)
+{
+	uint64_t nowTick = getTick(now, false);
+	size_t first = expired.size();
+
+	while (m_size != 0 && m_currentTick <= nowTick) {
+		uint8_t index = m_currentTick & SCHEDULER_WHEEL_MASK;
+		if (index == 0) {
+			// level 0 wrapped, pull the next slot of each upper level down
+			for (uint8_t level = 1; level < SCHEDULER_WHEEL_LEVELS; ++level) {
+				uint8_t slot = (m_currentTick >> (level * SCHEDULER_WHEEL_BITS)) & SCHEDULER_WHEEL_MASK;
+				cascade(level, slot);
+				if (slot != 0) {
+					break;
+				}
+			}
+		}
+
+		SchedulerTask* task = m_slots[0][index];
+		m_slots[0][index] = nullptr;
+		m_occupied[0][index / 64] &= ~(static_cast<uint64_t>(1) << (index % 64));
+
+		while (task) {
+			SchedulerTask* next = task->m_wheelNext;
+			task->m_wheelPrev = nullptr;
+			task->m_wheelNext = nullptr;
+			expired.push_back(task);
+			--m_size;
+			task = next;
+		}
+
+		++m_currentTick;
+	}
+
+	// nothing left to cascade, so idle ticks can be skipped
+	if (m_size == 0 && m_currentTick <= nowTick) {
+		m_currentTick = nowTick + 1;
+	}
+
+	std::sort(expired.begin() + first, expired.end(), [](const SchedulerTask* lhs, const SchedulerTask* rhs) {
+		if (lhs->getCycle() != rhs->getCycle()) {
+			return lhs->getCycle() < rhs->getCycle();
+		}
+		return lhs->getEventId() < rhs->getEventId();
+	});
+}
+
+void TimerWheel::clear(std::vector<SchedulerTask*>& tasks)
+{
+	for (uint8_t level = 0; level < SCHEDULER_WHEEL_LEVELS; ++level) {
+		for (size_t slot = 0; slot < SCHEDULER_WHEEL_SIZE; ++slot) {
+			SchedulerTask* task = m_slots[level][slot];
+			while (task) {
+				SchedulerTask* next = task->m_wheelNext;
+				task->m_wheelPrev = nullptr;
+				task->m_wheelNext = nullptr;
+				tasks.push_back(task);
+				task = next;
+			}
+			m_slots[level][slot] = nullptr;
+		}
+
+		for (size_t word = 0; word < SCHEDULER_WHEEL_SIZE / 64; ++word) {
+			m_occupied[level][word] = 0;
+		}
+	}
+	m_size = 0;
+}
+
+std::chrono::system_clock::time_point TimerWheel::getNextWakeup() const
+{
+	size_t index = m_currentTick & SCHEDULER_WHEEL_MASK;
+
+	size_t slot = findFirstBit(m_occupied[0], index);
+	if (slot != SCHEDULER_WHEEL_SIZE) {
+		return getTickTime(m_currentTick + (slot - index));
+	}
+
+	// the next level 0 wrap either cascades upper levels or reaches the wrapped slots
+	uint64_t wrapTick = (m_currentTick | SCHEDULER_WHEEL_MASK) + 1;
+	for (uint8_t level = 1; level < SCHEDULER_WHEEL_LEVELS; ++level) {
+		if (findFirstBit(m_occupied[level], 0) != SCHEDULER_WHEEL_SIZE) {
+			return getTickTime(wrapTick);
+		}
+	}
+
+	slot = findFirstBit(m_occupied[0], 0);
+	if (slot != SCHEDULER_WHEEL_SIZE) {
+		return getTickTime(wrapTick + slot);
+	}
+	return getTickTime(m_currentTick);
+}
 
 Scheduler::Scheduler()
 {
 	m_lastEventId = 0;
+	m_useWheel = false;
 	m_threadState = STATE_TERMINATED;
 }
 
@@ -40,14 +271,21 @@ void Scheduler::schedulerThread()
 		std::cv_status ret = std::cv_status::no_timeout;
 
 		eventLockUnique.lock();
+		if (m_useWheel) {
+			wheelThreadStep(eventLockUnique);
+			continue;
+		}
+
 		if (m_eventList.empty()) {
 			m_eventSignal.wait(eventLockUnique);
 		} else {
 			ret = m_eventSignal.wait_until(eventLockUnique, m_eventList.top()->getCycle());
 		}
 
-		// the mutex is locked again now...
-		if (ret == std::cv_status::timeout && m_threadState != STATE_TERMINATED) {
+		// the mutex is locked again now, but setTimerWheel may have moved the
+		// events to the wheel or swapped the top while we were waiting
+		if (ret == std::cv_status::timeout && m_threadState != STATE_TERMINATED && !m_useWheel && !m_eventList.empty()
+		        && m_eventList.top()->getCycle() <= std::chrono::system_clock::now()) {
 			// ok we had a timeout, so there has to be an event we have to execute...
 			SchedulerTask* task = m_eventList.top();
 			m_eventList.pop();
@@ -62,6 +300,8 @@ void Scheduler::schedulerThread()
 			m_eventIds.erase(it);
 			eventLockUnique.unlock();
 
+			g_taskStats.recordSchedulerLateness(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - task->getCycle()).count());
+
 			task->setDontExpire();
 			g_dispatcher.addTask(task, true);
 		} else {
@@ -70,6 +310,38 @@ void Scheduler::schedulerThread()
 	}
 }
 
+void Scheduler::wheelThreadStep(std::unique_lock<std::mutex>& eventLockUnique)
+{
+	if (m_wheel.empty()) {
+		m_eventSignal.wait(eventLockUnique);
+	} else {
+		m_eventSignal.wait_until(eventLockUnique, m_wheel.getNextWakeup());
+	}
+
+	// the mutex is locked again now...
+	if (m_threadState == STATE_TERMINATED || !m_useWheel) {
+		eventLockUnique.unlock();
+		return;
+	}
+
+	const auto now = std::chrono::system_clock::now();
+	m_wheel.advance(now, m_wheelExpired);
+	for (SchedulerTask* task : m_wheelExpired) {
+		g_taskStats.recordSchedulerLateness(std::chrono::duration_cast<std::chrono::microseconds>(now - task->getCycle()).count());
+		m_wheelEvents.erase(task->getEventId());
+		task->setDontExpire();
+		m_wheelBatch.push_back(task);
+	}
+	m_wheelExpired.clear();
+	eventLockUnique.unlock();
+
+	// everything that expired within the same tick is handed over at once
+	if (!m_wheelBatch.empty()) {
+		g_dispatcher.addTasks(m_wheelBatch, true);
+		m_wheelBatch.clear();
+	}
+}
+
 uint32_t Scheduler::addEvent(SchedulerTask* task)
 {
 	bool do_signal = false;
@@ -86,15 +358,23 @@ uint32_t Scheduler::addEvent(SchedulerTask* task)
 			task->setEventId(m_lastEventId);
 		}
 
-		// insert the eventid in the list of active events
-		m_eventIds.insert(task->getEventId());
+		if (m_useWheel) {
+			// signal only if the thread would otherwise sleep past this event
+			do_signal = m_wheel.empty() || task->getCycle() < m_wheel.getNextWakeup();
+
+			m_wheelEvents[task->getEventId()] = task;
+			m_wheel.insert(task);
+		} else {
+			// insert the eventid in the list of active events
+			m_eventIds.insert(task->getEventId());
 
-		// add the event to the queue
-		m_eventList.push(task);
+			// add the event to the queue
+			m_eventList.push(task);
 
-		// if the list was empty or this event is the top in the list
-		// we have to signal it
-		do_signal = (task == m_eventList.top());
+			// if the list was empty or this event is the top in the list
+			// we have to signal it
+			do_signal = (task == m_eventList.top());
+		}
 	} else {
 		m_eventLock.unlock();
 		delete task;
@@ -116,7 +396,23 @@ bool Scheduler::stopEvent(uint32_t eventid)
 		return false;
 	}
 
-	std::lock_guard<std::mutex> lockGuard(m_eventLock);
+	std::unique_lock<std::mutex> eventLockUnique(m_eventLock);
+
+	if (m_useWheel) {
+		auto it = m_wheelEvents.find(eventid);
+		if (it == m_wheelEvents.end()) {
+			return false;
+		}
+
+		// the wheel supports real removal, so the task is freed right away
+		SchedulerTask* task = it->second;
+		m_wheelEvents.erase(it);
+		m_wheel.remove(task);
+		eventLockUnique.unlock();
+
+		delete task;
+		return true;
+	}
 
 	// search the event id..
 	auto it = m_eventIds.find(eventid);
@@ -147,10 +443,63 @@ void Scheduler::shutdown()
 	}
 
 	m_eventIds.clear();
+
+	std::vector<SchedulerTask*> tasks;
+	m_wheel.clear(tasks);
+	for (SchedulerTask* task : tasks) {
+		delete task;
+	}
+
+	m_wheelEvents.clear();
+	m_eventLock.unlock();
+	m_eventSignal.notify_one();
+}
+
+void Scheduler::setTimerWheel(bool enabled)
+{
+	m_eventLock.lock();
+	if (m_useWheel == enabled) {
+		m_eventLock.unlock();
+		return;
+	}
+
+	if (enabled) {
+		while (!m_eventList.empty()) {
+			SchedulerTask* task = m_eventList.top();
+			m_eventList.pop();
+
+			// drop the events that were already stopped
+			if (m_eventIds.erase(task->getEventId()) == 0) {
+				delete task;
+				continue;
+			}
+
+			m_wheelEvents[task->getEventId()] = task;
+			m_wheel.insert(task);
+		}
+		m_eventIds.clear();
+	} else {
+		std::vector<SchedulerTask*> tasks;
+		m_wheel.clear(tasks);
+		for (SchedulerTask* task : tasks) {
+			m_eventIds.insert(task->getEventId());
+			m_eventList.push(task);
+		}
+		m_wheelEvents.clear();
+	}
+
+	m_useWheel = enabled;
 	m_eventLock.unlock();
 	m_eventSignal.notify_one();
 }
 
+size_t Scheduler::getPendingEvents()
+{
+	std::lock_guard<std::mutex> lockGuard(m_eventLock);
+	// the heap still holds stopped events, the id set does not
+	return m_useWheel ? m_wheelEvents.size() : m_eventIds.size();
+}
+
 void Scheduler::join()
 {
 	m_thread.join();
@@ -28,6 +28,14 @@
 
 #define SCHEDULER_MINTICKS 50
 
+// timer wheel resolution (in milliseconds) and layout: 4 levels of 256 slots
+// cover the whole uint32_t range of ticks
+#define SCHEDULER_WHEEL_TICK 10
+#define SCHEDULER_WHEEL_BITS 8
+#define SCHEDULER_WHEEL_SIZE (1 << SCHEDULER_WHEEL_BITS)
+#define SCHEDULER_WHEEL_MASK (SCHEDULER_WHEEL_SIZE - 1)
+#define SCHEDULER_WHEEL_LEVELS 4
+
 class SchedulerTask : public Task
 {
 	public:
@@ -47,18 +55,42 @@ class SchedulerTask : public Task
 		}
 
 	protected:
-		SchedulerTask(uint32_t delay, const std::function<void (void)>& f) : Task(delay, f) {
+		template<typename F>
+		SchedulerTask(uint32_t delay, F&& f) : Task(delay, std::forward<F>(f)) {
 			m_eventid = 0;
+			m_wheelPrev = nullptr;
+			m_wheelNext = nullptr;
+			m_wheelLevel = 0;
+			m_wheelSlot = 0;
 		}
 
 		uint32_t m_eventid;
 
-		friend SchedulerTask* createSchedulerTask(uint32_t, const std::function<void (void)>&);
+		// timer wheel bookkeeping, only valid while the task is linked into a slot
+		SchedulerTask* m_wheelPrev;
+		SchedulerTask* m_wheelNext;
+		uint8_t m_wheelLevel;
+		uint8_t m_wheelSlot;
+
+		template<typename F>
+		friend SchedulerTask* createSchedulerTask(uint32_t, F&&);
+		friend class TimerWheel;
 };
 
-inline SchedulerTask* createSchedulerTask(uint32_t delay, const std::function<void (void)>& f)
+static_assert(sizeof(SchedulerTask) <= TASK_POOL_BLOCK_SIZE, "SchedulerTask does not fit in a TaskPool block");
+
+template<typename F>
+inline SchedulerTask* createSchedulerTask(uint32_t delay, F&& f)
 {
-	return new SchedulerTask(std::max<uint32_t>(delay, SCHEDULER_MINTICKS), f);
+	return new SchedulerTask(std::max<uint32_t>(delay, SCHEDULER_MINTICKS), std::forward<F>(f));
+}
+
+template<typename F>
+inline SchedulerTask* createSchedulerTask(uint32_t delay, F&& f, TaskCategory category)
+{
+	SchedulerTask* task = createSchedulerTask(delay, std::forward<F>(f));
+	task->setCategory(category);
+	return task;
 }
 
 class lessSchedTask : public std::binary_function<SchedulerTask*&, SchedulerTask*&, bool>
@@ -69,6 +101,49 @@ class lessSchedTask : public std::binary_function<SchedulerTask*&, SchedulerTask
 		}
 };
 
+class TimerWheel
+{
+	public:
+		TimerWheel();
+
+		// non-copyable
+		TimerWheel(const TimerWheel&) = delete;
+		TimerWheel& operator=(const TimerWheel&) = delete;
+
+		void insert(SchedulerTask* task);
+		void remove(SchedulerTask* task);
+
+		// moves every task due at or before 'now' into 'expired', sorted by expiration
+		void advance(std::chrono::system_clock::time_point now, std::vector<SchedulerTask*>& expired);
+
+		// unlinks every task, in no particular order
+		void clear(std::vector<SchedulerTask*>& tasks);
+
+		std::chrono::system_clock::time_point getNextWakeup() const;
+
+		bool empty() const {
+			return m_size == 0;
+		}
+		size_t size() const {
+			return m_size;
+		}
+
+	protected:
+		uint64_t getTick(std::chrono::system_clock::time_point time, bool roundUp) const;
+		std::chrono::system_clock::time_point getTickTime(uint64_t tick) const;
+
+		void link(SchedulerTask* task, uint64_t tick);
+		void unlink(SchedulerTask* task);
+		void cascade(uint8_t level, uint8_t slot);
+
+		std::chrono::system_clock::time_point m_start;
+		uint64_t m_currentTick;
+		size_t m_size;
+
+		SchedulerTask* m_slots[SCHEDULER_WHEEL_LEVELS][SCHEDULER_WHEEL_SIZE];
+		uint64_t m_occupied[SCHEDULER_WHEEL_LEVELS][SCHEDULER_WHEEL_SIZE / 64];
+};
+
 class Scheduler
 {
 	public:
@@ -78,6 +153,12 @@ class Scheduler
 		uint32_t addEvent(SchedulerTask* task);
 		bool stopEvent(uint32_t eventId);
 
+		// switches between the binary heap and the timer wheel backend,
+		// pending events are migrated
+		void setTimerWheel(bool enabled);
+
+		size_t getPendingEvents();
+
 		void start();
 		void stop();
 		void shutdown();
@@ -91,6 +172,7 @@ class Scheduler
 
 	protected:
 		void schedulerThread();
+		void wheelThreadStep(std::unique_lock<std::mutex>& eventLockUnique);
 
 		std::thread m_thread;
 		std::mutex m_eventLock;
@@ -99,6 +181,13 @@ class Scheduler
 		uint32_t m_lastEventId;
 		std::priority_queue<SchedulerTask*, std::vector<SchedulerTask*>, lessSchedTask > m_eventList;
 		std::unordered_set<uint32_t> m_eventIds;
+
+		TimerWheel m_wheel;
+		std::unordered_map<uint32_t, SchedulerTask*> m_wheelEvents;
+		std::vector<SchedulerTask*> m_wheelExpired;
+		std::vector<Task*> m_wheelBatch;
+		bool m_useWheel;
+
 		SchedulerState m_threadState;
 };
 
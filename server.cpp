@@ -49,7 +49,22 @@ void ServiceManager::run()
 {
 	assert(!running);
 	running = true;
+
+	// every connection runs its handlers on its own strand, so any number of
+	// threads may drive the io_service; this one is the last of them
+	int32_t threads = std::max<int32_t>(1, g_config.getNumber(ConfigManager::NETWORK_THREADS));
+
+	std::vector<std::thread> ioThreads;
+	ioThreads.reserve(threads - 1);
+	for (int32_t i = 1; i < threads; ++i) {
+		ioThreads.emplace_back([this]() { m_io_service.run(); });
+	}
+
 	m_io_service.run();
+
+	for (std::thread& thread : ioThreads) {
+		thread.join();
+	}
 }
 
 void ServiceManager::stop()
@@ -63,7 +78,7 @@ void ServiceManager::stop()
 	for (std::map<uint16_t, ServicePort_ptr>::iterator it = m_acceptors.begin();
 	        it != m_acceptors.end(); ++it) {
 		try {
-			m_io_service.post(std::bind(&ServicePort::onStopServer, it->second));
+			it->second->m_strand.post(std::bind(&ServicePort::onStopServer, it->second));
 		} catch (boost::system::system_error& e) {
 			std::cout << "[ServiceManager::stop] Network Error: " << e.what() << std::endl;
 		}
@@ -79,6 +94,7 @@ void ServiceManager::stop()
 
 ServicePort::ServicePort(boost::asio::io_service& io_service) :
 	m_io_service(io_service),
+	m_strand(io_service),
 	m_acceptor(nullptr),
 	m_serverPort(0),
 	m_pendingStart(false)
@@ -118,7 +134,7 @@ void ServicePort::accept()
 	}
 
 	boost::asio::ip::tcp::socket* socket = new boost::asio::ip::tcp::socket(m_io_service);
-	m_acceptor->async_accept(*socket, std::bind(&ServicePort::onAccept, this, socket, std::placeholders::_1));
+	m_acceptor->async_accept(*socket, m_strand.wrap(std::bind(&ServicePort::onAccept, this, socket, std::placeholders::_1)));
 }
 
 void ServicePort::onAccept(boost::asio::ip::tcp::socket* socket, const boost::system::error_code& error)
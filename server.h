@@ -82,7 +82,10 @@ class ServicePort : public std::enable_shared_from_this<ServicePort>
 	protected:
 		void accept();
 
+		friend class ServiceManager;
+
 		boost::asio::io_service& m_io_service;
+		boost::asio::io_service::strand m_strand;
 		boost::asio::ip::tcp::acceptor* m_acceptor;
 		std::vector<Service_ptr> m_services;
 
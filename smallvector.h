@@ -0,0 +1,155 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2015  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FS_SMALLVECTOR_H_8B2D5E71C94F4A0D9E6B13F7A2C0D548
+#define FS_SMALLVECTOR_H_8B2D5E71C94F4A0D9E6B13F7A2C0D548
+
+// Vector of trivially copyable values that keeps its first N elements in
+// an inline buffer and only allocates once it grows past that.
+template <typename T, size_t N>
+class SmallVector
+{
+	public:
+		typedef T* iterator;
+		typedef const T* const_iterator;
+
+		SmallVector() : data(inlineData), count(0), capacity(N) {}
+		~SmallVector() {
+			release();
+		}
+
+		SmallVector(const SmallVector& other) : SmallVector() {
+			append(other.begin(), other.end());
+		}
+		SmallVector(SmallVector&& other) : SmallVector() {
+			swapStorage(other);
+		}
+
+		SmallVector& operator=(const SmallVector& other) {
+			if (this != &other) {
+				count = 0;
+				append(other.begin(), other.end());
+			}
+			return *this;
+		}
+		SmallVector& operator=(SmallVector&& other) {
+			if (this != &other) {
+				count = 0;
+				swapStorage(other);
+			}
+			return *this;
+		}
+
+		iterator begin() {
+			return data;
+		}
+		const_iterator begin() const {
+			return data;
+		}
+		iterator end() {
+			return data + count;
+		}
+		const_iterator end() const {
+			return data + count;
+		}
+
+		T& operator[](size_t index) {
+			return data[index];
+		}
+		const T& operator[](size_t index) const {
+			return data[index];
+		}
+		T& back() {
+			return data[count - 1];
+		}
+
+		size_t size() const {
+			return count;
+		}
+		bool empty() const {
+			return count == 0;
+		}
+		void clear() {
+			count = 0;
+		}
+
+		void reserve(size_t n) {
+			if (n > capacity) {
+				grow(n);
+			}
+		}
+		void resize(size_t n) {
+			reserve(n);
+			count = n;
+		}
+
+		void push_back(const T& value) {
+			if (count == capacity) {
+				grow(capacity * 2);
+			}
+			data[count++] = value;
+		}
+		void pop_back() {
+			--count;
+		}
+
+		void append(const_iterator first, const_iterator last) {
+			size_t n = last - first;
+			reserve(count + n);
+			std::copy(first, last, data + count);
+			count += n;
+		}
+
+	private:
+		void grow(size_t n) {
+			T* newData = new T[n];
+			std::copy(data, data + count, newData);
+			release();
+			data = newData;
+			capacity = n;
+		}
+
+		void release() {
+			if (data != inlineData) {
+				delete[] data;
+			}
+		}
+
+		// leaves other empty; only heap storage can be taken over as is
+		void swapStorage(SmallVector& other) {
+			if (other.data != other.inlineData) {
+				release();
+				data = other.data;
+				capacity = other.capacity;
+				count = other.count;
+				other.data = other.inlineData;
+				other.capacity = N;
+			} else {
+				append(other.begin(), other.end());
+			}
+			other.count = 0;
+		}
+
+		T* data;
+		size_t count;
+		size_t capacity;
+		T inlineData[N];
+};
+
+#endif
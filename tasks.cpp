@@ -21,12 +21,154 @@
 
 #include "tasks.h"
 #include "outputmessage.h"
-#include "game.h"
+#include "taskstats.h"
 
-extern Game g_game;
+#define TASK_POOL_BATCH 64
+
+namespace {
+
+union TaskBlock {
+	TaskBlock* next;
+	std::aligned_storage<TASK_POOL_BLOCK_SIZE>::type storage;
+};
+
+struct TaskBatch {
+	TaskBlock* head;
+	size_t size;
+};
+
+class SharedTaskList
+{
+	public:
+		void push(TaskBatch& batch) {
+			std::lock_guard<std::mutex> lockGuard(m_lock);
+			m_batches.push_back(batch);
+		}
+
+		bool pop(TaskBatch& batch) {
+			std::lock_guard<std::mutex> lockGuard(m_lock);
+			if (m_batches.empty()) {
+				return false;
+			}
+
+			batch = m_batches.back();
+			m_batches.pop_back();
+			return true;
+		}
+
+	private:
+		std::mutex m_lock;
+		std::vector<TaskBatch> m_batches;
+};
+
+SharedTaskList& getSharedTaskList()
+{
+	// never destroyed, tasks may still be released while statics are torn down
+	static SharedTaskList* list = new SharedTaskList;
+	return *list;
+}
+
+struct TaskCache {
+	TaskBatch current = {nullptr, 0};
+	TaskBatch full = {nullptr, 0};
+
+	~TaskCache() {
+		SharedTaskList& list = getSharedTaskList();
+		if (current.size != 0) {
+			list.push(current);
+		}
+		if (full.size != 0) {
+			list.push(full);
+		}
+	}
+};
+
+thread_local TaskCache taskCache;
+
+}
+
+void* TaskPool::allocate()
+{
+	TaskCache& cache = taskCache;
+	if (cache.current.size == 0) {
+		if (cache.full.size != 0) {
+			std::swap(cache.current, cache.full);
+		} else if (!getSharedTaskList().pop(cache.current)) {
+			return ::operator new(sizeof(TaskBlock));
+		}
+	}
+
+	TaskBlock* block = cache.current.head;
+	cache.current.head = block->next;
+	--cache.current.size;
+	return block;
+}
+
+void TaskPool::deallocate(void* ptr)
+{
+	if (!ptr) {
+		return;
+	}
+
+	TaskCache& cache = taskCache;
+	if (cache.current.size == TASK_POOL_BATCH) {
+		// hand a whole batch to the threads that allocate the tasks
+		if (cache.full.size != 0) {
+			getSharedTaskList().push(cache.full);
+		}
+		cache.full = cache.current;
+		cache.current.head = nullptr;
+		cache.current.size = 0;
+	}
+
+	TaskBlock* block = static_cast<TaskBlock*>(ptr);
+	block->next = cache.current.head;
+	cache.current.head = block;
+	++cache.current.size;
+}
+
+bool TaskLane::push(const std::vector<Task*>& tasks)
+{
+	if (tasks.empty()) {
+		return false;
+	}
+
+	// link the batch newest to oldest so it goes in with a single CAS
+	for (size_t i = tasks.size() - 1; i > 0; --i) {
+		tasks[i]->m_next = tasks[i - 1];
+	}
+	return pushChain(tasks.back(), tasks.front());
+}
+
+bool TaskLane::pushChain(Task* first, Task* last)
+{
+	Task* head = m_head.load(std::memory_order_relaxed);
+	do {
+		last->m_next = head;
+	} while (!m_head.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+	return head == nullptr;
+}
+
+Task* TaskLane::takeAll()
+{
+	Task* task = m_head.exchange(nullptr, std::memory_order_acquire);
+
+	// the stack holds the newest task first, reverse it into FIFO order
+	Task* reversed = nullptr;
+	while (task) {
+		Task* next = task->m_next;
+		task->m_next = reversed;
+		reversed = task;
+		task = next;
+	}
+	return reversed;
+}
 
 Dispatcher::Dispatcher()
 {
+	m_priorityBatch = nullptr;
+	m_taskBatch = nullptr;
+	m_queueDepth = 0;
 	m_threadState = STATE_TERMINATED;
 }
 
@@ -38,98 +180,145 @@ void Dispatcher::start()
 
 void Dispatcher::dispatcherThread()
 {
-	OutputMessagePool* outputPool = OutputMessagePool::getInstance();
-
 	// NOTE: second argument defer_lock is to prevent from immediate locking
 	std::unique_lock<std::mutex> taskLockUnique(m_taskLock, std::defer_lock);
 
 	while (m_threadState != STATE_TERMINATED) {
-		// check if there are tasks waiting
-		taskLockUnique.lock();
+		if (executeTasks(false)) {
+			continue;
+		}
 
-		if (m_taskList.empty()) {
-			//if the list is empty wait for signal
+		// both lanes are empty, producers signal under the lock after
+		// pushing into an empty lane so the wakeup cannot be missed
+		taskLockUnique.lock();
+		if (m_priorityLane.empty() && m_taskLane.empty() && m_threadState != STATE_TERMINATED) {
 			m_taskSignal.wait(taskLockUnique);
 		}
+		taskLockUnique.unlock();
+	}
+}
 
-		if (!m_taskList.empty() && m_threadState != STATE_TERMINATED) {
-			// take the first task
-			Task* task = m_taskList.front();
-			m_taskList.pop_front();
-			taskLockUnique.unlock();
-
-			if (!task->hasExpired()) {
-				// execute it
-				outputPool->startExecutionFrame();
-				(*task)();
-				outputPool->sendAll();
+bool Dispatcher::executeTasks(bool flushing)
+{
+	bool executed = false;
+	while (flushing || m_threadState != STATE_TERMINATED) {
+		// the batches are members so that a flush from inside a task
+		// carries on from the right place
+		if (!m_priorityBatch && !m_priorityLane.empty()) {
+			m_priorityBatch = m_priorityLane.takeAll();
+		}
 
-				g_game.map.clearSpectatorCache();
-			}
-			delete task;
+		Task* task = m_priorityBatch;
+		if (task) {
+			m_priorityBatch = task->m_next;
 		} else {
-			taskLockUnique.unlock();
+			if (!m_taskBatch) {
+				m_taskBatch = m_taskLane.takeAll();
+				if (!m_taskBatch) {
+					break;
+				}
+			}
+
+			task = m_taskBatch;
+			m_taskBatch = task->m_next;
 		}
+
+		executeTask(task, flushing);
+		executed = true;
 	}
+	return executed;
 }
 
-void Dispatcher::addTask(Task* task, bool push_front /*= false*/)
+void Dispatcher::executeTask(Task* task, bool flushing)
 {
-	bool do_signal = false;
+	g_taskStats.recordQueueDepth(m_queueDepth.fetch_sub(1, std::memory_order_relaxed));
 
-	m_taskLock.lock();
-
-	if (m_threadState == STATE_RUNNING) {
-		do_signal = m_taskList.empty();
+	OutputMessagePool* outputPool = OutputMessagePool::getInstance();
+	if (flushing) {
+		(*task)();
 
-		if (push_front) {
-			m_taskList.push_front(task);
-		} else {
-			m_taskList.push_back(task);
+		if (outputPool) {
+			outputPool->sendAll();
 		}
+	} else if (!task->hasExpired()) {
+		const int64_t startTime = TaskStats::now();
+
+		// execute it
+		outputPool->startExecutionFrame();
+		(*task)();
+		outputPool->sendAll();
+
+		g_taskStats.recordTask(task->m_category, task->m_tag, startTime - task->m_queuedAt, TaskStats::now() - startTime);
 	} else {
-		delete task;
+		g_taskStats.recordExpiredTask(task->m_category);
 	}
+	delete task;
+}
 
+void Dispatcher::signal()
+{
+	// taking the lock orders this notify after a concurrent emptiness check
+	m_taskLock.lock();
 	m_taskLock.unlock();
-
-	// send a signal if the list was empty
-	if (do_signal) {
-		m_taskSignal.notify_one();
-	}
+	m_taskSignal.notify_one();
 }
 
-void Dispatcher::flush()
+void Dispatcher::addTask(Task* task, bool push_front /*= false*/)
 {
-	while (!m_taskList.empty()) {
-		Task* task = m_taskList.front();
-		m_taskList.pop_front();
-		(*task)();
+	if (m_threadState != STATE_RUNNING) {
 		delete task;
+		return;
+	}
 
-		OutputMessagePool* outputPool = OutputMessagePool::getInstance();
-		if (outputPool) {
-			outputPool->sendAll();
+	task->m_queuedAt = TaskStats::now();
+	m_queueDepth.fetch_add(1, std::memory_order_relaxed);
+
+	TaskLane& lane = push_front ? m_priorityLane : m_taskLane;
+
+	// send a signal if the lane was empty
+	if (lane.push(task)) {
+		signal();
+	}
+}
+
+void Dispatcher::addTasks(const std::vector<Task*>& tasks, bool push_front /*= false*/)
+{
+	if (m_threadState != STATE_RUNNING) {
+		for (Task* task : tasks) {
+			delete task;
 		}
+		return;
+	}
+
+	const int64_t now = TaskStats::now();
+	for (Task* task : tasks) {
+		task->m_queuedAt = now;
+	}
+	m_queueDepth.fetch_add(tasks.size(), std::memory_order_relaxed);
+
+	TaskLane& lane = push_front ? m_priorityLane : m_taskLane;
 
-		g_game.map.clearSpectatorCache();
+	// send a signal if the lane was empty
+	if (lane.push(tasks)) {
+		signal();
 	}
 }
 
+void Dispatcher::flush()
+{
+	executeTasks(true);
+}
+
 void Dispatcher::stop()
 {
-	m_taskLock.lock();
 	m_threadState = STATE_CLOSING;
-	m_taskLock.unlock();
 }
 
 void Dispatcher::shutdown()
 {
-	m_taskLock.lock();
 	m_threadState = STATE_TERMINATED;
 	flush();
-	m_taskLock.unlock();
-	m_taskSignal.notify_one();
+	signal();
 }
 
 void Dispatcher::join()
@@ -20,20 +20,184 @@
 #ifndef FS_TASKS_H_A66AC384766041E59DCA059DAB6E1976
 #define FS_TASKS_H_A66AC384766041E59DCA059DAB6E1976
 
+#include <atomic>
 #include <condition_variable>
 
+#include "enums.h"
+
 const int DISPATCHER_TASK_EXPIRATION = 2000;
 const auto SYSTEM_TIME_ZERO = std::chrono::system_clock::time_point(std::chrono::milliseconds(0));
 
+// functors up to this size are stored inside the task itself
+#define TASK_CALLABLE_SIZE 96
+// every Task and SchedulerTask is carved out of blocks of this size
+#define TASK_POOL_BLOCK_SIZE 192
+
+// Move-only replacement for std::function<void (void)>. Functors that fit in
+// TASK_CALLABLE_SIZE are kept inline, larger ones fall back to the heap.
+class TaskCallable
+{
+	public:
+		TaskCallable() : m_ops(nullptr) {}
+
+		template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, TaskCallable>::value>::type>
+		TaskCallable(F&& f) {
+			typedef typename std::decay<F>::type Functor;
+			construct<Functor>(std::forward<F>(f), std::integral_constant<bool, fitsInline<Functor>()>());
+		}
+
+		TaskCallable(TaskCallable&& other) : m_ops(other.m_ops) {
+			if (m_ops) {
+				m_ops->move(&m_storage, &other.m_storage);
+				other.m_ops = nullptr;
+			}
+		}
+
+		TaskCallable& operator=(TaskCallable&& other) {
+			if (this != &other) {
+				reset();
+				m_ops = other.m_ops;
+				if (m_ops) {
+					m_ops->move(&m_storage, &other.m_storage);
+					other.m_ops = nullptr;
+				}
+			}
+			return *this;
+		}
+
+		~TaskCallable() {
+			reset();
+		}
+
+		// non-copyable
+		TaskCallable(const TaskCallable&) = delete;
+		TaskCallable& operator=(const TaskCallable&) = delete;
+
+		void operator()() {
+			m_ops->invoke(&m_storage);
+		}
+
+		explicit operator bool() const {
+			return m_ops != nullptr;
+		}
+
+		void reset() {
+			if (m_ops) {
+				m_ops->destroy(&m_storage);
+				m_ops = nullptr;
+			}
+		}
+
+	private:
+		typedef typename std::aligned_storage<TASK_CALLABLE_SIZE>::type Storage;
+
+		struct Ops {
+			void (*invoke)(void* storage);
+			void (*move)(void* dest, void* src);
+			void (*destroy)(void* storage);
+		};
+
+		template<typename Functor>
+		static constexpr bool fitsInline() {
+			return sizeof(Functor) <= sizeof(Storage) && std::alignment_of<Storage>::value % std::alignment_of<Functor>::value == 0;
+		}
+
+		template<typename Functor>
+		struct InlineOps {
+			static void invoke(void* storage) {
+				(*static_cast<Functor*>(storage))();
+			}
+			static void move(void* dest, void* src) {
+				new (dest) Functor(std::move(*static_cast<Functor*>(src)));
+				static_cast<Functor*>(src)->~Functor();
+			}
+			static void destroy(void* storage) {
+				static_cast<Functor*>(storage)->~Functor();
+			}
+			static const Ops ops;
+		};
+
+		template<typename Functor>
+		struct HeapOps {
+			static void invoke(void* storage) {
+				(**static_cast<Functor**>(storage))();
+			}
+			static void move(void* dest, void* src) {
+				*static_cast<Functor**>(dest) = *static_cast<Functor**>(src);
+			}
+			static void destroy(void* storage) {
+				delete *static_cast<Functor**>(storage);
+			}
+			static const Ops ops;
+		};
+
+		template<typename Functor, typename F>
+		void construct(F&& f, std::true_type) {
+			new (&m_storage) Functor(std::forward<F>(f));
+			m_ops = &InlineOps<Functor>::ops;
+		}
+
+		template<typename Functor, typename F>
+		void construct(F&& f, std::false_type) {
+			*reinterpret_cast<Functor**>(&m_storage) = new Functor(std::forward<F>(f));
+			m_ops = &HeapOps<Functor>::ops;
+		}
+
+		Storage m_storage;
+		const Ops* m_ops;
+};
+
+template<typename Functor>
+const TaskCallable::Ops TaskCallable::InlineOps<Functor>::ops = {
+	&TaskCallable::InlineOps<Functor>::invoke,
+	&TaskCallable::InlineOps<Functor>::move,
+	&TaskCallable::InlineOps<Functor>::destroy
+};
+
+template<typename Functor>
+const TaskCallable::Ops TaskCallable::HeapOps<Functor>::ops = {
+	&TaskCallable::HeapOps<Functor>::invoke,
+	&TaskCallable::HeapOps<Functor>::move,
+	&TaskCallable::HeapOps<Functor>::destroy
+};
+
+// Free-list allocator for tasks. Every thread keeps a small cache of blocks
+// and exchanges whole batches with a shared list, so the lock is only taken
+// once per TASK_POOL_BATCH allocations or releases.
+class TaskPool
+{
+	public:
+		static void* allocate();
+		static void deallocate(void* block);
+};
+
+template<typename T>
+struct IsTaskFunctor : std::integral_constant<bool, !std::is_base_of<class Task, typename std::decay<T>::type>::value> {};
+
 class Task
 {
 	public:
 		// DO NOT allocate this class on the stack
-		Task(uint32_t ms, const std::function<void (void)>& f) : m_f(f) {
+		template<typename F, typename = typename std::enable_if<IsTaskFunctor<F>::value>::type>
+		Task(uint32_t ms, F&& f) : m_f(std::forward<F>(f)), m_next(nullptr), m_queuedAt(0), m_category(TASK_CATEGORY_OTHER), m_tag(0) {
 			m_expiration = std::chrono::system_clock::now() + std::chrono::milliseconds(ms);
 		}
-		Task(const std::function<void (void)>& f)
-			: m_expiration(SYSTEM_TIME_ZERO), m_f(f) {}
+
+		template<typename F, typename = typename std::enable_if<IsTaskFunctor<F>::value>::type>
+		explicit Task(F&& f)
+			: m_expiration(SYSTEM_TIME_ZERO), m_f(std::forward<F>(f)), m_next(nullptr), m_queuedAt(0), m_category(TASK_CATEGORY_OTHER), m_tag(0) {}
+
+		// non-copyable
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		static void* operator new(size_t size) {
+			(void)size;
+			return TaskPool::allocate();
+		}
+		static void operator delete(void* block) {
+			TaskPool::deallocate(block);
+		}
 
 		void operator()() {
 			m_f();
@@ -50,22 +214,62 @@ class Task
 			return m_expiration < std::chrono::system_clock::now();
 		}
 
+		// the tag is the client opcode for TASK_CATEGORY_PACKET
+		void setCategory(TaskCategory category, uint8_t tag = 0) {
+			m_category = category;
+			m_tag = tag;
+		}
+		TaskCategory getCategory() const {
+			return m_category;
+		}
+
 	protected:
 		// Expiration has another meaning for scheduler tasks,
 		// then it is the time the task should be added to the
 		// dispatcher
 		std::chrono::system_clock::time_point m_expiration;
-		std::function<void (void)> m_f;
+		TaskCallable m_f;
+
+		// intrusive link used while the task waits in a TaskLane
+		Task* m_next;
+
+		// statistics, see TaskStats
+		int64_t m_queuedAt;
+		TaskCategory m_category;
+		uint8_t m_tag;
+
+		friend class TaskLane;
+		friend class Dispatcher;
 };
 
-inline Task* createTask(const std::function<void (void)>& f)
+static_assert(sizeof(Task) <= TASK_POOL_BLOCK_SIZE, "Task does not fit in a TaskPool block");
+
+template<typename F>
+inline Task* createTask(F&& f)
+{
+	return new Task(std::forward<F>(f));
+}
+
+template<typename F>
+inline Task* createTask(uint32_t expiration, F&& f)
 {
-	return new Task(f);
+	return new Task(expiration, std::forward<F>(f));
 }
 
-inline Task* createTask(uint32_t expiration, const std::function<void (void)>& f)
+template<typename F>
+inline Task* createTask(F&& f, TaskCategory category, uint8_t tag = 0)
 {
-	return new Task(expiration, f);
+	Task* task = new Task(std::forward<F>(f));
+	task->setCategory(category, tag);
+	return task;
+}
+
+template<typename F>
+inline Task* createTask(uint32_t expiration, F&& f, TaskCategory category, uint8_t tag = 0)
+{
+	Task* task = new Task(expiration, std::forward<F>(f));
+	task->setCategory(category, tag);
+	return task;
 }
 
 enum DispatcherState {
@@ -74,6 +278,37 @@ enum DispatcherState {
 	STATE_TERMINATED
 };
 
+// Lock-free multi-producer single-consumer task stack. Producers push with a
+// single CAS and no allocation; the consumer takes everything at once and gets
+// the tasks back oldest first.
+class TaskLane
+{
+	public:
+		TaskLane() : m_head(nullptr) {}
+
+		// non-copyable
+		TaskLane(const TaskLane&) = delete;
+		TaskLane& operator=(const TaskLane&) = delete;
+
+		// returns true if the lane was empty before the push
+		bool push(Task* task) {
+			return pushChain(task, task);
+		}
+		bool push(const std::vector<Task*>& tasks);
+
+		Task* takeAll();
+
+		bool empty() const {
+			return m_head.load(std::memory_order_acquire) == nullptr;
+		}
+
+	protected:
+		// 'first' is the newest task of a chain already linked down to 'last'
+		bool pushChain(Task* first, Task* last);
+
+		std::atomic<Task*> m_head;
+};
+
 class Dispatcher
 {
 	public:
@@ -81,23 +316,43 @@ class Dispatcher
 		~Dispatcher() {}
 
 		void addTask(Task* task, bool push_front = false);
+		void addTasks(const std::vector<Task*>& tasks, bool push_front = false);
 
 		void start();
 		void stop();
 		void shutdown();
 		void join();
 
+		// tasks queued and not yet executed
+		uint32_t getQueueDepth() const {
+			return m_queueDepth.load(std::memory_order_relaxed);
+		}
+
 	protected:
 		void dispatcherThread();
 
+		bool executeTasks(bool flushing);
+		void executeTask(Task* task, bool flushing);
+		void signal();
+
 		void flush();
 
 		std::thread m_thread;
+
+		// only used to put the dispatcher thread to sleep when both lanes are empty
 		std::mutex m_taskLock;
 		std::condition_variable m_taskSignal;
 
-		std::list<Task*> m_taskList;
-		DispatcherState m_threadState;
+		// scheduler tasks (push_front) are always drained before regular ones
+		TaskLane m_priorityLane;
+		TaskLane m_taskLane;
+
+		// batches taken from the lanes and not yet executed
+		Task* m_priorityBatch;
+		Task* m_taskBatch;
+
+		std::atomic<uint32_t> m_queueDepth;
+		std::atomic<DispatcherState> m_threadState;
 };
 
 extern Dispatcher g_dispatcher;
@@ -0,0 +1,249 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2014  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "otpch.h"
+
+#include "taskstats.h"
+
+LatencyHistogram::LatencyHistogram() : total(0), max(0)
+{
+	for (std::atomic<uint64_t>& count : counts) {
+		count.store(0, std::memory_order_relaxed);
+	}
+}
+
+size_t LatencyHistogram::getBucket(uint64_t value)
+{
+	if (value < sub_buckets) {
+		return value;
+	}
+
+	value = std::min<uint64_t>(value, std::numeric_limits<uint32_t>::max());
+
+	// position of the highest bit, the next sub_bucket_bits bits pick the bucket
+	size_t exponent = 63 - __builtin_clzll(value);
+	size_t subBucket = (value >> (exponent - sub_bucket_bits)) & (sub_buckets - 1);
+	return (exponent - sub_bucket_bits + 1) * sub_buckets + subBucket;
+}
+
+uint64_t LatencyHistogram::getBucketLimit(size_t bucket)
+{
+	if (bucket < sub_buckets) {
+		return bucket;
+	}
+
+	size_t exponent = bucket / sub_buckets + sub_bucket_bits - 1;
+	uint64_t lowest = static_cast<uint64_t>(sub_buckets + bucket % sub_buckets) << (exponent - sub_bucket_bits);
+	return lowest + (static_cast<uint64_t>(1) << (exponent - sub_bucket_bits)) - 1;
+}
+
+void LatencyHistogram::record(int64_t value)
+{
+	uint64_t v = std::max<int64_t>(0, value);
+	counts[getBucket(v)].fetch_add(1, std::memory_order_relaxed);
+	total.fetch_add(v, std::memory_order_relaxed);
+
+	uint64_t currentMax = max.load(std::memory_order_relaxed);
+	while (v > currentMax && !max.compare_exchange_weak(currentMax, v, std::memory_order_relaxed)) {
+		// retry with the value another thread stored
+	}
+}
+
+void LatencyHistogram::snapshot(HistogramSnapshot& snapshot) const
+{
+	snapshot.count = 0;
+	for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+		snapshot.counts[bucket] = counts[bucket].load(std::memory_order_relaxed);
+		snapshot.count += snapshot.counts[bucket];
+	}
+	snapshot.total = total.load(std::memory_order_relaxed);
+	snapshot.max = max.load(std::memory_order_relaxed);
+}
+
+void HistogramSnapshot::subtract(const HistogramSnapshot& earlier)
+{
+	for (size_t bucket = 0; bucket < LatencyHistogram::bucket_count; ++bucket) {
+		counts[bucket] -= earlier.counts[bucket];
+	}
+	count -= earlier.count;
+	total -= earlier.total;
+}
+
+uint64_t HistogramSnapshot::getPercentile(double p) const
+{
+	if (count == 0) {
+		return 0;
+	}
+
+	uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * count + 0.5));
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < LatencyHistogram::bucket_count; ++bucket) {
+		seen += counts[bucket];
+		if (seen >= rank) {
+			return std::min(LatencyHistogram::getBucketLimit(bucket), max);
+		}
+	}
+	return max;
+}
+
+void TaskStatsSnapshot::subtract(const TaskStatsSnapshot& earlier)
+{
+	for (int category = TASK_CATEGORY_OTHER; category <= TASK_CATEGORY_LAST; ++category) {
+		queueDelay[category].subtract(earlier.queueDelay[category]);
+		executionTime[category].subtract(earlier.executionTime[category]);
+		expired[category] -= earlier.expired[category];
+	}
+	schedulerLateness.subtract(earlier.schedulerLateness);
+	queueDepth.subtract(earlier.queueDepth);
+	databaseQueueDelay.subtract(earlier.databaseQueueDelay);
+	databaseQueryTime.subtract(earlier.databaseQueryTime);
+	databaseQueueDepth.subtract(earlier.databaseQueueDepth);
+
+	for (size_t opcode = 0; opcode < 256; ++opcode) {
+		opcodeCount[opcode] -= earlier.opcodeCount[opcode];
+		opcodeTime[opcode] -= earlier.opcodeTime[opcode];
+	}
+}
+
+const char* TaskStats::getCategoryName(TaskCategory category)
+{
+	switch (category) {
+		case TASK_CATEGORY_PACKET: return "packet";
+		case TASK_CATEGORY_CREATURE_THINK: return "creature think";
+		case TASK_CATEGORY_DECAY: return "decay";
+		case TASK_CATEGORY_DATABASE: return "db callback";
+		case TASK_CATEGORY_LUA_EVENT: return "lua event";
+		default: return "other";
+	}
+}
+
+void TaskStats::recordTask(TaskCategory category, uint8_t opcode, int64_t queueDelayTime, int64_t executionTimeTaken)
+{
+	queueDelay[category].record(queueDelayTime);
+	executionTime[category].record(executionTimeTaken);
+
+	if (category == TASK_CATEGORY_PACKET) {
+		opcodeCount[opcode].fetch_add(1, std::memory_order_relaxed);
+		opcodeTime[opcode].fetch_add(std::max<int64_t>(0, executionTimeTaken), std::memory_order_relaxed);
+	}
+}
+
+void TaskStats::recordExpiredTask(TaskCategory category)
+{
+	expired[category].fetch_add(1, std::memory_order_relaxed);
+}
+
+void TaskStats::snapshot(TaskStatsSnapshot& snapshot) const
+{
+	for (int category = TASK_CATEGORY_OTHER; category <= TASK_CATEGORY_LAST; ++category) {
+		queueDelay[category].snapshot(snapshot.queueDelay[category]);
+		executionTime[category].snapshot(snapshot.executionTime[category]);
+		snapshot.expired[category] = expired[category].load(std::memory_order_relaxed);
+	}
+	schedulerLateness.snapshot(snapshot.schedulerLateness);
+	queueDepth.snapshot(snapshot.queueDepth);
+	databaseQueueDelay.snapshot(snapshot.databaseQueueDelay);
+	databaseQueryTime.snapshot(snapshot.databaseQueryTime);
+	databaseQueueDepth.snapshot(snapshot.databaseQueueDepth);
+
+	for (size_t opcode = 0; opcode < 256; ++opcode) {
+		snapshot.opcodeCount[opcode] = opcodeCount[opcode].load(std::memory_order_relaxed);
+		snapshot.opcodeTime[opcode] = opcodeTime[opcode].load(std::memory_order_relaxed);
+	}
+}
+
+static void printHistogram(std::ostream& os, const char* name, const HistogramSnapshot& histogram)
+{
+	os << std::left << std::setw(24) << name << std::right << std::setw(10) << histogram.count
+	   << std::setw(10) << histogram.getMean()
+	   << std::setw(10) << histogram.getPercentile(0.5)
+	   << std::setw(10) << histogram.getPercentile(0.99)
+	   << std::setw(10) << histogram.getPercentile(0.999)
+	   << std::setw(10) << histogram.max << std::endl;
+}
+
+void TaskStats::dump()
+{
+	std::unique_ptr<TaskStatsSnapshot> current(new TaskStatsSnapshot);
+	snapshot(*current);
+
+	const int64_t time = now();
+	std::unique_ptr<TaskStatsSnapshot> interval(new TaskStatsSnapshot(*current));
+	if (lastDump) {
+		interval->subtract(*lastDump);
+	}
+
+	std::ostringstream ss;
+	ss << ">> Dispatcher statistics";
+	if (lastDumpTime != 0) {
+		ss << " for the last " << (time - lastDumpTime) / 1000000 << " seconds";
+	}
+	ss << " (microseconds, max since startup):" << std::endl;
+	ss << std::left << std::setw(24) << "" << std::right << std::setw(10) << "count" << std::setw(10) << "mean"
+	   << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "max" << std::endl;
+
+	for (int category = TASK_CATEGORY_OTHER; category <= TASK_CATEGORY_LAST; ++category) {
+		if (interval->queueDelay[category].count == 0 && interval->expired[category] == 0) {
+			continue;
+		}
+
+		const std::string name = getCategoryName(static_cast<TaskCategory>(category));
+		printHistogram(ss, (name + " wait").c_str(), interval->queueDelay[category]);
+		printHistogram(ss, (name + " run").c_str(), interval->executionTime[category]);
+		if (interval->expired[category] != 0) {
+			ss << name << ": " << interval->expired[category] << " tasks expired before they ran" << std::endl;
+		}
+	}
+	printHistogram(ss, "scheduler lateness", interval->schedulerLateness);
+	printHistogram(ss, "queue depth (tasks)", interval->queueDepth);
+	if (interval->databaseQueryTime.count != 0) {
+		printHistogram(ss, "db query wait", interval->databaseQueueDelay);
+		printHistogram(ss, "db query run", interval->databaseQueryTime);
+		printHistogram(ss, "db queue depth (tasks)", interval->databaseQueueDepth);
+	}
+
+	// the opcodes that kept the dispatcher busy the longest
+	std::vector<uint8_t> opcodes;
+	for (size_t opcode = 0; opcode < 256; ++opcode) {
+		if (interval->opcodeCount[opcode] != 0) {
+			opcodes.push_back(opcode);
+		}
+	}
+	std::sort(opcodes.begin(), opcodes.end(), [&interval](uint8_t lhs, uint8_t rhs) {
+		return interval->opcodeTime[lhs] > interval->opcodeTime[rhs];
+	});
+	if (opcodes.size() > 5) {
+		opcodes.resize(5);
+	}
+
+	if (!opcodes.empty()) {
+		ss << "busiest opcodes:";
+		for (uint8_t opcode : opcodes) {
+			ss << " 0x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(opcode) << std::dec << std::setfill(' ')
+			   << " (" << interval->opcodeCount[opcode] << " x " << interval->opcodeTime[opcode] / interval->opcodeCount[opcode] << ")";
+		}
+		ss << std::endl;
+	}
+
+	std::cout << ss.str() << std::flush;
+
+	lastDump = std::move(current);
+	lastDumpTime = time;
+}
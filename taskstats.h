@@ -0,0 +1,149 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2014  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef FS_TASKSTATS_H_7D2E9B4C1A6F4E8B9C3D5A0F2E7B1C64
+#define FS_TASKSTATS_H_7D2E9B4C1A6F4E8B9C3D5A0F2E7B1C64
+
+#include <atomic>
+
+#include "enums.h"
+
+struct HistogramSnapshot;
+
+// Latency histogram in the spirit of HdrHistogram: every power of two is
+// split into 8 linear buckets, so a value is reported within 12.5% of what
+// was recorded. Values are microseconds. Recording is a handful of relaxed
+// atomic operations and may happen on any thread.
+class LatencyHistogram
+{
+	public:
+		enum { sub_bucket_bits = 3 };
+		enum { sub_buckets = 1 << sub_bucket_bits };
+		// values up to 2^32 - 1 microseconds (71 minutes), larger ones are clamped
+		enum { bucket_count = (32 - sub_bucket_bits + 1) * sub_buckets };
+
+		LatencyHistogram();
+
+		// non-copyable
+		LatencyHistogram(const LatencyHistogram&) = delete;
+		LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+		void record(int64_t value);
+		void snapshot(HistogramSnapshot& snapshot) const;
+
+		static size_t getBucket(uint64_t value);
+		static uint64_t getBucketLimit(size_t bucket);
+
+	private:
+		std::atomic<uint64_t> counts[bucket_count];
+		std::atomic<uint64_t> total;
+		std::atomic<uint64_t> max;
+};
+
+struct HistogramSnapshot {
+	uint64_t counts[LatencyHistogram::bucket_count];
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+
+	// leaves what was recorded after 'earlier' was taken, max stays the overall one
+	void subtract(const HistogramSnapshot& earlier);
+
+	// highest value that falls in the same bucket as the p-th percentile, p in [0, 1]
+	uint64_t getPercentile(double p) const;
+	uint64_t getMean() const {
+		return count != 0 ? total / count : 0;
+	}
+};
+
+struct TaskStatsSnapshot {
+	HistogramSnapshot queueDelay[TASK_CATEGORY_LAST + 1];
+	HistogramSnapshot executionTime[TASK_CATEGORY_LAST + 1];
+	uint64_t expired[TASK_CATEGORY_LAST + 1];
+	HistogramSnapshot schedulerLateness;
+	HistogramSnapshot queueDepth;
+	HistogramSnapshot databaseQueueDelay;
+	HistogramSnapshot databaseQueryTime;
+	HistogramSnapshot databaseQueueDepth;
+	uint64_t opcodeCount[256];
+	uint64_t opcodeTime[256];
+
+	void subtract(const TaskStatsSnapshot& earlier);
+};
+
+// Where the dispatcher time goes: queue delay and execution time per task
+// category, execution time per client opcode, how late scheduled events
+// are handed to the dispatcher and how deep its queue is. The asynchronous
+// database queries get the same wait, run and queue depth figures.
+class TaskStats
+{
+	public:
+		TaskStats() = default;
+
+		// non-copyable
+		TaskStats(const TaskStats&) = delete;
+		TaskStats& operator=(const TaskStats&) = delete;
+
+		static int64_t now() {
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		static const char* getCategoryName(TaskCategory category);
+
+		void recordTask(TaskCategory category, uint8_t opcode, int64_t queueDelay, int64_t executionTime);
+		void recordExpiredTask(TaskCategory category);
+		void recordSchedulerLateness(int64_t lateness) {
+			schedulerLateness.record(lateness);
+		}
+		void recordQueueDepth(uint32_t depth) {
+			queueDepth.record(depth);
+		}
+		void recordDatabaseQuery(int64_t queueDelay, int64_t queryTime) {
+			databaseQueueDelay.record(queueDelay);
+			databaseQueryTime.record(queryTime);
+		}
+		void recordDatabaseQueueDepth(uint32_t depth) {
+			databaseQueueDepth.record(depth);
+		}
+
+		void snapshot(TaskStatsSnapshot& snapshot) const;
+
+		// prints what happened since the previous dump, dispatcher thread
+		void dump();
+
+	private:
+		LatencyHistogram queueDelay[TASK_CATEGORY_LAST + 1];
+		LatencyHistogram executionTime[TASK_CATEGORY_LAST + 1];
+		std::atomic<uint64_t> expired[TASK_CATEGORY_LAST + 1] = {};
+		LatencyHistogram schedulerLateness;
+		LatencyHistogram queueDepth;
+		LatencyHistogram databaseQueueDelay;
+		LatencyHistogram databaseQueryTime;
+		LatencyHistogram databaseQueueDepth;
+		std::atomic<uint64_t> opcodeCount[256] = {};
+		std::atomic<uint64_t> opcodeTime[256] = {};
+
+		std::unique_ptr<TaskStatsSnapshot> lastDump;
+		int64_t lastDumpTime = 0;
+};
+
+extern TaskStats g_taskStats;
+
+#endif
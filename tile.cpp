@@ -373,6 +373,8 @@ Thing* Tile::getTopVisibleThing(const Creature* creature)
 
 void Tile::onAddTileItem(Item* item)
 {
+	++itemVersion;
+
 	if (item->hasProperty(CONST_PROP_MOVEABLE) || item->getContainer()) {
 		auto it = g_game.browseFields.find(this);
 		if (it != g_game.browseFields.end()) {
@@ -403,6 +405,8 @@ void Tile::onAddTileItem(Item* item)
 
 void Tile::onUpdateTileItem(Item* oldItem, const ItemType& oldType, Item* newItem, const ItemType& newType)
 {
+	++itemVersion;
+
 	if (newItem->hasProperty(CONST_PROP_MOVEABLE) || newItem->getContainer()) {
 		auto it = g_game.browseFields.find(this);
 		if (it != g_game.browseFields.end()) {
@@ -441,6 +445,8 @@ void Tile::onUpdateTileItem(Item* oldItem, const ItemType& oldType, Item* newIte
 
 void Tile::onRemoveTileItem(const SpectatorVec& list, const std::vector<int32_t>& oldStackPosVector, Item* item)
 {
+	++itemVersion;
+
 	if (item->hasProperty(CONST_PROP_MOVEABLE) || item->getContainer()) {
 		auto it = g_game.browseFields.find(this);
 		if (it != g_game.browseFields.end()) {
@@ -839,9 +845,10 @@ void Tile::addThing(Thing* thing)
 
 void Tile::addThing(int32_t, Thing* thing)
 {
+	g_game.map.markTileChanged(tilePos);
+
 	Creature* creature = thing->getCreature();
 	if (creature) {
-		g_game.map.clearSpectatorCache();
 		creature->setParent(this);
 		CreatureVector* creatures = makeCreatures();
 		creatures->insert(creatures->begin(), creature);
@@ -953,6 +960,8 @@ void Tile::addThing(int32_t, Thing* thing)
 
 void Tile::updateThing(Thing* thing, uint16_t itemId, uint32_t count)
 {
+	g_game.map.markTileChanged(tilePos);
+
 	int32_t index = getThingIndex(thing);
 	if (index == -1) {
 		return /*RETURNVALUE_NOTPOSSIBLE*/;
@@ -974,6 +983,8 @@ void Tile::updateThing(Thing* thing, uint16_t itemId, uint32_t count)
 
 void Tile::replaceThing(uint32_t index, Thing* thing)
 {
+	g_game.map.markTileChanged(tilePos);
+
 	int32_t pos = index;
 
 	Item* item = thing->getItem();
@@ -1046,13 +1057,14 @@ void Tile::replaceThing(uint32_t index, Thing* thing)
 
 void Tile::removeThing(Thing* thing, uint32_t count)
 {
+	g_game.map.markTileChanged(tilePos);
+
 	Creature* creature = thing->getCreature();
 	if (creature) {
 		CreatureVector* creatures = getCreatures();
 		if (creatures) {
 			CreatureVector::iterator it = std::find(creatures->begin(), creatures->end(), thing);
 			if (it != creatures->end()) {
-				g_game.map.clearSpectatorCache();
 				creatures->erase(it);
 			}
 		}
@@ -1450,7 +1462,6 @@ void Tile::internalAddThing(uint32_t, Thing* thing)
 
 	Creature* creature = thing->getCreature();
 	if (creature) {
-		g_game.map.clearSpectatorCache();
 		CreatureVector* creatures = makeCreatures();
 		creatures->insert(creatures->begin(), creature);
 	} else {
@@ -1459,6 +1470,8 @@ void Tile::internalAddThing(uint32_t, Thing* thing)
 			return;
 		}
 
+		++itemVersion;
+
 		const ItemType& itemType = Item::items[item->getID()];
 		if (itemType.isGroundTile()) {
 			if (ground == nullptr) {
@@ -24,6 +24,7 @@
 
 #include "cylinder.h"
 #include "item.h"
+#include "smallvector.h"
 #include "tools.h"
 
 class Creature;
@@ -36,7 +37,106 @@ class BedItem;
 
 typedef std::vector<Creature*> CreatureVector;
 typedef std::vector<Item*> ItemVector;
-typedef std::unordered_set<Creature*> SpectatorVec;
+
+#define SPECTATOR_INLINE_SIZE 256
+
+/**
+  * Flat list of creatures returned by Map::getSpectators.
+  * Entries are unique: insert() and addSpectators() skip creatures that
+  * are already present, push_back() is for callers that know they are not.
+  * Lists of up to SPECTATOR_INLINE_SIZE creatures live on the stack.
+  */
+class SpectatorVec
+{
+	public:
+		typedef SmallVector<Creature*, SPECTATOR_INLINE_SIZE> Container;
+		typedef Container::iterator iterator;
+		typedef Container::const_iterator const_iterator;
+
+		iterator begin() {
+			return vec.begin();
+		}
+		const_iterator begin() const {
+			return vec.begin();
+		}
+		iterator end() {
+			return vec.end();
+		}
+		const_iterator end() const {
+			return vec.end();
+		}
+
+		size_t size() const {
+			return vec.size();
+		}
+		bool empty() const {
+			return vec.empty();
+		}
+		void clear() {
+			vec.clear();
+		}
+		void reserve(size_t n) {
+			vec.reserve(n);
+		}
+
+		void push_back(Creature* creature) {
+			vec.push_back(creature);
+		}
+		void insert(Creature* creature) {
+			if (std::find(vec.begin(), vec.end(), creature) == vec.end()) {
+				vec.push_back(creature);
+			}
+		}
+		void erase(Creature* creature) {
+			auto it = std::find(vec.begin(), vec.end(), creature);
+			if (it != vec.end()) {
+				*it = vec.back();
+				vec.pop_back();
+			}
+		}
+		void addSpectators(const SpectatorVec& other) {
+			size_t first = vec.size();
+			vec.append(other.begin(), other.end());
+			removeDuplicates(first);
+		}
+
+		/**
+		  * Drops the entries from index first onwards that are already
+		  * present before it. Both parts must be free of duplicates on
+		  * their own. Does not preserve the order of the older entries.
+		  */
+		void removeDuplicates(size_t first) {
+			size_t count = vec.size();
+			if (first == 0 || first == count) {
+				return;
+			}
+
+			iterator prefixEnd = vec.begin() + first;
+			bool sorted = first * (count - first) > 256;
+			if (sorted) {
+				std::sort(vec.begin(), prefixEnd);
+			}
+
+			size_t last = first;
+			for (size_t i = first; i < count; ++i) {
+				Creature* creature = vec[i];
+				bool found;
+				if (sorted) {
+					found = std::binary_search(vec.begin(), prefixEnd, creature);
+				} else {
+					found = std::find(vec.begin(), prefixEnd, creature) != prefixEnd;
+				}
+
+				if (!found) {
+					vec[last++] = creature;
+				}
+			}
+			vec.resize(last);
+		}
+
+	private:
+		Container vec;
+};
 
 enum tileflags_t : uint32_t {
 	TILESTATE_NONE,
@@ -153,6 +253,22 @@ class TileItemVector : private ItemVector
 		uint16_t downItemCount{ 0 };
 };
 
+/**
+  * Ground and items of a tile serialised the way map descriptions send
+  * them. The bytes are the same for every viewer, only the creatures in
+  * between depend on who is looking, see ProtocolGame::GetTileDescription.
+  */
+struct TileItemCache {
+	enum { max_items = 10 }; // the client shows at most 10 things per tile
+	enum { max_item_size = 5 };
+
+	uint32_t version;
+	uint8_t topCount; // ground and top items, sent before the creatures
+	uint8_t count;
+	uint8_t ends[max_items];
+	uint8_t data[max_items * max_item_size];
+};
+
 class Tile : public Cylinder
 {
 	public:
@@ -286,7 +402,7 @@ class Tile : public Cylinder
 		void addThing(Thing* thing) final;
 		void addThing(int32_t index, Thing* thing) override;
 
-		void updateThing(Thing* thing, uint16_t itemId, uint32_t count) final;
+		void updateThing(Thing* thing, uint16_t itemId, uint32_t count) override;
 		void replaceThing(uint32_t index, Thing* thing) final;
 
 		void removeThing(Thing* thing, uint32_t count) final;
@@ -299,8 +415,8 @@ class Tile : public Cylinder
 		uint32_t getItemTypeCount(uint16_t itemId, int32_t subType = -1) const final;
 		Thing* getThing(size_t index) const final;
 
-		void postAddNotification(Thing* thing, const Cylinder* oldParent, int32_t index, cylinderlink_t link = LINK_OWNER) final;
-		void postRemoveNotification(Thing* thing, const Cylinder* newParent, int32_t index, cylinderlink_t link = LINK_OWNER) final;
+		void postAddNotification(Thing* thing, const Cylinder* oldParent, int32_t index, cylinderlink_t link = LINK_OWNER) override;
+		void postRemoveNotification(Thing* thing, const Cylinder* newParent, int32_t index, cylinderlink_t link = LINK_OWNER) override;
 
 		void internalAddThing(Thing* thing) final;
 		void internalAddThing(uint32_t index, Thing* thing) override;
@@ -320,6 +436,21 @@ class Tile : public Cylinder
 		}
 		void setGround(Item* item) {
 			ground = item;
+			++itemVersion;
+		}
+
+		// changes whenever the ground or an item of this tile changes
+		uint32_t getItemVersion() const {
+			return itemVersion;
+		}
+		TileItemCache* getItemCache() const {
+			return itemCache.get();
+		}
+		TileItemCache* makeItemCache() const {
+			if (!itemCache) {
+				itemCache.reset(new TileItemCache);
+			}
+			return itemCache.get();
 		}
 
 	private:
@@ -335,6 +466,8 @@ class Tile : public Cylinder
 		Item* ground;
 		Position tilePos;
 		uint32_t m_flags;
+		uint32_t itemVersion;
+		mutable std::unique_ptr<TileItemCache> itemCache;
 };
 
 // Used for walkable tiles, where there is high likeliness of
@@ -419,7 +552,8 @@ class StaticTile final : public Tile
 inline Tile::Tile(uint16_t x, uint16_t y, uint8_t z) :
 	ground(nullptr),
 	tilePos(x, y, z),
-	m_flags(0)
+	m_flags(0),
+	itemVersion(0)
 {
 }
 
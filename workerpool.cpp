@@ -0,0 +1,126 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2015  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "otpch.h"
+
+#include "workerpool.h"
+
+WorkerPool::WorkerPool() : currentJob(nullptr), jobCount(0), nextJob(0), busyWorkers(0), generation(0)
+{
+	threadState = THREAD_STATE_TERMINATED;
+}
+
+WorkerPool::~WorkerPool()
+{
+	shutdown();
+}
+
+void WorkerPool::start(size_t threadCount)
+{
+	if (!threads.empty()) {
+		return;
+	}
+
+	threadState = THREAD_STATE_RUNNING;
+	for (size_t i = 0; i < threadCount; ++i) {
+		threads.emplace_back(&WorkerPool::run, this);
+	}
+}
+
+void WorkerPool::shutdown()
+{
+	if (threads.empty()) {
+		return;
+	}
+
+	lock.lock();
+	threadState = THREAD_STATE_TERMINATED;
+	lock.unlock();
+	jobSignal.notify_all();
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+}
+
+void WorkerPool::run()
+{
+	uint64_t lastGeneration = 0;
+
+	std::unique_lock<std::mutex> lockUnique(lock);
+	while (true) {
+		jobSignal.wait(lockUnique, [&]() {
+			return threadState == THREAD_STATE_TERMINATED || generation != lastGeneration;
+		});
+
+		if (threadState == THREAD_STATE_TERMINATED) {
+			break;
+		}
+
+		lastGeneration = generation;
+		const std::function<void(size_t)>& job = *currentJob;
+		size_t count = jobCount;
+		lockUnique.unlock();
+
+		work(job, count);
+
+		lockUnique.lock();
+		if (--busyWorkers == 0) {
+			doneSignal.notify_one();
+		}
+	}
+}
+
+void WorkerPool::work(const std::function<void(size_t)>& job, size_t count)
+{
+	size_t index;
+	while ((index = nextJob.fetch_add(1, std::memory_order_relaxed)) < count) {
+		job(index);
+	}
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& job)
+{
+	if (threads.empty() || count <= 1) {
+		for (size_t index = 0; index < count; ++index) {
+			job(index);
+		}
+		return;
+	}
+
+	lock.lock();
+	currentJob = &job;
+	jobCount = count;
+	nextJob = 0;
+	// every worker takes part in every batch, so none of them can still be
+	// looking at this job once we return
+	busyWorkers = threads.size();
+	++generation;
+	lock.unlock();
+	jobSignal.notify_all();
+
+	work(job, count);
+
+	std::unique_lock<std::mutex> lockUnique(lock);
+	doneSignal.wait(lockUnique, [this]() {
+		return busyWorkers == 0;
+	});
+	currentJob = nullptr;
+}
@@ -0,0 +1,69 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2015  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FS_WORKERPOOL_H_3E0F7C9D2B1A4E6F8C5D9A0B7E2F4C61
+#define FS_WORKERPOOL_H_3E0F7C9D2B1A4E6F8C5D9A0B7E2F4C61
+
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+#include "enums.h"
+
+// Fixed set of threads that help the calling thread run a batch of
+// independent jobs. Only one batch runs at a time.
+class WorkerPool
+{
+	public:
+		WorkerPool();
+		~WorkerPool();
+
+		// non-copyable
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		void start(size_t threadCount);
+		void shutdown();
+
+		size_t getThreadCount() const {
+			return threads.size();
+		}
+
+		// runs job(0) ... job(count - 1) on the workers and the calling thread,
+		// returns once every job has finished
+		void parallelFor(size_t count, const std::function<void(size_t)>& job);
+
+	private:
+		void run();
+		void work(const std::function<void(size_t)>& job, size_t count);
+
+		std::vector<std::thread> threads;
+		std::mutex lock;
+		std::condition_variable jobSignal;
+		std::condition_variable doneSignal;
+
+		const std::function<void(size_t)>* currentJob;
+		size_t jobCount;
+		std::atomic<size_t> nextJob;
+		size_t busyWorkers;
+		uint64_t generation;
+		ThreadState threadState;
+};
+
+#endif
@@ -0,0 +1,405 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2014  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "otpch.h"
+
+#include "worldsave.h"
+#include "game.h"
+#include "house.h"
+#include "tasks.h"
+#include "tools.h"
+
+extern Dispatcher g_dispatcher;
+extern Game g_game;
+
+#define WORLDSAVE_TRIES 3
+#define WORLDSAVE_PROGRESS_INTERVAL 5000
+
+static bool writePlayer(Database& db, const PlayerSaveData& data, uint32_t& rows)
+{
+	for (uint32_t tries = 0; tries < WORLDSAVE_TRIES; ++tries) {
+		if (IOLoginData::writePlayer(db, data, rows)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool writeHouses(Database& db, const std::vector<HouseSaveData>& houses)
+{
+	bool saved = false;
+	for (uint32_t tries = 0; tries < WORLDSAVE_TRIES; ++tries) {
+		if (IOMapSerialize::writeHouseInfo(db, houses)) {
+			saved = true;
+			break;
+		}
+	}
+
+	if (!saved) {
+		return false;
+	}
+
+	for (uint32_t tries = 0; tries < WORLDSAVE_TRIES; ++tries) {
+		if (IOMapSerialize::writeHouseItems(db, houses)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// the houses were captured (and their dirty flag cleared) but not written
+static void setHousesDirty(const std::vector<uint32_t>& houseIds)
+{
+	for (uint32_t houseId : houseIds) {
+		House* house = g_game.map.houses.getHouse(houseId);
+		if (house) {
+			house->setDirty(true);
+		}
+	}
+}
+
+static std::vector<uint32_t> getChangedHouses(const std::vector<HouseSaveData>& houses)
+{
+	std::vector<uint32_t> houseIds;
+	for (const HouseSaveData& house : houses) {
+		if (house.saveTiles) {
+			houseIds.push_back(house.id);
+		}
+	}
+	return houseIds;
+}
+
+WorldSave::WorldSave()
+{
+	housesQueued = false;
+	writingHouses = false;
+	writingPlayer = nullptr;
+	startTime = 0;
+	captureTime = 0;
+	lastProgress = 0;
+	slowestPlayer = 0;
+	playersWritten = 0;
+	playersFailed = 0;
+	rowsWritten = 0;
+	housesWritten = 0;
+	housesChanged = 0;
+	housesFailed = false;
+	threadState = THREAD_STATE_TERMINATED;
+}
+
+void WorldSave::start()
+{
+	if (!db.connect()) {
+		std::cout << "[Warning - WorldSave::start] No database connection, server saves will block the dispatcher." << std::endl;
+		return;
+	}
+
+	threadState = THREAD_STATE_RUNNING;
+	thread = std::thread(&WorldSave::run, this);
+}
+
+void WorldSave::save(std::vector<PlayerSaveData> playerData, std::vector<HouseSaveData> houseData, int64_t snapshotTime)
+{
+	std::unique_lock<std::mutex> lockGuard(lock);
+	for (PlayerSaveData& data : playerData) {
+		takeOlder(data);
+	}
+
+	if (threadState != THREAD_STATE_RUNNING) {
+		// the queued houses are older than these as well
+		houses.clear();
+		housesQueued = false;
+		lockGuard.unlock();
+
+		Database& mainDb = *Database::getInstance();
+		for (const PlayerSaveData& data : playerData) {
+			uint32_t rows = 0;
+			if (!writePlayer(mainDb, data, rows)) {
+				lockGuard.lock();
+				failedSections[data.guid] |= data.getPendingSections();
+				lockGuard.unlock();
+			}
+		}
+
+		if (!writeHouses(mainDb, houseData)) {
+			setHousesDirty(getChangedHouses(houseData));
+		}
+		return;
+	}
+
+	const bool idle = players.empty() && !housesQueued && !writingPlayer;
+	if (idle) {
+		startTime = OTSYS_TIME();
+		captureTime = 0;
+		lastProgress = startTime;
+		slowestPlayer = 0;
+		playersWritten = 0;
+		playersFailed = 0;
+		rowsWritten = 0;
+		housesWritten = 0;
+		housesChanged = 0;
+		housesFailed = false;
+	} else {
+		std::cout << "> World save: the previous save is still being written, newer snapshots replace the queued ones." << std::endl;
+	}
+	captureTime += snapshotTime;
+
+	for (PlayerSaveData& data : playerData) {
+		queuedPlayers[data.guid] = players.insert(players.end(), std::move(data));
+	}
+
+	// only dirty houses carry their tiles, keep those of the queued batch
+	// for the houses that did not change again since
+	std::unordered_map<uint32_t, HouseSaveData*> newHouses;
+	for (HouseSaveData& house : houseData) {
+		newHouses[house.id] = &house;
+	}
+
+	for (HouseSaveData& house : houses) {
+		if (!house.saveTiles) {
+			continue;
+		}
+
+		auto it = newHouses.find(house.id);
+		if (it != newHouses.end() && !it->second->saveTiles) {
+			it->second->tiles = std::move(house.tiles);
+			it->second->saveTiles = true;
+		}
+	}
+
+	houses = std::move(houseData);
+	housesQueued = true;
+
+	lockGuard.unlock();
+	signal.notify_one();
+}
+
+void WorldSave::takeOlder(PlayerSaveData& data)
+{
+	// sections are only flagged once, so whatever an older snapshot that is
+	// not going to be written had to write is now up to this one
+	uint8_t sections = PLAYER_SAVE_NONE;
+
+	auto failedIt = failedSections.find(data.guid);
+	if (failedIt != failedSections.end()) {
+		sections |= failedIt->second;
+		failedSections.erase(failedIt);
+	}
+
+	auto queuedIt = queuedPlayers.find(data.guid);
+	if (queuedIt != queuedPlayers.end()) {
+		const PlayerSaveData& older = *queuedIt->second;
+		sections |= older.sections;
+		if (!(sections & PLAYER_SAVE_STORAGE)) {
+			std::vector<uint32_t> storageKeys;
+			std::set_union(older.storageKeys.begin(), older.storageKeys.end(), data.storageKeys.begin(), data.storageKeys.end(), std::back_inserter(storageKeys));
+			data.storageKeys = std::move(storageKeys);
+		}
+
+		players.erase(queuedIt->second);
+		queuedPlayers.erase(queuedIt);
+	}
+
+	data.sections |= sections;
+	if (data.sections & PLAYER_SAVE_STORAGE) {
+		data.storageKeys.clear();
+	}
+}
+
+void WorldSave::run()
+{
+	std::unique_lock<std::mutex> lockGuard(lock);
+	while (true) {
+		if (players.empty() && !housesQueued) {
+			if (threadState != THREAD_STATE_RUNNING) {
+				break;
+			}
+
+			signal.wait(lockGuard);
+			continue;
+		}
+
+		if (!players.empty()) {
+			PlayerSaveData data = std::move(players.front());
+			queuedPlayers.erase(data.guid);
+			players.pop_front();
+			writingPlayer = &data;
+			lockGuard.unlock();
+
+			uint32_t rows = 0;
+			int64_t start = OTSYS_TIME();
+			bool written = writePlayer(db, data, rows);
+			int64_t end = OTSYS_TIME();
+
+			lockGuard.lock();
+			writingPlayer = nullptr;
+			slowestPlayer = std::max(slowestPlayer, end - start);
+			if (written) {
+				++playersWritten;
+				rowsWritten += rows;
+			} else {
+				++playersFailed;
+				failedSections[data.guid] |= data.getPendingSections();
+				std::cout << "[Error - WorldSave::run] Could not save player " << data.name << '.' << std::endl;
+			}
+
+			if (end - lastProgress >= WORLDSAVE_PROGRESS_INTERVAL) {
+				lastProgress = end;
+				std::cout << "> World save: " << playersWritten << " players written, " << players.size() << " to go..." << std::endl;
+			}
+			playerWritten.notify_all();
+		} else {
+			std::vector<HouseSaveData> houseData = std::move(houses);
+			houses.clear();
+			housesQueued = false;
+			writingHouses = true;
+			lockGuard.unlock();
+
+			bool written = writeHouses(db, houseData);
+			std::vector<uint32_t> changedHouses = getChangedHouses(houseData);
+			if (!written) {
+				g_dispatcher.addTask(createTask(std::bind(setHousesDirty, changedHouses)));
+			}
+
+			lockGuard.lock();
+			writingHouses = false;
+			housesWritten = houseData.size();
+			housesChanged = changedHouses.size();
+			housesFailed = !written;
+			housesWrittenSignal.notify_all();
+		}
+
+		if (players.empty() && !housesQueued) {
+			report();
+		}
+	}
+}
+
+void WorldSave::report()
+{
+	std::cout << "> World save: " << playersWritten << " players (" << rowsWritten << " rows) and " << housesWritten << " houses (" << housesChanged << " with changed items) written in "
+	          << (OTSYS_TIME() - startTime) / 1000. << " s (snapshot " << captureTime << " ms on the dispatcher, slowest player "
+	          << slowestPlayer << " ms";
+	if (playersFailed != 0) {
+		std::cout << ", " << playersFailed << " players failed";
+	}
+	if (housesFailed) {
+		std::cout << ", houses failed";
+	}
+	std::cout << ")." << std::endl;
+}
+
+template<typename Predicate>
+void WorldSave::flushPlayerIf(Predicate predicate)
+{
+	std::unique_lock<std::mutex> lockGuard(lock);
+	if (players.empty() && !writingPlayer) {
+		return;
+	}
+
+	// the writer thread has it already, wait for that transaction
+	while (writingPlayer && predicate(*writingPlayer)) {
+		playerWritten.wait(lockGuard);
+	}
+
+	// still queued: write it from here instead of waiting for its turn
+	for (auto it = players.begin(); it != players.end(); ++it) {
+		if (predicate(*it)) {
+			PlayerSaveData data = std::move(*it);
+			queuedPlayers.erase(data.guid);
+			players.erase(it);
+			lockGuard.unlock();
+
+			uint32_t rows = 0;
+			if (!writePlayer(*Database::getInstance(), data, rows)) {
+				std::cout << "[Error - WorldSave::flushPlayer] Could not save player " << data.name << '.' << std::endl;
+
+				lockGuard.lock();
+				failedSections[data.guid] |= data.getPendingSections();
+			}
+			return;
+		}
+	}
+}
+
+uint8_t WorldSave::flushPlayer(uint32_t guid)
+{
+	flushPlayerIf([guid](const PlayerSaveData& data) {
+		return data.guid == guid;
+	});
+
+	std::lock_guard<std::mutex> lockGuard(lock);
+	auto it = failedSections.find(guid);
+	if (it == failedSections.end()) {
+		return PLAYER_SAVE_NONE;
+	}
+
+	uint8_t sections = it->second;
+	failedSections.erase(it);
+	return sections;
+}
+
+void WorldSave::flushPlayer(const std::string& name)
+{
+	// player names are compared case insensitively by the database as well
+	flushPlayerIf([&name](const PlayerSaveData& data) {
+		return strcasecmp(data.name.c_str(), name.c_str()) == 0;
+	});
+}
+
+void WorldSave::flushHouses()
+{
+	std::unique_lock<std::mutex> lockGuard(lock);
+	while (writingHouses) {
+		housesWrittenSignal.wait(lockGuard);
+	}
+
+	if (!housesQueued) {
+		return;
+	}
+
+	// still queued: write them from here instead of waiting for their turn
+	std::vector<HouseSaveData> houseData = std::move(houses);
+	houses.clear();
+	housesQueued = false;
+	lockGuard.unlock();
+
+	if (!writeHouses(*Database::getInstance(), houseData)) {
+		std::cout << "[Error - WorldSave::flushHouses] Could not save the houses." << std::endl;
+		setHousesDirty(getChangedHouses(houseData));
+	}
+}
+
+void WorldSave::shutdown()
+{
+	lock.lock();
+	if (threadState == THREAD_STATE_RUNNING) {
+		threadState = THREAD_STATE_TERMINATED;
+	}
+	lock.unlock();
+	signal.notify_one();
+}
+
+void WorldSave::join()
+{
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
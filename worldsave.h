@@ -0,0 +1,112 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2014  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef FS_WORLDSAVE_H_4C1F7E2A9B8D4A6E8F3B2D1C0E9A7B65
+#define FS_WORLDSAVE_H_4C1F7E2A9B8D4A6E8F3B2D1C0E9A7B65
+
+#include <condition_variable>
+#include <thread>
+
+#include "database.h"
+#include "enums.h"
+#include "iologindata.h"
+#include "iomapserialize.h"
+
+// Writes server saves from its own thread and database connection. The
+// dispatcher only captures PlayerSaveData and HouseSaveData; every player is
+// then written in its own transaction, followed by the houses.
+class WorldSave
+{
+	public:
+		WorldSave();
+
+		// non-copyable
+		WorldSave(const WorldSave&) = delete;
+		WorldSave& operator=(const WorldSave&) = delete;
+
+		void start();
+		// what is still queued gets written before the thread ends
+		void shutdown();
+		void join();
+
+		// queued snapshots of the same players and houses are replaced by the
+		// new ones, without the writer thread everything is written right away
+		void save(std::vector<PlayerSaveData> players, std::vector<HouseSaveData> houses, int64_t captureTime);
+
+		// Dispatcher thread. Makes sure the database is not older than the last
+		// snapshot of this player, so it can be loaded or saved directly.
+		// Returns the PlayerSaveSection_t flags earlier snapshots failed to write.
+		uint8_t flushPlayer(uint32_t guid);
+		void flushPlayer(const std::string& name);
+
+		// Dispatcher thread. Writes the queued houses and waits for the ones
+		// being written, so a direct write to `houses` is not undone by an
+		// older snapshot afterwards.
+		void flushHouses();
+
+	private:
+		void run();
+		void report();
+
+		template<typename Predicate>
+		void flushPlayerIf(Predicate predicate);
+
+		// merges what queued or failed snapshots of the player left unwritten into
+		// data and drops the queued one, the lock has to be held
+		void takeOlder(PlayerSaveData& data);
+
+		typedef std::list<PlayerSaveData> PlayerQueue;
+
+		Database db;
+		std::thread thread;
+		std::mutex lock;
+		std::condition_variable signal;
+		std::condition_variable playerWritten;
+		std::condition_variable housesWrittenSignal;
+
+		PlayerQueue players;
+		std::unordered_map<uint32_t, PlayerQueue::iterator> queuedPlayers;
+		std::vector<HouseSaveData> houses;
+		bool housesQueued;
+		// the writer thread has taken the houses and not finished them yet
+		bool writingHouses;
+		// the snapshot the writer thread is on, nullptr between players
+		const PlayerSaveData* writingPlayer;
+		// sections of failed snapshots, merged into the next one of the player
+		std::unordered_map<uint32_t, uint8_t> failedSections;
+
+		// progress of the save being written
+		int64_t startTime;
+		int64_t captureTime;
+		int64_t lastProgress;
+		int64_t slowestPlayer;
+		uint32_t playersWritten;
+		uint32_t playersFailed;
+		uint64_t rowsWritten;
+		uint32_t housesWritten;
+		uint32_t housesChanged;
+		bool housesFailed;
+
+		ThreadState threadState;
+};
+
+extern WorldSave g_worldSave;
+
+#endif
@@ -0,0 +1,245 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2015  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "otpch.h"
+
+#include "xtea.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define XTEA_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const uint32_t XTEA_DELTA = 0x61C88647;
+const uint32_t XTEA_DECRYPT_SUM = 0xC6EF3720;
+
+// the per round key material only depends on the key, not on the block
+struct RoundKeys {
+	uint32_t first[32];
+	uint32_t second[32];
+};
+
+void makeEncryptKeys(const uint32_t* k, RoundKeys& keys)
+{
+	uint32_t sum = 0;
+	for (int32_t i = 0; i < 32; ++i) {
+		keys.first[i] = sum + k[sum & 3];
+		sum -= XTEA_DELTA;
+		keys.second[i] = sum + k[(sum >> 11) & 3];
+	}
+}
+
+void makeDecryptKeys(const uint32_t* k, RoundKeys& keys)
+{
+	uint32_t sum = XTEA_DECRYPT_SUM;
+	for (int32_t i = 0; i < 32; ++i) {
+		keys.first[i] = sum + k[(sum >> 11) & 3];
+		sum += XTEA_DELTA;
+		keys.second[i] = sum + k[sum & 3];
+	}
+}
+
+void encryptScalar(uint8_t* buffer, size_t length, const RoundKeys& keys)
+{
+	for (size_t pos = 0; pos < length; pos += 8) {
+		uint32_t v0, v1;
+		memcpy(&v0, buffer + pos, 4);
+		memcpy(&v1, buffer + pos + 4, 4);
+
+		for (int32_t i = 0; i < 32; ++i) {
+			v0 += ((v1 << 4 ^ v1 >> 5) + v1) ^ keys.first[i];
+			v1 += ((v0 << 4 ^ v0 >> 5) + v0) ^ keys.second[i];
+		}
+
+		memcpy(buffer + pos, &v0, 4);
+		memcpy(buffer + pos + 4, &v1, 4);
+	}
+}
+
+void decryptScalar(uint8_t* buffer, size_t length, const RoundKeys& keys)
+{
+	for (size_t pos = 0; pos < length; pos += 8) {
+		uint32_t v0, v1;
+		memcpy(&v0, buffer + pos, 4);
+		memcpy(&v1, buffer + pos + 4, 4);
+
+		for (int32_t i = 0; i < 32; ++i) {
+			v1 -= ((v0 << 4 ^ v0 >> 5) + v0) ^ keys.first[i];
+			v0 -= ((v1 << 4 ^ v1 >> 5) + v1) ^ keys.second[i];
+		}
+
+		memcpy(buffer + pos, &v0, 4);
+		memcpy(buffer + pos + 4, &v1, 4);
+	}
+}
+
+#ifdef XTEA_X86_KERNELS
+// SSE2: two loads hold 4 blocks, split into a v0 and a v1 vector, run the
+// rounds on all 4 lanes and interleave them back. Returns the bytes done.
+__attribute__((target("sse2")))
+size_t encryptSSE2(uint8_t* buffer, size_t length, const RoundKeys& keys)
+{
+	size_t pos = 0;
+	for (; pos + 32 <= length; pos += 32) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + pos));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + pos + 16));
+		__m128i v0 = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i v1 = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+
+		for (int32_t i = 0; i < 32; ++i) {
+			__m128i t = _mm_add_epi32(_mm_xor_si128(_mm_slli_epi32(v1, 4), _mm_srli_epi32(v1, 5)), v1);
+			v0 = _mm_add_epi32(v0, _mm_xor_si128(t, _mm_set1_epi32(keys.first[i])));
+			t = _mm_add_epi32(_mm_xor_si128(_mm_slli_epi32(v0, 4), _mm_srli_epi32(v0, 5)), v0);
+			v1 = _mm_add_epi32(v1, _mm_xor_si128(t, _mm_set1_epi32(keys.second[i])));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(buffer + pos), _mm_unpacklo_epi32(v0, v1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(buffer + pos + 16), _mm_unpackhi_epi32(v0, v1));
+	}
+	return pos;
+}
+
+__attribute__((target("sse2")))
+size_t decryptSSE2(uint8_t* buffer, size_t length, const RoundKeys& keys)
+{
+	size_t pos = 0;
+	for (; pos + 32 <= length; pos += 32) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + pos));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + pos + 16));
+		__m128i v0 = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i v1 = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+
+		for (int32_t i = 0; i < 32; ++i) {
+			__m128i t = _mm_add_epi32(_mm_xor_si128(_mm_slli_epi32(v0, 4), _mm_srli_epi32(v0, 5)), v0);
+			v1 = _mm_sub_epi32(v1, _mm_xor_si128(t, _mm_set1_epi32(keys.first[i])));
+			t = _mm_add_epi32(_mm_xor_si128(_mm_slli_epi32(v1, 4), _mm_srli_epi32(v1, 5)), v1);
+			v0 = _mm_sub_epi32(v0, _mm_xor_si128(t, _mm_set1_epi32(keys.second[i])));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(buffer + pos), _mm_unpacklo_epi32(v0, v1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(buffer + pos + 16), _mm_unpackhi_epi32(v0, v1));
+	}
+	return pos;
+}
+
+// AVX2: same layout with 8 blocks; the shuffles work per 128 bit lane, the
+// unpacks undo exactly that permutation. A 4 block tail goes through SSE2.
+__attribute__((target("avx2")))
+size_t encryptAVX2(uint8_t* buffer, size_t length, const RoundKeys& keys)
+{
+	size_t pos = 0;
+	for (; pos + 64 <= length; pos += 64) {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer + pos));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer + pos + 32));
+		__m256i v0 = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+		__m256i v1 = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+
+		for (int32_t i = 0; i < 32; ++i) {
+			__m256i t = _mm256_add_epi32(_mm256_xor_si256(_mm256_slli_epi32(v1, 4), _mm256_srli_epi32(v1, 5)), v1);
+			v0 = _mm256_add_epi32(v0, _mm256_xor_si256(t, _mm256_set1_epi32(keys.first[i])));
+			t = _mm256_add_epi32(_mm256_xor_si256(_mm256_slli_epi32(v0, 4), _mm256_srli_epi32(v0, 5)), v0);
+			v1 = _mm256_add_epi32(v1, _mm256_xor_si256(t, _mm256_set1_epi32(keys.second[i])));
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(buffer + pos), _mm256_unpacklo_epi32(v0, v1));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(buffer + pos + 32), _mm256_unpackhi_epi32(v0, v1));
+	}
+	return pos + encryptSSE2(buffer + pos, length - pos, keys);
+}
+
+__attribute__((target("avx2")))
+size_t decryptAVX2(uint8_t* buffer, size_t length, const RoundKeys& keys)
+{
+	size_t pos = 0;
+	for (; pos + 64 <= length; pos += 64) {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer + pos));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer + pos + 32));
+		__m256i v0 = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+		__m256i v1 = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+
+		for (int32_t i = 0; i < 32; ++i) {
+			__m256i t = _mm256_add_epi32(_mm256_xor_si256(_mm256_slli_epi32(v0, 4), _mm256_srli_epi32(v0, 5)), v0);
+			v1 = _mm256_sub_epi32(v1, _mm256_xor_si256(t, _mm256_set1_epi32(keys.first[i])));
+			t = _mm256_add_epi32(_mm256_xor_si256(_mm256_slli_epi32(v1, 4), _mm256_srli_epi32(v1, 5)), v1);
+			v0 = _mm256_sub_epi32(v0, _mm256_xor_si256(t, _mm256_set1_epi32(keys.second[i])));
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(buffer + pos), _mm256_unpacklo_epi32(v0, v1));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(buffer + pos + 32), _mm256_unpackhi_epi32(v0, v1));
+	}
+	return pos + decryptSSE2(buffer + pos, length - pos, keys);
+}
+#endif
+
+typedef size_t (*XteaKernel)(uint8_t*, size_t, const RoundKeys&);
+
+struct XteaKernels {
+	XteaKernels() : encrypt(nullptr), decrypt(nullptr) {
+#ifdef XTEA_X86_KERNELS
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			encrypt = encryptAVX2;
+			decrypt = decryptAVX2;
+		} else if (__builtin_cpu_supports("sse2")) {
+			encrypt = encryptSSE2;
+			decrypt = decryptSSE2;
+		}
+#endif
+	}
+
+	XteaKernel encrypt;
+	XteaKernel decrypt;
+};
+
+const XteaKernels& getKernels()
+{
+	static const XteaKernels kernels;
+	return kernels;
+}
+
+}
+
+void xteaEncrypt(uint8_t* buffer, size_t length, const uint32_t* key)
+{
+	RoundKeys keys;
+	makeEncryptKeys(key, keys);
+
+	size_t done = 0;
+	if (XteaKernel kernel = getKernels().encrypt) {
+		done = kernel(buffer, length, keys);
+	}
+
+	//whatever the wide kernel left over goes block by block
+	encryptScalar(buffer + done, length - done, keys);
+}
+
+void xteaDecrypt(uint8_t* buffer, size_t length, const uint32_t* key)
+{
+	RoundKeys keys;
+	makeDecryptKeys(key, keys);
+
+	size_t done = 0;
+	if (XteaKernel kernel = getKernels().decrypt) {
+		done = kernel(buffer, length, keys);
+	}
+
+	decryptScalar(buffer + done, length - done, keys);
+}
@@ -0,0 +1,29 @@
+/**
+ * The Forgotten Server - a free and open-source MMORPG server emulator
+ * Copyright (C) 2015  Mark Samman <mark.samman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FS_XTEA_H_5A1C8E3F7B2D4096A4E1C7D3F8B60E29
+#define FS_XTEA_H_5A1C8E3F7B2D4096A4E1C7D3F8B60E29
+
+// XTEA in ECB mode over whole 8 byte blocks, length must be a multiple of 8.
+// Blocks are independent, so several are processed per iteration when the
+// CPU supports it (SSE2: 4 blocks, AVX2: 8 blocks), picked once at runtime.
+void xteaEncrypt(uint8_t* buffer, size_t length, const uint32_t* key);
+void xteaDecrypt(uint8_t* buffer, size_t length, const uint32_t* key);
+
+#endif